@@ -0,0 +1,319 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ppke/GMPpke.hpp"
+#include "thread_pool.hpp"
+
+#include <sse/crypto/puncturable_enc.hpp>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using sse::crypto::Gmppke;
+using sse::crypto::GmppkePrivateKey;
+using sse::crypto::GmppkePrivateKeyShare;
+using sse::crypto::GmppkePublicKey;
+using sse::crypto::GmppkeSecretParameters;
+using sse::crypto::init_thread_relic_context;
+using sse::crypto::PuncturableDecryption;
+using sse::crypto::PuncturableEncryption;
+
+namespace punct = sse::crypto::punct;
+
+#define MAX_PUNCTURED_SHARES 10000
+#define DECRYPT_CT_COUNT 64
+
+// The punctured tags and the encryption tags are disjoint: the last byte
+// tells them apart
+static punct::tag_type bench_tag(size_t i, bool punctured)
+{
+    punct::tag_type tag;
+    tag.fill(0);
+    for (size_t j = 0; j < sizeof(i); j++) {
+        tag[j] = static_cast<uint8_t>(i >> (8 * j));
+    }
+    tag[tag.size() - 1] = punctured ? 0x01 : 0x02;
+    return tag;
+}
+
+// Encryptor with a fixed master key, shared by all the benchmarks
+static PuncturableEncryption& bench_encryptor()
+{
+    static PuncturableEncryption encryptor([]() {
+        std::array<uint8_t, punct::kMasterKeySize> master_key;
+        for (size_t i = 0; i < master_key.size(); i++) {
+            master_key[i] = static_cast<uint8_t>(i);
+        }
+        return punct::master_key_type(master_key.data());
+    }());
+    return encryptor;
+}
+
+// Punctured key with n_shares shares (so punctured n_shares - 1 times). The
+// keys are generated once, and are shared by the benchmarks.
+static const punct::punctured_key_type& punctured_key(size_t n_shares)
+{
+    static std::mutex                                  mtx;
+    static std::map<size_t, punct::punctured_key_type> keys;
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = keys.find(n_shares);
+    if (it == keys.end()) {
+        std::vector<punct::tag_type> tags;
+        for (size_t i = 0; i + 1 < n_shares; i++) {
+            tags.push_back(bench_tag(i, true));
+        }
+
+        punct::punctured_key_type key;
+        key.push_back(bench_encryptor().initial_keyshare(n_shares - 1));
+
+        const std::vector<punct::key_share_type> shares
+            = bench_encryptor().inc_puncture_batch(1, tags);
+        key.insert(key.end(), shares.begin(), shares.end());
+
+        it = keys.emplace(n_shares, std::move(key)).first;
+    }
+    return it->second;
+}
+
+// Runs op in the benchmark loop, and sets the number of pairings (Miller
+// loops and final exponentiations) and of exponentiations per item, where
+// every call of op processes items_per_call items.
+//
+// The operation counts are process-wide: with several benchmark threads, the
+// first thread reports the counts of all the threads, as counted between its
+// first and its last iteration. They are only reported when the library is
+// built with RELICXX_COUNT_OPERATIONS.
+template<class F>
+static void run_counted(benchmark::State& st, int64_t items_per_call, F&& op)
+{
+    relicxx::OperationCounts start;
+
+    bool first = true;
+    for (auto _ : st) {
+        if (first) {
+            start = relicxx::OperationCounts::current();
+            first = false;
+        }
+        op();
+    }
+    const relicxx::OperationCounts ops
+        = relicxx::OperationCounts::current() - start;
+
+    st.SetItemsProcessed(int64_t(st.iterations()) * items_per_call);
+
+#ifdef RELICXX_COUNT_OPERATIONS
+    if (st.thread_index() == 0) {
+        const double items = double(st.iterations()) * double(items_per_call)
+                             * double(st.threads());
+
+        st.counters["pairings/op"]   = double(ops.miller_loops) / items;
+        st.counters["final_exps/op"] = double(ops.final_exps) / items;
+        st.counters["g1_exps/op"]    = double(ops.g1_exps) / items;
+        st.counters["g2_exps/op"]    = double(ops.g2_exps) / items;
+        st.counters["gt_exps/op"]    = double(ops.gt_exps) / items;
+    }
+#else
+    (void)ops;
+#endif
+}
+
+static void Ppke_keygen(benchmark::State& st)
+{
+    init_thread_relic_context();
+
+    const Gmppke ppke;
+
+    run_counted(st, 1, [&ppke]() {
+        GmppkePublicKey        pk;
+        GmppkePrivateKey       sk;
+        GmppkeSecretParameters sp;
+
+        ppke.keygen(pk, sk, sp);
+        benchmark::DoNotOptimize(sk);
+    });
+}
+
+BENCHMARK(Ppke_keygen)->Unit(benchmark::kMicrosecond);
+
+// Encryption with the public key
+static void Ppke_encrypt_public(benchmark::State& st)
+{
+    init_thread_relic_context();
+
+    const Gmppke           ppke;
+    GmppkePublicKey        pk;
+    GmppkePrivateKey       sk;
+    GmppkeSecretParameters sp;
+    ppke.keygen(pk, sk, sp);
+
+    // build the blinding table before measuring
+    benchmark::DoNotOptimize(
+        ppke.encrypt<uint64_t>(pk, 0, bench_tag(0, false)));
+
+    size_t i = 0;
+    run_counted(st, 1, [&]() {
+        benchmark::DoNotOptimize(
+            ppke.encrypt<uint64_t>(pk, i, bench_tag(i, false)));
+        i++;
+    });
+}
+
+BENCHMARK(Ppke_encrypt_public)->Unit(benchmark::kMicrosecond);
+
+// Encryption with the secret parameters, as done by PuncturableEncryption
+static void Ppke_encrypt_secret(benchmark::State& st)
+{
+    init_thread_relic_context();
+
+    PuncturableEncryption& encryptor = bench_encryptor();
+
+    size_t i = 0;
+    run_counted(st, 1, [&]() {
+        benchmark::DoNotOptimize(encryptor.encrypt(i, bench_tag(i, false)));
+        i++;
+    });
+}
+
+BENCHMARK(Ppke_encrypt_secret)->Unit(benchmark::kMicrosecond);
+
+static void Ppke_inc_puncture(benchmark::State& st)
+{
+    init_thread_relic_context();
+
+    PuncturableEncryption& encryptor = bench_encryptor();
+
+    size_t d = 1;
+    run_counted(st, 1, [&]() {
+        benchmark::DoNotOptimize(
+            encryptor.inc_puncture(d, bench_tag(d - 1, true)));
+        d++;
+    });
+}
+
+BENCHMARK(Ppke_inc_puncture)->Unit(benchmark::kMicrosecond);
+
+// Parsing of a serialized key share, compressed (compressed:1) or not
+// (compressed:0)
+static void Ppke_keyshare_parsing(benchmark::State& st)
+{
+    init_thread_relic_context();
+
+    const punct::key_share_type share
+        = bench_encryptor().inc_puncture(1, bench_tag(0, true));
+    const punct::uncompressed_key_share_type uncompressed_share
+        = punct::uncompress(share);
+
+    const bool     compressed = (st.range(0) != 0);
+    const uint8_t* bytes
+        = compressed ? share.data() : uncompressed_share.data();
+
+    run_counted(st, 1, [bytes, compressed]() {
+        GmppkePrivateKeyShare ks(bytes, compressed);
+        benchmark::DoNotOptimize(ks);
+    });
+}
+
+BENCHMARK(Ppke_keyshare_parsing)
+    ->ArgName("compressed")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+// Ciphertexts that the punctured keys can decrypt
+static const std::vector<punct::ciphertext_type>& decryptable_ciphertexts()
+{
+    static const std::vector<punct::ciphertext_type> cts = []() {
+        std::vector<punct::ciphertext_type> v;
+        for (size_t i = 0; i < DECRYPT_CT_COUNT; i++) {
+            v.push_back(bench_encryptor().encrypt(i, bench_tag(i, false)));
+        }
+        return v;
+    }();
+    return cts;
+}
+
+// Register the punctured key sizes (1, 10, ..., MAX_PUNCTURED_SHARES shares)
+static void KeySizes(benchmark::internal::Benchmark* b)
+{
+    b->ArgName("shares");
+    for (int shares = 1; shares <= MAX_PUNCTURED_SHARES; shares *= 10) {
+        b->Arg(shares);
+    }
+    b->UseRealTime()->Unit(benchmark::kMillisecond);
+}
+
+// Decryption of a single ciphertext, by 1, 2, 4, ... up to the number of
+// hardware threads (included) benchmark threads, each with its own decryptor.
+// The decryption itself spreads the pairings of the large keys over the
+// shared thread pool.
+static void Ppke_decrypt(benchmark::State& st)
+{
+    init_thread_relic_context();
+
+    const std::vector<punct::ciphertext_type>& cts = decryptable_ciphertexts();
+
+    PuncturableDecryption decryptor(
+        punctured_key(static_cast<size_t>(st.range(0))));
+
+    // the key is parsed and prepared on the first decryption
+    uint64_t m;
+    decryptor.decrypt(cts[0], m);
+
+    size_t i = 0;
+    run_counted(st, 1, [&]() {
+        decryptor.decrypt(cts[i % cts.size()], m);
+        benchmark::DoNotOptimize(m);
+        i++;
+    });
+}
+
+BENCHMARK(Ppke_decrypt)->Apply(KeySizes)->ThreadRange(
+    1, static_cast<int>(sse::crypto::hardware_thread_count()));
+
+// Decryption of DECRYPT_CT_COUNT ciphertexts at once, reported per
+// ciphertext
+static void Ppke_decrypt_batch(benchmark::State& st)
+{
+    init_thread_relic_context();
+
+    const std::vector<punct::ciphertext_type>& cts = decryptable_ciphertexts();
+
+    PuncturableDecryption decryptor(
+        punctured_key(static_cast<size_t>(st.range(0))));
+
+    uint64_t m;
+    decryptor.decrypt(cts[0], m);
+
+    std::vector<uint64_t> ms;
+    std::vector<bool>     ok;
+    run_counted(st, int64_t(cts.size()), [&]() {
+        decryptor.decrypt_batch(cts, ms, ok);
+        benchmark::DoNotOptimize(ms.data());
+    });
+}
+
+BENCHMARK(Ppke_decrypt_batch)->Apply(KeySizes);
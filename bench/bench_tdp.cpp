@@ -18,8 +18,14 @@
 // along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include "bench_utils.hpp"
 #include "tdp_impl/tdp_impl_mbedtls.hpp"
 #include "tdp_impl/tdp_impl_openssl.hpp"
+#include "thread_pool.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 
@@ -36,7 +42,7 @@ void Tdp_key_generation(benchmark::State& state)
 {
     for (auto _ : state) {
         TDP_INV sk_tdp;
-        benchmark::DoNotOptimize(sk_tdp);
+        benchmark::DoNotOptimize(&sk_tdp);
     }
 }
 
@@ -112,6 +118,26 @@ public:
 
 #define EVAL_MULT_BENCH(LIB) EVAL_MULT_BENCH_AUX(LIB, LIB##_Impl)
 
+// Baseline for eval_mult: the same number of evaluations, done as successive
+// single evaluations of the TDP. Comparing the two gives the order from which
+// the single exponentiation by e^order of eval_mult gets faster
+#define EVAL_ITERATED_BENCH_AUX(NAME, IMPL)                                    \
+    BENCHMARK_TEMPLATE_DEFINE_F(Tdp_Benchmark, NAME##_eval_iterated, IMPL)     \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        for (auto _ : st) {                                                    \
+            for (int64_t i = 0; i < st.range(0); i++) {                        \
+                tdp_.eval(message, message);                                   \
+            }                                                                  \
+        }                                                                      \
+        st.SetItemsProcessed(int64_t(st.iterations()));                        \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Benchmark, NAME##_eval_iterated)                  \
+        ->RangeMultiplier(2)                                                   \
+        ->Range(1, MAX_POOL_SIZE);
+
+#define EVAL_ITERATED_BENCH(LIB) EVAL_ITERATED_BENCH_AUX(LIB, LIB##_Impl)
+
 
 #define INVERT_BENCH_AUX(NAME, IMPL)                                           \
     BENCHMARK_TEMPLATE_DEFINE_F(Tdp_Benchmark, NAME##_invert, IMPL)            \
@@ -141,14 +167,193 @@ public:
 
 #define INVERT_MULT_BENCH(LIB) INVERT_MULT_BENCH_AUX(LIB, LIB##_Impl)
 
+// Register the (thread count, batch size) pairs, where the thread count is 1,
+// 2, 4, ..., up to the number of hardware threads (included), and the batch
+// size is 16, 256 or 4096
+static void BatchThreadCounts(benchmark::internal::Benchmark* b)
+{
+    const int max_threads
+        = static_cast<int>(sse::crypto::hardware_thread_count());
+
+    b->ArgNames({"threads", "batch"});
+    for (int batch = 16; batch <= 4096; batch *= 16) {
+        for (int n = 1; n < max_threads; n *= 2) {
+            b->Args({n, batch});
+        }
+        b->Args({max_threads, batch});
+    }
+}
+
+template<typename IMPL>
+class Tdp_Batch_Benchmark : public Tdp_Benchmark<IMPL>
+{
+public:
+    void SetUp(const ::benchmark::State& state)
+    {
+        Tdp_Benchmark<IMPL>::SetUp(state);
+
+        messages.resize(static_cast<size_t>(state.range(1)));
+        for (auto& m : messages) {
+            m = this->tdp_.sample_array();
+        }
+    }
+
+    std::vector<std::array<uint8_t, sse::crypto::Tdp::kMessageSize>> messages;
+};
+
+#define EVAL_BATCH_BENCH_AUX(NAME, IMPL)                                       \
+    BENCHMARK_TEMPLATE_DEFINE_F(Tdp_Batch_Benchmark, NAME##_eval_batch, IMPL)  \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        for (auto _ : st) {                                                    \
+            tdp_.eval_batch(messages,                                          \
+                            messages,                                          \
+                            static_cast<unsigned int>(st.range(0)));           \
+        }                                                                      \
+        st.SetItemsProcessed(int64_t(st.iterations()) * st.range(1));          \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Batch_Benchmark, NAME##_eval_batch)               \
+        ->Apply(BatchThreadCounts)                                             \
+        ->UseRealTime()                                                        \
+        ->Unit(benchmark::kMillisecond);
+
+#define EVAL_BATCH_BENCH(LIB) EVAL_BATCH_BENCH_AUX(LIB, LIB##_Impl)
+
+#define INVERT_BATCH_BENCH_AUX(NAME, IMPL)                                     \
+    BENCHMARK_TEMPLATE_DEFINE_F(                                               \
+        Tdp_Batch_Benchmark, NAME##_invert_batch, IMPL)                        \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        for (auto _ : st) {                                                    \
+            tdp_inv_.invert_batch(messages,                                    \
+                                  messages,                                    \
+                                  static_cast<unsigned int>(st.range(0)));     \
+        }                                                                      \
+        st.SetItemsProcessed(int64_t(st.iterations()) * st.range(1));          \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Batch_Benchmark, NAME##_invert_batch)             \
+        ->Apply(BatchThreadCounts)                                             \
+        ->UseRealTime()                                                        \
+        ->Unit(benchmark::kMillisecond);
+
+#define INVERT_BATCH_BENCH(LIB) INVERT_BATCH_BENCH_AUX(LIB, LIB##_Impl)
+
+#define MAX_BENCH_THREADS 64
+#define LATENCY_ORDER 16
+
+// Latency and contention benchmarks: the operations are run by 1 to
+// MAX_BENCH_THREADS threads, either on the fixture's TDP objects, shared by
+// all the threads (per_thread:0), or on objects owned by every thread,
+// created from the fixture's keys (per_thread:1).
+template<typename IMPL>
+class Tdp_Latency_Benchmark : public Tdp_Benchmark<IMPL>
+{
+public:
+    typedef typename IMPL::TdpImpl         TdpImpl;
+    typedef typename IMPL::TdpInverseImpl  TdpInverseImpl;
+    typedef typename IMPL::TdpMultPoolImpl TdpMultPoolImpl;
+
+    // The TDP objects used by a benchmark thread
+    struct Objects
+    {
+        std::unique_ptr<TdpInverseImpl>  own_tdp_inv;
+        std::unique_ptr<TdpImpl>         own_tdp;
+        std::unique_ptr<TdpMultPoolImpl> own_tdp_mult;
+
+        const TdpInverseImpl*  tdp_inv;
+        const TdpImpl*         tdp;
+        const TdpMultPoolImpl* tdp_mult;
+    };
+
+    Tdp_Latency_Benchmark() : message_(this->tdp_.sample())
+    {
+    }
+
+    // The benchmark threads all call SetUp on the same fixture: do not touch
+    // the shared message
+    void SetUp(const ::benchmark::State& /*state*/)
+    {
+    }
+
+    Objects thread_objects(const benchmark::State& st) const
+    {
+        Objects o;
+        if (st.range(0) == 0) {
+            o.tdp_inv  = &this->tdp_inv_;
+            o.tdp      = &this->tdp_;
+            o.tdp_mult = &this->tdp_mult_;
+        } else {
+            const std::string sk = this->tdp_inv_.private_key_binary();
+            const std::string pk = this->tdp_.public_key_binary();
+
+            o.own_tdp_inv.reset(new TdpInverseImpl(sk));
+            o.own_tdp.reset(new TdpImpl(pk));
+            o.own_tdp_mult.reset(new TdpMultPoolImpl(pk, MAX_POOL_SIZE));
+
+            o.tdp_inv  = o.own_tdp_inv.get();
+            o.tdp      = o.own_tdp.get();
+            o.tdp_mult = o.own_tdp_mult.get();
+        }
+        return o;
+    }
+
+    std::string                 message_;
+    sse::bench::OperationProfiler profiler_;
+};
+
+static void LatencyArguments(benchmark::internal::Benchmark* b)
+{
+    b->ArgName("per_thread")->Arg(0)->Arg(1);
+    b->ThreadRange(1, MAX_BENCH_THREADS);
+    b->UseRealTime()->Unit(benchmark::kMicrosecond);
+}
+
+// OP is the name of the benchmarked operation, and the variadic argument the
+// call, made on the TDP objects o, of the operation on the message m
+#define LATENCY_BENCH_AUX(NAME, IMPL, OP, ...)                                 \
+    BENCHMARK_TEMPLATE_DEFINE_F(                                               \
+        Tdp_Latency_Benchmark, NAME##_##OP##_latency, IMPL)                    \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        const Objects o = thread_objects(st);                                  \
+        std::string   m = message_;                                            \
+        profiler_.run(st, [&o, &m]() { __VA_ARGS__; });                        \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Latency_Benchmark, NAME##_##OP##_latency)         \
+        ->Apply(LatencyArguments);
+
+#define LATENCY_BENCH(LIB)                                                     \
+    LATENCY_BENCH_AUX(LIB, LIB##_Impl, eval, o.tdp->eval(m, m))                \
+    LATENCY_BENCH_AUX(LIB,                                                     \
+                      LIB##_Impl,                                              \
+                      eval_mult,                                               \
+                      o.tdp_mult->eval_pool(m, m, LATENCY_ORDER))              \
+    LATENCY_BENCH_AUX(LIB, LIB##_Impl, invert, o.tdp_inv->invert(m, m))        \
+    LATENCY_BENCH_AUX(LIB,                                                     \
+                      LIB##_Impl,                                              \
+                      invert_mult,                                             \
+                      o.tdp_inv->invert_mult(m, m, LATENCY_ORDER))
+
 EVAL_BENCH(mbedTLS);
 EVAL_BENCH(OpenSSL);
 
 EVAL_MULT_BENCH(mbedTLS);
 EVAL_MULT_BENCH(OpenSSL);
 
+EVAL_ITERATED_BENCH(mbedTLS);
+EVAL_ITERATED_BENCH(OpenSSL);
+
 INVERT_BENCH(mbedTLS);
 INVERT_BENCH(OpenSSL);
 
 INVERT_MULT_BENCH(mbedTLS);
 INVERT_MULT_BENCH(OpenSSL);
+
+EVAL_BATCH_BENCH(mbedTLS);
+EVAL_BATCH_BENCH(OpenSSL);
+
+INVERT_BATCH_BENCH(mbedTLS);
+INVERT_BATCH_BENCH(OpenSSL);
+
+LATENCY_BENCH(mbedTLS);
+LATENCY_BENCH(OpenSSL);
@@ -0,0 +1,181 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "bench_utils.hpp"
+
+#include <sys/resource.h>
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__GLIBC__)
+#define SSE_BENCH_COUNT_ALLOCATIONS 1
+#endif
+
+#ifdef SSE_BENCH_COUNT_ALLOCATIONS
+
+// Count the allocations of the calling thread by interposing the C library's
+// allocation functions. operator new calls malloc, so this also counts the
+// C++ allocations.
+static __thread uint64_t thread_allocation_count = 0;
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+    thread_allocation_count++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    thread_allocation_count++;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    thread_allocation_count++;
+    return __libc_realloc(ptr, size);
+}
+}
+
+#endif
+
+namespace sse {
+namespace bench {
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t ns)
+{
+    if (ns < kSubBucketCount) {
+        return static_cast<size_t>(ns);
+    }
+    // ns >= 2^kSubBucketBits, so msb >= kSubBucketBits
+    const unsigned msb   = 63U - static_cast<unsigned>(__builtin_clzll(ns));
+    const unsigned shift = msb - kSubBucketBits;
+    const uint64_t sub   = (ns >> shift) - kSubBucketCount;
+
+    return (shift + 1) * kSubBucketCount + static_cast<size_t>(sub);
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index)
+{
+    if (index < kSubBucketCount) {
+        return index;
+    }
+    const unsigned shift = static_cast<unsigned>(index / kSubBucketCount) - 1;
+    const uint64_t mantissa
+        = (index % kSubBucketCount) + kSubBucketCount + 1;
+
+    return (mantissa << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    buckets_[bucket_index(ns)]++;
+    count_++;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& h)
+{
+    for (size_t i = 0; i < kBucketCount; i++) {
+        buckets_[i] += h.buckets_[i];
+    }
+    count_ += h.count_;
+}
+
+void LatencyHistogram::clear()
+{
+    buckets_.fill(0);
+    count_ = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+    p = std::min(std::max(p, 0.), 1.);
+
+    // rank (starting at 1) of the p-quantile
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(p * static_cast<double>(count_) + 0.5));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return bucket_upper_bound(i);
+        }
+    }
+    return bucket_upper_bound(kBucketCount - 1); /* LCOV_EXCL_LINE */
+}
+
+ThreadResourceUsage ThreadResourceUsage::current()
+{
+    ThreadResourceUsage u;
+
+#ifdef SSE_BENCH_COUNT_ALLOCATIONS
+    u.allocations = thread_allocation_count;
+#endif
+
+#ifdef RUSAGE_THREAD
+    struct rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+        u.voluntary_switches   = static_cast<uint64_t>(ru.ru_nvcsw);
+        u.involuntary_switches = static_cast<uint64_t>(ru.ru_nivcsw);
+    }
+#endif
+
+    return u;
+}
+
+ThreadResourceUsage ThreadResourceUsage::operator-(
+    const ThreadResourceUsage& u) const
+{
+    ThreadResourceUsage r;
+    r.allocations          = allocations - u.allocations;
+    r.voluntary_switches   = voluntary_switches - u.voluntary_switches;
+    r.involuntary_switches = involuntary_switches - u.involuntary_switches;
+    return r;
+}
+
+uint64_t OperationProfiler::now_ns()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+} // namespace bench
+} // namespace sse
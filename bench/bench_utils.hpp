@@ -0,0 +1,165 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <mutex>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+namespace sse {
+namespace bench {
+
+// Log-linear histogram of latencies (in nanoseconds): every power of two is
+// split in 16 buckets, so the reported percentiles are within 6.25% of the
+// measured values. Recording a value does not allocate memory, and does not
+// perturb the measured code.
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned kSubBucketBits  = 4;
+    static constexpr unsigned kSubBucketCount = 1U << kSubBucketBits;
+    static constexpr size_t   kBucketCount    = 64 * kSubBucketCount;
+
+    LatencyHistogram();
+
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& h);
+    void clear();
+
+    uint64_t count() const
+    {
+        return count_;
+    }
+
+    // Upper bound of the bucket containing the p-quantile of the recorded
+    // values, 0 <= p <= 1. Returns 0 if the histogram is empty.
+    uint64_t percentile(double p) const;
+
+private:
+    static size_t   bucket_index(uint64_t ns);
+    static uint64_t bucket_upper_bound(size_t index);
+
+    std::array<uint64_t, kBucketCount> buckets_;
+    uint64_t                           count_;
+};
+
+// Resources used by the calling thread: number of heap allocations (calls to
+// malloc, calloc and realloc, only counted with the GNU C library) and
+// context switches. The system calls themselves are not counted: only those
+// that block the thread (lock contention, I/O, page faults on mapped files,
+// ...) show up, as voluntary context switches. Involuntary context switches
+// are preemptions by the scheduler.
+struct ThreadResourceUsage
+{
+    uint64_t allocations{0};
+    uint64_t voluntary_switches{0};
+    uint64_t involuntary_switches{0};
+
+    static ThreadResourceUsage current();
+
+    ThreadResourceUsage operator-(const ThreadResourceUsage& u) const;
+};
+
+// Latency and resource usage of an operation run by (possibly) several
+// benchmark threads. Every thread measures its own calls, and the measures
+// are merged once all the threads are done.
+class OperationProfiler
+{
+public:
+    // Number of calls of the operation made before the measurements, so that
+    // the per-thread caches and pools are populated: the reported numbers are
+    // those of the steady state.
+    static constexpr unsigned kWarmUpCount = 16;
+
+    // Run op in the benchmark loop and set the following counters:
+    //   - p50_us, p99_us, p999_us: latency percentiles of op, over all the
+    //     threads;
+    //   - allocs/op, vol_cs/op, invol_cs/op: heap allocations and context
+    //     switches per call of op.
+    template<class F>
+    void run(benchmark::State& st, F&& op)
+    {
+        LatencyHistogram    latency;
+        ThreadResourceUsage start;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            running_++;
+        }
+
+        for (unsigned i = 0; i < kWarmUpCount; i++) {
+            op();
+        }
+
+        bool first = true;
+        for (auto _ : st) {
+            // start counting once all the threads are running
+            if (first) {
+                start = ThreadResourceUsage::current();
+                first = false;
+            }
+            const uint64_t begin = now_ns();
+            op();
+            latency.record(now_ns() - begin);
+        }
+        const ThreadResourceUsage usage = ThreadResourceUsage::current() - start;
+
+        st.SetItemsProcessed(int64_t(st.iterations()));
+        st.counters["allocs/op"] = benchmark::Counter(
+            double(usage.allocations), benchmark::Counter::kAvgIterations);
+        st.counters["vol_cs/op"]
+            = benchmark::Counter(double(usage.voluntary_switches),
+                                 benchmark::Counter::kAvgIterations);
+        st.counters["invol_cs/op"]
+            = benchmark::Counter(double(usage.involuntary_switches),
+                                 benchmark::Counter::kAvgIterations);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        latency_.merge(latency);
+        running_--;
+
+        if (running_ == 0) {
+            // The counters are summed over the threads: only the last thread
+            // reports the percentiles
+            st.counters["p50_us"]  = double(latency_.percentile(0.5)) / 1e3;
+            st.counters["p99_us"]  = double(latency_.percentile(0.99)) / 1e3;
+            st.counters["p999_us"] = double(latency_.percentile(0.999)) / 1e3;
+            latency_.clear();
+        }
+    }
+
+private:
+    static uint64_t now_ns();
+
+    std::mutex       mtx_;
+    unsigned         running_{0};
+    LatencyHistogram latency_;
+};
+
+} // namespace bench
+} // namespace sse
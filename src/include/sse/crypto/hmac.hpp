@@ -155,6 +155,55 @@ public:
     ///
     std::array<uint8_t, H::kDigestSize> hmac(const std::string& s) const;
 
+    ///
+    /// @class Batch
+    /// @brief Successive HMac evaluations with the same key
+    ///
+    /// hmac() unlocks the key and allocates its working buffer on every call.
+    /// A Batch object does it only once, for all the evaluations made through
+    /// it, and locks the key again upon destruction. It must not outlive the
+    /// HMac object it has been created from.
+    ///
+    class Batch
+    {
+    public:
+        ///
+        /// @brief Constructor
+        ///
+        /// @param hmac         The HMac object to be evaluated
+        /// @param max_length   The maximum size (in bytes) of the inputs
+        ///
+        Batch(const HMac<H, N>& hmac, const size_t max_length);
+
+        /// @brief Destructor
+        ~Batch();
+
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+
+        ///
+        /// @brief Evaluate HMac
+        ///
+        /// Same as HMac::hmac(in, length, out, out_len).
+        ///
+        /// @exception std::invalid_argument       One of in or out is NULL
+        /// @exception std::invalid_argument       out_len is larger than
+        /// kDigestSize
+        /// @exception std::invalid_argument       length is larger than the
+        /// max_length argument of the constructor
+        ///
+        void hmac(const unsigned char* in,
+                  const size_t         length,
+                  unsigned char*       out,
+                  const size_t         out_len = kDigestSize);
+
+    private:
+        const HMac<H, N>& hmac_;
+        size_t            max_length_;
+        size_t            buffer_len_;
+        uint8_t*          buffer_;
+    };
+
 private:
     Key<kKeySize> key_;
 };
@@ -166,6 +215,37 @@ void HMac<H, N>::hmac(const unsigned char* in,
                       const size_t         length,
                       unsigned char*       out,
                       const size_t         out_len) const
+{
+    Batch batch(*this, length);
+
+    batch.hmac(in, length, out, out_len);
+}
+
+template<class H, uint16_t N>
+HMac<H, N>::Batch::Batch(const HMac<H, N>& hmac, const size_t max_length)
+    : hmac_(hmac), max_length_(max_length),
+      buffer_len_(((kHMACKeySize + max_length) > kDigestSize)
+                      ? (kHMACKeySize + max_length)
+                      : (kDigestSize)),
+      buffer_(static_cast<uint8_t*>(sodium_malloc(buffer_len_)))
+{
+    hmac_.key_.unlock();
+}
+
+template<class H, uint16_t N>
+HMac<H, N>::Batch::~Batch()
+{
+    sodium_memzero(buffer_, buffer_len_);
+    sodium_free(buffer_);
+
+    hmac_.key_.lock();
+}
+
+template<class H, uint16_t N>
+void HMac<H, N>::Batch::hmac(const unsigned char* in,
+                             const size_t         length,
+                             unsigned char*       out,
+                             const size_t         out_len)
 {
     if (out_len > kDigestSize) {
         throw std::invalid_argument(
@@ -180,18 +260,20 @@ void HMac<H, N>::hmac(const unsigned char* in,
         throw std::invalid_argument("out is NULL");
     }
 
-    uint8_t*         buffer;
-    size_t           i_len      = kHMACKeySize + length;
-    constexpr size_t tmp_len    = kHMACKeySize + kDigestSize;
-    size_t           buffer_len = (i_len > kDigestSize) ? i_len : (kDigestSize);
+    if (length > max_length_) {
+        throw std::invalid_argument(
+            "Invalid input length: length > max_length");
+    }
 
-    buffer = static_cast<uint8_t*>(sodium_malloc(buffer_len));
-    uint8_t tmp[tmp_len];
+    const Key<kKeySize>& key = hmac_.key_;
 
-    key_.unlock();
+    uint8_t*         buffer = buffer_;
+    size_t           i_len  = kHMACKeySize + length;
+    constexpr size_t tmp_len = kHMACKeySize + kDigestSize;
+    uint8_t          tmp[tmp_len];
 
     // copy the key to the buffer
-    memcpy(buffer, key_.data(), kKeySize);
+    memcpy(buffer, key.data(), kKeySize);
 
     // set the other bytes to 0x00
     if (kKeySize < kHMACKeySize) {
@@ -208,7 +290,7 @@ void HMac<H, N>::hmac(const unsigned char* in,
     H::hash(buffer, i_len, buffer);
 
     // prepend the key
-    memcpy(tmp, key_.data(), kKeySize);
+    memcpy(tmp, key.data(), kKeySize);
     // set the other bytes to 0x00
     if (kKeySize < kHMACKeySize) {
         memset(tmp + kKeySize, 0x00, kHMACKeySize - kKeySize);
@@ -226,12 +308,7 @@ void HMac<H, N>::hmac(const unsigned char* in,
 
     memcpy(out, buffer, out_len);
 
-    sodium_memzero(buffer, buffer_len);
-    sodium_free(buffer);
-
     sodium_memzero(tmp, tmp_len);
-
-    key_.lock();
 }
 
 template<class H, uint16_t N>
@@ -31,6 +31,7 @@
 #include <algorithm>
 #include <array>
 #include <string>
+#include <vector>
 
 namespace sse {
 
@@ -137,6 +138,21 @@ public:
     template<size_t L>
     std::array<uint8_t, NBYTES> prf(const std::array<uint8_t, L>& in) const;
 
+    ///
+    /// @brief Evaluate the PRF on several inputs
+    ///
+    /// Evaluates the PRF on every string of in, and places the results in out
+    /// (resized to the size of in). This is faster than successive calls to
+    /// prf(): the key is unlocked, and the internal buffers are allocated,
+    /// only once for all the inputs.
+    ///
+    ///
+    /// @param in       The input strings.
+    /// @param out      The reference to the output vector.
+    ///
+    void prf_batch(const std::vector<std::string>&           in,
+                   std::vector<std::array<uint8_t, NBYTES>>& out) const;
+
     ///
     /// @brief Derive a key using the PRF
     ///
@@ -187,6 +203,15 @@ private:
     /// @brief Inner implementation of the PRF
     using PrfBase = HMac<Hash, kKeySize>;
 
+    /// @internal
+    /// @brief Evaluate the PRF through an HMac batch. tmp must have room for
+    /// length + 1 bytes.
+    static void evaluate(typename PrfBase::Batch& batch,
+                         const unsigned char*     in,
+                         const size_t             length,
+                         unsigned char*           tmp,
+                         uint8_t*                 result);
+
     PrfBase base_;
 };
 
@@ -203,14 +228,35 @@ std::array<uint8_t, NBYTES> Prf<NBYTES>::prf(const unsigned char* in,
         throw std::invalid_argument("in is NULL");
     }
 
+    typename PrfBase::Batch     batch(base_, length + 1);
+    std::array<uint8_t, NBYTES> result;
+
+    if (NBYTES > PrfBase::kDigestSize) {
+        unsigned char* tmp = new unsigned char[length + 1];
+
+        evaluate(batch, in, length, tmp, result.data());
+
+        sodium_memzero(tmp, length + 1);
+        delete[] tmp;
+    } else {
+        evaluate(batch, in, length, nullptr, result.data());
+    }
+
+    return result;
+}
+
+template<uint16_t NBYTES>
+void Prf<NBYTES>::evaluate(typename PrfBase::Batch& batch,
+                           const unsigned char*     in,
+                           const size_t             length,
+                           unsigned char*           tmp,
+                           uint8_t*                 result)
+{
     static_assert(
         NBYTES != 0,
         "PRF output length invalid: length must be strictly larger than 0");
 
-    std::array<uint8_t, NBYTES> result;
-
     if (NBYTES > PrfBase::kDigestSize) {
-        unsigned char* tmp = new unsigned char[length + 1];
         memcpy(tmp, in, length);
 
         uint16_t pos = 0;
@@ -221,25 +267,47 @@ std::array<uint8_t, NBYTES> Prf<NBYTES>::prf(const unsigned char* in,
 
             // fill res
             if (static_cast<size_t>(NBYTES - pos) >= PrfBase::kDigestSize) {
-                base_.hmac(
-                    tmp, length + 1, result.data() + pos, PrfBase::kDigestSize);
+                batch.hmac(
+                    tmp, length + 1, result + pos, PrfBase::kDigestSize);
             } else {
-                base_.hmac(tmp,
+                batch.hmac(tmp,
                            length + 1,
-                           result.data() + pos,
+                           result + pos,
                            static_cast<size_t>(NBYTES - pos));
             }
         }
-
-        sodium_memzero(tmp, length + 1);
-        delete[] tmp;
     } else if (NBYTES <= Hash::kDigestSize) {
         // only need one output bloc of PrfBase.
-        base_.hmac(in, length, result.data(), result.size());
+        batch.hmac(in, length, result, NBYTES);
     }
+}
 
+template<uint16_t NBYTES>
+void Prf<NBYTES>::prf_batch(const std::vector<std::string>&           in,
+                            std::vector<std::array<uint8_t, NBYTES>>& out) const
+{
+    size_t max_length = 0;
+    for (const auto& s : in) {
+        max_length = std::max(max_length, s.length());
+    }
 
-    return result;
+    out.resize(in.size());
+    if (in.empty()) {
+        return;
+    }
+
+    typename PrfBase::Batch    batch(base_, max_length + 1);
+    std::vector<unsigned char> tmp(max_length + 1);
+
+    for (size_t j = 0; j < in.size(); j++) {
+        evaluate(batch,
+                 reinterpret_cast<const unsigned char*>(in[j].data()),
+                 in[j].length(),
+                 tmp.data(),
+                 out[j].data());
+    }
+
+    sodium_memzero(tmp.data(), tmp.size());
 }
 
 // Convienience function to run the PRF over a C++ string
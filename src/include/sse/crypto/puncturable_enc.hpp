@@ -66,6 +66,20 @@ const static size_t kMasterKeySize = 32;
 /// @brief Type of a master key for puncturable encryption
 using master_key_type = Key<kMasterKeySize>;
 
+/// @brief Derivation of the secret scalars from the master key
+///
+/// The key shares generated with one mode are incompatible with the ones
+/// generated with the other: all the key shares of a punctured key must be
+/// generated with the same mode, and the mode must be kept with the master key.
+enum class ScalarDerivation : uint8_t
+{
+    /// One PRF evaluation per scalar. This is the original derivation.
+    kLabeledPrf = 1,
+    /// The scalars are read from a ChaCha20 stream keyed by a single PRF
+    /// evaluation. It makes key share generation cheaper.
+    kChaChaStream = 2,
+};
+
 /// @relatesalso PuncturableEncryption
 const static size_t kCiphertextSize = 90;
 /// @brief Type of a ciphertext created using puncturable encryption
@@ -73,6 +87,28 @@ const static size_t kCiphertextSize = 90;
 using ciphertext_type = std::array<uint8_t, kCiphertextSize>;
 
 
+/// @brief Size of an uncompressed key share (in bytes)
+///
+/// Uncompressed key shares are almost twice as large as the regular ones,
+/// but loading them does not involve any point decompression (each of which
+/// requires a square root computation). They are meant for keys stored
+/// locally, when the storage is cheaper than the decryptor's setup time.
+const static size_t kUncompressedKeyShareSize = 403;
+/// @brief Type of an uncompressed key share
+using uncompressed_key_share_type
+    = std::array<uint8_t, kUncompressedKeyShareSize>;
+/// @brief Type of a punctured key made of uncompressed key shares
+using uncompressed_punctured_key_type
+    = std::vector<uncompressed_key_share_type>;
+
+/// @brief Size of an uncompressed ciphertext (in bytes)
+const static size_t kUncompressedCiphertextSize = 154;
+/// @brief Type of an uncompressed ciphertext, whose decryption does not
+/// involve any point decompression
+using uncompressed_ciphertext_type
+    = std::array<uint8_t, kUncompressedCiphertextSize>;
+
+
 /// @brief Extracts the tag associated to a key share
 /// @relatesalso PuncturableEncryption
 inline tag_type extract_tag(const key_share_type& keyshare)
@@ -82,6 +118,15 @@ inline tag_type extract_tag(const key_share_type& keyshare)
     return tag;
 }
 
+/// @brief Extracts the tag associated to an uncompressed key share
+/// @relatesalso PuncturableEncryption
+inline tag_type extract_tag(const uncompressed_key_share_type& keyshare)
+{
+    tag_type tag;
+    std::copy(keyshare.end() - kTagSize, keyshare.end(), tag.begin());
+    return tag;
+}
+
 /// @brief Extracts the tag associated to a ciphertext
 /// @relatesalso PuncturableEncryption
 inline tag_type extract_tag(const ciphertext_type& ciphertext)
@@ -91,6 +136,23 @@ inline tag_type extract_tag(const ciphertext_type& ciphertext)
     return tag;
 }
 
+/// @brief Extracts the tag associated to an uncompressed ciphertext
+/// @relatesalso PuncturableEncryption
+inline tag_type extract_tag(const uncompressed_ciphertext_type& ciphertext)
+{
+    tag_type tag;
+    std::copy(ciphertext.end() - kTagSize, ciphertext.end(), tag.begin());
+    return tag;
+}
+
+/// @brief Converts a key share to its uncompressed representation
+/// @relatesalso PuncturableDecryption
+uncompressed_key_share_type uncompress(const key_share_type& keyshare);
+
+/// @brief Converts a ciphertext to its uncompressed representation
+/// @relatesalso PuncturableDecryption
+uncompressed_ciphertext_type uncompress(const ciphertext_type& ciphertext);
+
 } // namespace punct
 
 
@@ -115,10 +177,14 @@ public:
     /// key. After a call to the constructor, the input key is held by the
     /// PuncturableEncryption object, and cannot be re-used.
     ///
-    /// @param key  The key used to initialize the PuncturableEncryption.
-    ///             Upon return, key is empty
+    /// @param key          The key used to initialize the
+    ///                     PuncturableEncryption. Upon return, key is empty
+    /// @param derivation   The derivation of the secret scalars from key.
     ///
-    explicit PuncturableEncryption(punct::master_key_type&& key);
+    explicit PuncturableEncryption(
+        punct::master_key_type&& key,
+        punct::ScalarDerivation  derivation
+        = punct::ScalarDerivation::kLabeledPrf);
 
     PuncturableEncryption(const PuncturableEncryption&) = delete;
 
@@ -179,6 +245,27 @@ public:
     punct::key_share_type inc_puncture(const size_t           d,
                                        const punct::tag_type& tag);
 
+    ///
+    /// @brief Generate the keyshares of several punctures at once
+    ///
+    /// Generates the keyshares for the tags[k], for d_start + k punctures.
+    /// The result is the same as calling inc_puncture(d_start + k, tags[k])
+    /// for every tag, but the keyshares are generated in parallel, and their
+    /// common computations are done once.
+    ///
+    /// @param d_start  The number of punctures of the first keyshare. Must be
+    ///                 strictly positive.
+    /// @param tags     The punctured tags.
+    ///
+    /// @return         The keyshares, in the order of tags.
+    ///
+    /// @exception  std::invalid_argument   One of the tags is the NULL tag, or
+    ///                                     d_start is 0.
+    ///
+    std::vector<punct::key_share_type> inc_puncture_batch(
+        const size_t                        d_start,
+        const std::vector<punct::tag_type>& tags);
+
 private:
     /// @class PEncImpl
     /// @brief Hidden puncturable encryption implementation
@@ -204,12 +291,34 @@ public:
     /// Creates a PuncturableDecryption object from a punctured_key, i.e. from
     /// a list of keyshares (cf. the description of punct::punctured_key_type).
     ///
+    /// Only the framing of the keyshares is checked here: their points are
+    /// decoded by the first decryption, which reports the invalid points.
+    ///
     /// @param punctured_key    The list of keyshare used to initialize the
     ///                         PuncturableDecryption object.
     ///
+    /// @exception std::invalid_argument    punctured_key is empty, or one of
+    ///                                     its points is not properly encoded
+    ///
     explicit PuncturableDecryption(
         const punct::punctured_key_type& punctured_key);
 
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a PuncturableDecryption object from a punctured key made of
+    /// uncompressed keyshares (cf. punct::uncompress). As for the compressed
+    /// keys, the points are decoded by the first decryption.
+    ///
+    /// @param punctured_key    The list of keyshare used to initialize the
+    ///                         PuncturableDecryption object.
+    ///
+    /// @exception std::invalid_argument    punctured_key is empty, or one of
+    ///                                     its points is not properly encoded
+    ///
+    explicit PuncturableDecryption(
+        const punct::uncompressed_punctured_key_type& punctured_key);
+
     PuncturableDecryption(const PuncturableDecryption&) = delete;
 
     // Avoid any assignment of decryption objects
@@ -235,8 +344,58 @@ public:
     /// @return     true if the decryption succeeded, false if the tag with
     ///             which the message was encrypted was punctured.
     ///
+    /// @exception std::exception   The points of the punctured key could not
+    ///                             be decoded. The key is only decoded once:
+    ///                             the next decryptions rethrow the same
+    ///                             exception.
+    ///
     bool decrypt(const punct::ciphertext_type& ct, uint64_t& m);
 
+    ///
+    /// @brief Decrypt an uncompressed ciphertext
+    ///
+    /// Same as decrypt, for the ciphertexts converted with punct::uncompress.
+    ///
+    /// @param ct   The ciphertext to decrypt
+    /// @param m    The result of the decryption
+    ///
+    /// @return     true if the decryption succeeded, false if the tag with
+    ///             which the message was encrypted was punctured.
+    ///
+    bool decrypt(const punct::uncompressed_ciphertext_type& ct, uint64_t& m);
+
+    ///
+    /// @brief Decrypt a batch of ciphertexts
+    ///
+    /// Decrypts all the ciphertexts of cts. The result is the same as calling
+    /// decrypt on each ciphertext, but the work common to the ciphertexts is
+    /// only done once, and the decryptions are spread among the available
+    /// threads.
+    ///
+    /// @param cts  The ciphertexts to decrypt
+    /// @param ms   The results of the decryptions: ms[i] is the decryption
+    ///             of cts[i]
+    /// @param ok   ok[i] is true if the decryption of cts[i] succeeded, false
+    ///             if the tag with which it was encrypted was punctured.
+    ///
+    /// @exception std::exception   The points of the punctured key could not
+    ///                             be decoded (cf. decrypt).
+    ///
+    void decrypt_batch(const std::vector<punct::ciphertext_type>& cts,
+                       std::vector<uint64_t>&                     ms,
+                       std::vector<bool>&                         ok);
+
+    ///
+    /// @brief Decrypt a batch of uncompressed ciphertexts
+    ///
+    /// Same as decrypt_batch, for the ciphertexts converted with
+    /// punct::uncompress.
+    ///
+    void decrypt_batch(
+        const std::vector<punct::uncompressed_ciphertext_type>& cts,
+        std::vector<uint64_t>&                                  ms,
+        std::vector<bool>&                                      ok);
+
 private:
     /// @class PDecImpl
     /// @brief Hidden puncturable decryption implementation
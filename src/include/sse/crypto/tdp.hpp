@@ -27,7 +27,9 @@
 #include <cstdint>
 
 #include <array>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace sse {
 namespace crypto {
@@ -46,6 +48,76 @@ namespace crypto {
 class TdpImpl;         // not defined in the header
 class TdpInverseImpl;  // not defined in the header
 class TdpMultPoolImpl; // not defined in the header
+class TdpChainImpl;    // not defined in the header
+
+class Tdp;
+class TdpInverse;
+class TdpMultPool;
+
+/// @class TdpChain
+/// @brief Iterated evaluation or inversion of a trapdoor permutation.
+///
+/// TdpChain walks the sequence \f$ x, \pi(x), \pi^2(x), \dots\f$ (when
+/// created by eval_chain) or \f$ x, \pi^{-1}(x), \pi^{-2}(x), \dots\f$
+/// (when created by TdpInverse::invert_chain). The current element is kept in
+/// the internal representation of the TDP implementation between the steps,
+/// so walking a chain of length n costs n modular exponentiations: the
+/// serialization of the current element is only done when it is requested.
+///
+/// A TdpChain does not depend on the lifetime of the TDP it was created from.
+/// It is not thread-safe.
+///
+class TdpChain
+{
+public:
+    /// @brief  Size (in bytes) of a message.
+    static constexpr size_t kMessageSize = 256;
+
+    ///
+    /// @brief  Move constructor
+    ///
+    /// @param  c   The moved chain. It is invalid after the call.
+    ///
+    TdpChain(TdpChain&& c) noexcept;
+
+    TdpChain(const TdpChain& c) = delete;
+    TdpChain& operator=(const TdpChain& c) = delete;
+
+    ///
+    /// @brief  Destructor
+    ///
+    ~TdpChain();
+
+    ///
+    /// @brief Advance the chain by one step and get the new element
+    ///
+    /// @param  out The reference to the output byte array
+    ///
+    void next(std::array<uint8_t, kMessageSize>& out);
+
+    ///
+    /// @brief Advance the chain without serializing the intermediate elements
+    ///
+    /// @param  steps   The number of steps
+    ///
+    void advance(uint32_t steps);
+
+    ///
+    /// @brief Get the current element of the chain
+    ///
+    /// @param  out The reference to the output byte array
+    ///
+    void value(std::array<uint8_t, kMessageSize>& out) const;
+
+private:
+    friend class Tdp;
+    friend class TdpInverse;
+    friend class TdpMultPool;
+
+    explicit TdpChain(TdpChainImpl* chain_imp);
+
+    TdpChainImpl* chain_imp_; // opaque pointer
+};
 
 
 /// @class Tdp
@@ -54,6 +126,10 @@ class TdpMultPoolImpl; // not defined in the header
 /// Tdp is an opaque class implementing a the public key operations of a
 /// trapdoor permutation (TDP). It is currently based on RSA.
 ///
+/// The key and its precomputations are immutable: the copies of a Tdp share
+/// them (copying a Tdp does not copy the key), and can be used concurrently by
+/// several threads.
+///
 class Tdp
 {
 public:
@@ -72,9 +148,10 @@ public:
     /// @brief  Constructor
     ///
     /// Constructs a Tdp object from an RSA public key. The public key has to be
-    /// in the PEM format.
+    /// either in the PEM format, or in the binary format returned by
+    /// public_key_binary(). The latter is much faster to load.
     ///
-    /// @param  pk  String storing a public key in PEM format
+    /// @param  pk  String storing a public key in PEM or binary format
     ///
     /// @exception std::runtime_error   Parsing pk is an invalid RSA public key
     ///
@@ -83,18 +160,18 @@ public:
     ///
     /// @brief  Copy constructor
     ///
-    /// @param  t   The copied Tdp
+    /// The new Tdp shares the key of t.
     ///
-    /// @exception std::runtime_error   Failed to copy the Tdp RSA public key
+    /// @param  t   The copied Tdp
     ///
     Tdp(const Tdp& t);
 
     ///
     /// @brief  Assignement operator
     ///
-    /// @param  t   The copied Tdp
+    /// After the assignment, the Tdp shares the key of t.
     ///
-    /// @exception std::runtime_error   Failed to copy the Tdp RSA public key
+    /// @param  t   The copied Tdp
     ///
     Tdp& operator=(const Tdp& t);
 
@@ -106,13 +183,29 @@ public:
     ///
     /// @brief Get the public key
     ///
-    /// Creates and returns a string containing the public key of the TDP in the
-    /// PEM format
+    /// Returns a string containing the public key of the TDP in the PEM
+    /// format. The encoding is only computed on the first call.
     ///
     /// @return The public key in the PEM format
     ///
     std::string public_key() const;
 
+    ///
+    /// @brief Get the public key in binary format
+    ///
+    /// Returns a string containing the public key of the TDP in a raw binary
+    /// format (fixed-width big endian integers, and precomputed Montgomery
+    /// constants), that is much faster to load than the PEM format. The
+    /// format is specific to this library: use public_key() for
+    /// interchange.
+    ///
+    /// @return The public key in the binary format
+    ///
+    /// @exception std::runtime_error   The key does not fit in the binary
+    ///                                 format
+    ///
+    std::string public_key_binary() const;
+
     ///
     /// @brief Randomly sample a message
     ///
@@ -215,6 +308,37 @@ public:
         const Prf<Tdp::kRSAPrfSize>& prf,
         const std::string&           seed) const;
 
+    ///
+    /// @brief Randomly sample a batch of messages
+    ///
+    /// Samples n random valid messages for the TDP, and writes them to out
+    /// (resized to n). The randomness of all the messages is read at once.
+    ///
+    /// @param  n       The number of messages
+    /// @param  out     The reference to the output vector
+    ///
+    void sample_batch(
+        size_t                                          n,
+        std::vector<std::array<uint8_t, kMessageSize>>& out) const;
+
+    ///
+    /// @brief Pseudo-randomly generate a batch of messages
+    ///
+    /// Generates a message for every seed of seeds, and writes them to out
+    /// (resized to the size of seeds). out[i] is equal to
+    /// generate_array(prf, seeds[i]), but the batch is much faster to
+    /// generate than with successive calls to generate_array.
+    ///
+    /// @param  prf     The PRF used for the pseudo-random generation
+    ///                 of the messages.
+    /// @param  seeds   The values on which the PRF is evaluated
+    /// @param  out     The reference to the output vector
+    ///
+    void generate_batch(
+        const Prf<Tdp::kRSAPrfSize>&                    prf,
+        const std::vector<std::string>&                 seeds,
+        std::vector<std::array<uint8_t, kMessageSize>>& out) const;
+
 
     ///
     /// @brief Evaluate the TDP
@@ -256,8 +380,53 @@ public:
     std::array<uint8_t, kMessageSize> eval(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+    ///
+    /// @brief Evaluate the TDP
+    ///
+    /// Evaluates the TDP on the input message and writes the result to the
+    /// output byte array. in and out can be the same array.
+    ///
+    /// @param  in  The input message, stored in a byte array
+    /// @param  out The reference to the output byte array
+    ///
+    /// @exception std::runtime_error   Parsing in as a valid input failed
+    ///
+    void eval(const std::array<uint8_t, kMessageSize>& in,
+              std::array<uint8_t, kMessageSize>&       out) const;
+
+    ///
+    /// @brief Create a chain of iterated evaluations of the TDP
+    ///
+    /// Returns a chain starting at start, and whose steps are evaluations of
+    /// the TDP (i.e. computing \f$ \pi_{PK}^{k}(start)\f$ after k steps).
+    ///
+    /// @param  start   The first element of the chain
+    /// @return         The chain
+    ///
+    TdpChain eval_chain(const std::array<uint8_t, kMessageSize>& start) const;
+
+    ///
+    /// @brief Evaluate the TDP on a batch of messages
+    ///
+    /// Evaluates the TDP on every message of in, and writes the results to
+    /// out (resized to the size of in). The messages are split between
+    /// n_threads threads of an internal thread pool. in and out can be the
+    /// same vector.
+    ///
+    /// @param  in          The input messages
+    /// @param  out         The reference to the output vector
+    /// @param  n_threads   The number of threads. 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @exception std::runtime_error   Parsing an element of in as a valid
+    ///                                 input failed
+    ///
+    void eval_batch(const std::vector<std::array<uint8_t, kMessageSize>>& in,
+                    std::vector<std::array<uint8_t, kMessageSize>>&       out,
+                    unsigned int n_threads = 0) const;
+
 private:
-    TdpImpl* tdp_imp_; // opaque pointer
+    std::shared_ptr<const TdpImpl> tdp_imp_; // opaque pointer
 };
 
 /// @class TdpInverse
@@ -276,6 +445,11 @@ public:
     ///         operates). It is also the size of the RSA modulus.
     static constexpr size_t kMessageSize = Tdp::kMessageSize;
 
+    /// @brief  Maximum number of orders for which the exponents used by
+    ///         invert_mult are cached. The least recently used orders are
+    ///         evicted first.
+    static constexpr size_t kInvertMultCacheSize = 1024;
+
 
     ///
     /// @brief  Constructor
@@ -290,10 +464,13 @@ public:
     ///
     /// @brief  Constructor
     ///
-    /// Constructs a Tdp object from an RSA private key. The public key has to
-    /// be in the PKCS #8 PEM format.
+    /// Constructs a Tdp object from an RSA private key. The private key has to
+    /// be either in the PKCS #8 PEM format, or in the binary format returned
+    /// by private_key_binary(). The latter is much faster to load: the
+    /// consistency of its fields is checked, but not the primality of the
+    /// factors of the modulus.
     ///
-    /// @param  sk  String storing a private key in PEM format
+    /// @param  sk  String storing a private key in PEM or binary format
     ///
     /// @exception std::runtime_error   The input RSA key is invalid
     ///
@@ -312,23 +489,54 @@ public:
     ///
     /// @brief Get the public key
     ///
-    /// Creates and returns a string containing the public key of the TDP in the
-    /// PEM format
+    /// Returns a string containing the public key of the TDP in the PEM
+    /// format. The encoding is only computed on the first call.
     ///
     /// @return The public key in the PEM format
     ///
     std::string public_key() const;
 
+    ///
+    /// @brief Get the public key in binary format
+    ///
+    /// Returns a string containing the public key of the TDP in a raw binary
+    /// format (fixed-width big endian integers, and precomputed Montgomery
+    /// constants), that is much faster to load than the PEM format. The
+    /// format is specific to this library: use public_key() for
+    /// interchange.
+    ///
+    /// @return The public key in the binary format
+    ///
+    /// @exception std::runtime_error   The key does not fit in the binary
+    ///                                 format
+    ///
+    std::string public_key_binary() const;
+
     ///
     /// @brief Get the private key
     ///
-    /// Creates and returns a string containing the private key of the TDP in
-    /// the PKCS #8 PEM format
+    /// Returns a string containing the private key of the TDP in the PKCS #8
+    /// PEM format. The encoding is only computed on the first call.
     ///
     /// @return The private key in the PKCS #8 PEM format
     ///
     std::string private_key() const;
 
+    ///
+    /// @brief Get the private key in binary format
+    ///
+    /// Returns a string containing the private key of the TDP in a raw binary
+    /// format (fixed-width big endian integers, and precomputed Montgomery
+    /// constants), that is much faster to load than the PEM format.
+    ///
+    /// @return The private key in the binary format
+    ///
+    /// @exception std::runtime_error   The key does not fit in the binary
+    ///                                 format (the primes must be
+    ///                                 kMessageSize/2 bytes long at most)
+    ///
+    std::string private_key_binary() const;
+
     ///
     /// @brief Randomly sample a message
     ///
@@ -431,6 +639,37 @@ public:
         const Prf<Tdp::kRSAPrfSize>& prf,
         const std::string&           seed) const;
 
+    ///
+    /// @brief Randomly sample a batch of messages
+    ///
+    /// Samples n random valid messages for the TDP, and writes them to out
+    /// (resized to n). The randomness of all the messages is read at once.
+    ///
+    /// @param  n       The number of messages
+    /// @param  out     The reference to the output vector
+    ///
+    void sample_batch(
+        size_t                                          n,
+        std::vector<std::array<uint8_t, kMessageSize>>& out) const;
+
+    ///
+    /// @brief Pseudo-randomly generate a batch of messages
+    ///
+    /// Generates a message for every seed of seeds, and writes them to out
+    /// (resized to the size of seeds). out[i] is equal to
+    /// generate_array(prf, seeds[i]), but the batch is much faster to
+    /// generate than with successive calls to generate_array.
+    ///
+    /// @param  prf     The PRF used for the pseudo-random generation
+    ///                 of the messages.
+    /// @param  seeds   The values on which the PRF is evaluated
+    /// @param  out     The reference to the output vector
+    ///
+    void generate_batch(
+        const Prf<Tdp::kRSAPrfSize>&                    prf,
+        const std::vector<std::string>&                 seeds,
+        std::vector<std::array<uint8_t, kMessageSize>>& out) const;
+
 
     ///
     /// @brief Evaluate the TDP
@@ -472,6 +711,51 @@ public:
     std::array<uint8_t, kMessageSize> eval(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+    ///
+    /// @brief Evaluate the TDP
+    ///
+    /// Evaluates the TDP on the input message and writes the result to the
+    /// output byte array. in and out can be the same array.
+    ///
+    /// @param  in  The input message, stored in a byte array
+    /// @param  out The reference to the output byte array
+    ///
+    /// @exception std::runtime_error   Parsing in as a valid input failed
+    ///
+    void eval(const std::array<uint8_t, kMessageSize>& in,
+              std::array<uint8_t, kMessageSize>&       out) const;
+
+    ///
+    /// @brief Create a chain of iterated evaluations of the TDP
+    ///
+    /// Returns a chain starting at start, and whose steps are evaluations of
+    /// the TDP (i.e. computing \f$ \pi_{PK}^{k}(start)\f$ after k steps).
+    ///
+    /// @param  start   The first element of the chain
+    /// @return         The chain
+    ///
+    TdpChain eval_chain(const std::array<uint8_t, kMessageSize>& start) const;
+
+    ///
+    /// @brief Evaluate the TDP on a batch of messages
+    ///
+    /// Evaluates the TDP on every message of in, and writes the results to
+    /// out (resized to the size of in). The messages are split between
+    /// n_threads threads of an internal thread pool. in and out can be the
+    /// same vector.
+    ///
+    /// @param  in          The input messages
+    /// @param  out         The reference to the output vector
+    /// @param  n_threads   The number of threads. 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @exception std::runtime_error   Parsing an element of in as a valid
+    ///                                 input failed
+    ///
+    void eval_batch(const std::vector<std::array<uint8_t, kMessageSize>>& in,
+                    std::vector<std::array<uint8_t, kMessageSize>>&       out,
+                    unsigned int n_threads = 0) const;
+
     ///
     /// @brief Invert the TDP (private-key operation)
     ///
@@ -512,6 +796,20 @@ public:
     std::array<uint8_t, kMessageSize> invert(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+    ///
+    /// @brief Invert the TDP (private-key operation)
+    ///
+    /// Evaluates the inverse of the TDP on the input message and writes the
+    /// result to the output byte array. in and out can be the same array.
+    ///
+    /// @param  in  The input message, stored in a byte array
+    /// @param  out The reference to the output byte array
+    ///
+    /// @exception std::runtime_error   Parsing in as a valid input failed
+    ///
+    void invert(const std::array<uint8_t, kMessageSize>& in,
+                std::array<uint8_t, kMessageSize>&       out) const;
+
     ///
     /// @brief Invert the TDP multiple times
     ///
@@ -558,6 +856,92 @@ public:
         const std::array<uint8_t, kMessageSize>& in,
         uint32_t                                 order) const;
 
+    ///
+    /// @brief Invert the TDP multiple times
+    ///
+    /// Evaluates the inverse of the TDP on the input message order times (i.e.
+    /// compute \f$ \pi_{SK}^{-order}(in)\f$) and writes the result to the
+    /// output byte array. in and out can be the same array.
+    ///
+    /// @param  in      The input message, stored in a byte array
+    /// @param  out     The reference to the output byte array
+    /// @param  order   The number of times the inverse TDP is iterated on in
+    ///
+    /// @exception std::invalid_argument    Parsing in as a valid input failed
+    ///
+    void invert_mult(const std::array<uint8_t, kMessageSize>& in,
+                     std::array<uint8_t, kMessageSize>&       out,
+                     uint32_t                                 order) const;
+
+    ///
+    /// @brief Precompute the exponents used by invert_mult
+    ///
+    /// invert_mult uses the CRT exponents \f$ d_p^{order} \bmod (p-1)\f$ and
+    /// \f$ d_q^{order} \bmod (q-1)\f$. They are computed on the first call
+    /// with a given order, and cached (for at most kInvertMultCacheSize
+    /// different orders). This function fills the cache for all the orders
+    /// between first_order and last_order (included). If the range is larger
+    /// than kInvertMultCacheSize, only the last orders are cached.
+    ///
+    /// @param  first_order The first order of the range
+    /// @param  last_order  The last order of the range
+    ///
+    /// @exception std::invalid_argument    first_order > last_order
+    ///
+    void prewarm_invert_mult(uint32_t first_order, uint32_t last_order) const;
+
+    ///
+    /// @brief Create a chain of iterated inversions of the TDP
+    ///
+    /// Returns a chain starting at start, and whose steps are inversions of
+    /// the TDP (i.e. computing \f$ \pi_{SK}^{-k}(start)\f$ after k steps).
+    /// The steps are computed modulo the two RSA primes, and the results are
+    /// only recombined when an element of the chain is requested.
+    ///
+    /// @param  start   The first element of the chain
+    /// @return         The chain
+    ///
+    TdpChain invert_chain(const std::array<uint8_t, kMessageSize>& start) const;
+
+    ///
+    /// @brief Invert the TDP on a batch of messages
+    ///
+    /// Evaluates the inverse of the TDP on every message of in, and writes
+    /// the results to out (resized to the size of in). The messages are split
+    /// between n_threads threads of an internal thread pool. in and out can
+    /// be the same vector.
+    ///
+    /// @param  in          The input messages
+    /// @param  out         The reference to the output vector
+    /// @param  n_threads   The number of threads. 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @exception std::runtime_error   The inversion failed
+    ///
+    void invert_batch(const std::vector<std::array<uint8_t, kMessageSize>>& in,
+                      std::vector<std::array<uint8_t, kMessageSize>>&       out,
+                      unsigned int n_threads = 0) const;
+
+    ///
+    /// @brief Invert the TDP multiple times on a batch of messages
+    ///
+    /// Same as invert_batch, but computes \f$ \pi_{SK}^{-order}(x)\f$ for
+    /// every message x of in.
+    ///
+    /// @param  in          The input messages
+    /// @param  out         The reference to the output vector
+    /// @param  order       The number of times the inverse TDP is iterated
+    /// @param  n_threads   The number of threads. 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @exception std::runtime_error   The inversion failed
+    ///
+    void invert_mult_batch(
+        const std::vector<std::array<uint8_t, kMessageSize>>& in,
+        std::vector<std::array<uint8_t, kMessageSize>>&       out,
+        uint32_t                                              order,
+        unsigned int                                          n_threads = 0) const;
+
 private:
     TdpInverseImpl* tdp_inv_imp_; // opaque pointer
 };
@@ -571,6 +955,10 @@ private:
 /// quickly compute multiple iterative evaluations of the permutation (\f$
 /// \pi_{PK}^{c}(x)\f$). It is currently based on RSA.
 ///
+/// As for Tdp, the copies of a TdpMultPool share the key and the
+/// precomputed exponents of the pool, and can be used concurrently by
+/// several threads.
+///
 class TdpMultPool
 {
 public:
@@ -582,9 +970,10 @@ public:
     /// @brief  Constructor
     ///
     /// Constructs a TdpMultPool object from an RSA public key, and with a given
-    /// size. The public key has to be in the PEM format.
+    /// size. The public key has to be in the PEM format, or in the binary
+    /// format returned by public_key_binary().
     ///
-    /// @param  pk      String storing a public key in PEM format.
+    /// @param  pk      String storing a public key in PEM or binary format.
     /// @param  size    Size of the pool (i.e. the maximum order of the TDP
     ///                 evaluation). Must be strictly positive
     ///
@@ -598,18 +987,19 @@ public:
     ///
     /// @brief  Copy constructor
     ///
-    /// @param  pool    The copied Tdp pool
+    /// The new pool shares the key and the precomputations of pool.
     ///
-    /// @exception std::runtime_error   Failed to copy the TdpPool RSA key
+    /// @param  pool    The copied Tdp pool
     ///
     TdpMultPool(const TdpMultPool& pool);
 
     ///
     /// @brief  Assignement operator
     ///
-    /// @param  t   The copied Tdp pool
+    /// After the assignment, the pool shares the key and the precomputations
+    /// of t.
     ///
-    /// @exception std::runtime_error   Failed to copy the TdpPool RSA key
+    /// @param  t   The copied Tdp pool
     ///
     TdpMultPool& operator=(const TdpMultPool& t);
 
@@ -621,13 +1011,29 @@ public:
     ///
     /// @brief Get the public key
     ///
-    /// Creates and returns a string containing the public key of the TDP in the
-    /// PEM format
+    /// Returns a string containing the public key of the TDP in the PEM
+    /// format. The encoding is only computed on the first call.
     ///
     /// @return The public key in the PEM format
     ///
     std::string public_key() const;
 
+    ///
+    /// @brief Get the public key in binary format
+    ///
+    /// Returns a string containing the public key of the TDP in a raw binary
+    /// format (fixed-width big endian integers, and precomputed Montgomery
+    /// constants), that is much faster to load than the PEM format. The
+    /// format is specific to this library: use public_key() for
+    /// interchange.
+    ///
+    /// @return The public key in the binary format
+    ///
+    /// @exception std::runtime_error   The key does not fit in the binary
+    ///                                 format
+    ///
+    std::string public_key_binary() const;
+
     ///
     /// @brief Randomly sample a message
     ///
@@ -730,6 +1136,37 @@ public:
         const Prf<Tdp::kRSAPrfSize>& prf,
         const std::string&           seed) const;
 
+    ///
+    /// @brief Randomly sample a batch of messages
+    ///
+    /// Samples n random valid messages for the TDP, and writes them to out
+    /// (resized to n). The randomness of all the messages is read at once.
+    ///
+    /// @param  n       The number of messages
+    /// @param  out     The reference to the output vector
+    ///
+    void sample_batch(
+        size_t                                          n,
+        std::vector<std::array<uint8_t, kMessageSize>>& out) const;
+
+    ///
+    /// @brief Pseudo-randomly generate a batch of messages
+    ///
+    /// Generates a message for every seed of seeds, and writes them to out
+    /// (resized to the size of seeds). out[i] is equal to
+    /// generate_array(prf, seeds[i]), but the batch is much faster to
+    /// generate than with successive calls to generate_array.
+    ///
+    /// @param  prf     The PRF used for the pseudo-random generation
+    ///                 of the messages.
+    /// @param  seeds   The values on which the PRF is evaluated
+    /// @param  out     The reference to the output vector
+    ///
+    void generate_batch(
+        const Prf<Tdp::kRSAPrfSize>&                    prf,
+        const std::vector<std::string>&                 seeds,
+        std::vector<std::array<uint8_t, kMessageSize>>& out) const;
+
     ///
     /// @brief Evaluate the TDP
     ///
@@ -770,6 +1207,51 @@ public:
     std::array<uint8_t, kMessageSize> eval(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+    ///
+    /// @brief Evaluate the TDP
+    ///
+    /// Evaluates the TDP on the input message and writes the result to the
+    /// output byte array. in and out can be the same array.
+    ///
+    /// @param  in  The input message, stored in a byte array
+    /// @param  out The reference to the output byte array
+    ///
+    /// @exception std::runtime_error   Parsing in as a valid input failed
+    ///
+    void eval(const std::array<uint8_t, kMessageSize>& in,
+              std::array<uint8_t, kMessageSize>&       out) const;
+
+    ///
+    /// @brief Create a chain of iterated evaluations of the TDP
+    ///
+    /// Returns a chain starting at start, and whose steps are evaluations of
+    /// the TDP (i.e. computing \f$ \pi_{PK}^{k}(start)\f$ after k steps).
+    ///
+    /// @param  start   The first element of the chain
+    /// @return         The chain
+    ///
+    TdpChain eval_chain(const std::array<uint8_t, kMessageSize>& start) const;
+
+    ///
+    /// @brief Evaluate the TDP on a batch of messages
+    ///
+    /// Evaluates the TDP on every message of in, and writes the results to
+    /// out (resized to the size of in). The messages are split between
+    /// n_threads threads of an internal thread pool. in and out can be the
+    /// same vector.
+    ///
+    /// @param  in          The input messages
+    /// @param  out         The reference to the output vector
+    /// @param  n_threads   The number of threads. 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @exception std::runtime_error   Parsing an element of in as a valid
+    ///                                 input failed
+    ///
+    void eval_batch(const std::vector<std::array<uint8_t, kMessageSize>>& in,
+                    std::vector<std::array<uint8_t, kMessageSize>>&       out,
+                    unsigned int n_threads = 0) const;
+
     ///
     /// @brief Iteratively evaluate the TDP
     ///
@@ -832,7 +1314,7 @@ public:
     uint8_t maximum_order() const;
 
 private:
-    TdpMultPoolImpl* tdp_pool_imp_; // opaque pointer
+    std::shared_ptr<const TdpMultPoolImpl> tdp_pool_imp_; // opaque pointer
 };
 
 ///
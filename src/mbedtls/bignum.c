@@ -44,6 +44,15 @@
 
 #include <string.h>
 
+#if defined(MULADDC_ADX_CORE)
+#include <cpuid.h>
+#endif
+
+#if defined(MBEDTLS_MPI_LIMB_POOL)
+#include <pthread.h>
+#include <stdint.h>
+#endif
+
 #if defined(MBEDTLS_PLATFORM_C)
 #include "platform.h"
 #else
@@ -72,6 +81,154 @@ static void mbedtls_mpi_zeroize( mbedtls_mpi_uint *v, size_t n ) {
 #define BITS_TO_LIMBS(i)  ( (i) / biL + ( (i) % biL != 0 ) )
 #define CHARS_TO_LIMBS(i) ( (i) / ciL + ( (i) % ciL != 0 ) )
 
+#if defined(MBEDTLS_MPI_LIMB_POOL)
+
+#if ( MBEDTLS_MPI_POOL_MAX_LIMBS & ( MBEDTLS_MPI_POOL_MAX_LIMBS - 1 ) ) != 0
+#error "MBEDTLS_MPI_POOL_MAX_LIMBS must be a power of 2"
+#endif
+
+/*
+ * Per-thread pool of limb arrays.
+ * The arrays are sorted in size classes: class k holds arrays of 2^k limbs.
+ * A pooled array is zero, except for its first bytes which link it to the
+ * next array of the same class.
+ */
+typedef struct
+{
+    mbedtls_mpi_uint *head[sizeof( size_t ) * 8];   /*!< first array of each class */
+    size_t count[sizeof( size_t ) * 8];             /*!< size of each class        */
+}
+mpi_limb_pool;
+
+static pthread_key_t mpi_pool_key;
+static pthread_once_t mpi_pool_once = PTHREAD_ONCE_INIT;
+static int mpi_pool_key_ok = 0;
+
+/*
+ * Release the pool of an exiting thread
+ */
+static void mpi_pool_release( void *arg )
+{
+    mpi_limb_pool *pool = (mpi_limb_pool *) arg;
+    mbedtls_mpi_uint *p;
+    size_t k;
+
+    for( k = 0; k < sizeof( pool->head ) / sizeof( pool->head[0] ); k++ )
+    {
+        while( ( p = pool->head[k] ) != NULL )
+        {
+            memcpy( &pool->head[k], p, sizeof( void * ) );
+            mbedtls_free( p );
+        }
+    }
+
+    mbedtls_free( pool );
+}
+
+static void mpi_pool_key_init( void )
+{
+    mpi_pool_key_ok = ( pthread_key_create( &mpi_pool_key, mpi_pool_release ) == 0 );
+}
+
+/*
+ * Pool of the calling thread (NULL if the thread does not have one and
+ * create is 0, or if the pool cannot be created)
+ */
+static mpi_limb_pool *mpi_pool_get( int create )
+{
+    mpi_limb_pool *pool;
+
+    if( pthread_once( &mpi_pool_once, mpi_pool_key_init ) != 0 || !mpi_pool_key_ok )
+        return( NULL ); /* LCOV_EXCL_LINE */
+
+    pool = (mpi_limb_pool *) pthread_getspecific( mpi_pool_key );
+
+    if( pool == NULL && create )
+    {
+        pool = (mpi_limb_pool *) mbedtls_calloc( 1, sizeof( mpi_limb_pool ) );
+
+        if( pool != NULL && pthread_setspecific( mpi_pool_key, pool ) != 0 )
+        {
+            mbedtls_free( pool ); /* LCOV_EXCL_LINE */
+            pool = NULL;          /* LCOV_EXCL_LINE */
+        }
+    }
+
+    return( pool );
+}
+
+/*
+ * Size class of an array of n limbs: the smallest k such that n <= 2^k,
+ * and such that the array can hold the link to the next pooled array
+ */
+static size_t mpi_pool_class( size_t n )
+{
+    size_t k = 0;
+
+    while( ( (size_t) 1 << k ) < n ||
+           ( (size_t) 1 << k ) * ciL < sizeof( void * ) )
+        k++;
+
+    return( k );
+}
+
+#endif /* MBEDTLS_MPI_LIMB_POOL */
+
+/*
+ * Allocate an array of n zero limbs
+ */
+static mbedtls_mpi_uint *mpi_limbs_alloc( size_t n )
+{
+#if defined(MBEDTLS_MPI_LIMB_POOL)
+    if( n <= MBEDTLS_MPI_POOL_MAX_LIMBS )
+    {
+        /* the small arrays are always allocated with the size of their class,
+         * as they can end up in the pool of any thread */
+        size_t k = mpi_pool_class( n );
+        mpi_limb_pool *pool = mpi_pool_get( 1 );
+        mbedtls_mpi_uint *p;
+
+        if( pool != NULL && ( p = pool->head[k] ) != NULL )
+        {
+            memcpy( &pool->head[k], p, sizeof( void * ) );
+            memset( p, 0, sizeof( void * ) );
+            pool->count[k]--;
+            return( p );
+        }
+
+        return( (mbedtls_mpi_uint *) mbedtls_calloc( (size_t) 1 << k, ciL ) );
+    }
+#endif /* MBEDTLS_MPI_LIMB_POOL */
+
+    return( (mbedtls_mpi_uint *) mbedtls_calloc( n, ciL ) );
+}
+
+/*
+ * Erase and release an array of n limbs allocated by mpi_limbs_alloc
+ */
+static void mpi_limbs_free( mbedtls_mpi_uint *p, size_t n )
+{
+    mbedtls_mpi_zeroize( p, n );
+
+#if defined(MBEDTLS_MPI_LIMB_POOL)
+    if( n <= MBEDTLS_MPI_POOL_MAX_LIMBS )
+    {
+        size_t k = mpi_pool_class( n );
+        mpi_limb_pool *pool = mpi_pool_get( 0 );
+
+        if( pool != NULL && pool->count[k] < MBEDTLS_MPI_POOL_DEPTH )
+        {
+            memcpy( p, &pool->head[k], sizeof( void * ) );
+            pool->head[k] = p;
+            pool->count[k]++;
+            return;
+        }
+    }
+#endif /* MBEDTLS_MPI_LIMB_POOL */
+
+    mbedtls_free( p );
+}
+
 /*
  * Initialize one MPI
  */
@@ -94,10 +251,7 @@ void mbedtls_mpi_free( mbedtls_mpi *X )
         return;
 
     if( X->p != NULL )
-    {
-        mbedtls_mpi_zeroize( X->p, X->n );
-        mbedtls_free( X->p );
-    }
+        mpi_limbs_free( X->p, X->n );
 
     X->s = 1;
     X->n = 0;
@@ -116,14 +270,13 @@ int mbedtls_mpi_grow( mbedtls_mpi *X, size_t nblimbs )
 
     if( X->n < nblimbs )
     {
-        if( ( p = (mbedtls_mpi_uint*)mbedtls_calloc( nblimbs, ciL ) ) == NULL )
+        if( ( p = mpi_limbs_alloc( nblimbs ) ) == NULL )
             return( MBEDTLS_ERR_MPI_ALLOC_FAILED ); /* LCOV_EXCL_LINE */
 
         if( X->p != NULL )
         {
             memcpy( p, X->p, X->n * ciL );
-            mbedtls_mpi_zeroize( X->p, X->n );
-            mbedtls_free( X->p );
+            mpi_limbs_free( X->p, X->n );
         }
 
         X->n = nblimbs;
@@ -155,14 +308,13 @@ int mbedtls_mpi_shrink( mbedtls_mpi *X, size_t nblimbs )
     if( i < nblimbs )
         i = nblimbs;
 
-    if( ( p = (mbedtls_mpi_uint*)mbedtls_calloc( i, ciL ) ) == NULL )
+    if( ( p = mpi_limbs_alloc( i ) ) == NULL )
         return( MBEDTLS_ERR_MPI_ALLOC_FAILED );
 
     if( X->p != NULL )
     {
         memcpy( p, X->p, i * ciL );
-        mbedtls_mpi_zeroize( X->p, X->n );
-        mbedtls_free( X->p );
+        mpi_limbs_free( X->p, X->n );
     }
 
     X->n = i;
@@ -1027,6 +1179,81 @@ int mbedtls_mpi_sub_int( mbedtls_mpi *X, const mbedtls_mpi *A, mbedtls_mpi_sint
     return( mbedtls_mpi_sub_mpi( X, A, &_B ) );
 }
 
+#if defined(MULADDC_ADX_CORE)
+/*
+ * Runtime detection of the BMI2 (MULX) and ADX (ADCX/ADOX) extensions.
+ * The result is cached: 0 means unknown, 1 unsupported, 2 supported.
+ */
+static int mpi_cpu_has_adx( void )
+{
+    static int has_adx = 0;
+    int r = __atomic_load_n( &has_adx, __ATOMIC_RELAXED );
+
+    if( r == 0 )
+    {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+        r = 1;
+        if( __get_cpuid_max( 0, NULL ) >= 7 )
+        {
+            __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+            /* CPUID.(EAX=07H,ECX=0):EBX.BMI2[bit 8] and EBX.ADX[bit 19] */
+            if( ( ebx & ( 1u << 8 ) ) != 0 && ( ebx & ( 1u << 19 ) ) != 0 )
+                r = 2;
+        }
+        __atomic_store_n( &has_adx, r, __ATOMIC_RELAXED );
+    }
+
+    return( r == 2 );
+}
+
+/*
+ * Helper for mbedtls_mpi multiplication, BMI2/ADX version
+ */
+static void mpi_mul_hlp_adx( size_t i, mbedtls_mpi_uint *s, mbedtls_mpi_uint *d, mbedtls_mpi_uint b )
+{
+    mbedtls_mpi_uint c = 0;
+
+    for( ; i >= 16; i -= 16 )
+    {
+        MULADDC_ADX_INIT
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_STOP
+    }
+
+    for( ; i >= 8; i -= 8 )
+    {
+        MULADDC_ADX_INIT
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_CORE   MULADDC_ADX_CORE
+        MULADDC_ADX_STOP
+    }
+
+    for( ; i > 0; i-- )
+    {
+        MULADDC_ADX_INIT
+        MULADDC_ADX_CORE
+        MULADDC_ADX_STOP
+    }
+
+    do {
+        *d += c; c = ( *d < c ); d++;
+    }
+    while( c != 0 );
+}
+#endif /* MULADDC_ADX_CORE */
+
 /*
  * Helper for mbedtls_mpi multiplication
  */
@@ -1042,6 +1269,14 @@ void mpi_mul_hlp( size_t i, mbedtls_mpi_uint *s, mbedtls_mpi_uint *d, mbedtls_mp
 {
     mbedtls_mpi_uint c = 0, t = 0;
 
+#if defined(MULADDC_ADX_CORE)
+    if( mpi_cpu_has_adx() )
+    {
+        mpi_mul_hlp_adx( i, s, d, b );
+        return;
+    }
+#endif
+
 #if defined(MULADDC_HUIT)
     for( ; i >= 8; i -= 8 )
     {
@@ -1519,6 +1754,67 @@ static int mpi_montmul( mbedtls_mpi *A, const mbedtls_mpi *B, const mbedtls_mpi
     return( 0 );
 }
 
+/*
+ * Montgomery squaring: A = A * A * R^-1 mod N
+ *
+ * The cross products A[i] * A[j] (i < j) are only computed once and
+ * doubled before the squares A[i]^2 are added, and the 2n-limb product
+ * is then reduced. This saves about a quarter of the limb multiplications
+ * of mpi_montmul( A, A, ... ).
+ * A must be smaller than N. T must have (at least) 2 * ( N->n + 1 ) limbs,
+ * otherwise the generic multiplication is used.
+ */
+static int mpi_montsqr( mbedtls_mpi *A, const mbedtls_mpi *N, mbedtls_mpi_uint mm,
+                        const mbedtls_mpi *T )
+{
+    size_t i, n;
+    mbedtls_mpi_uint c, z, *d;
+
+    n = N->n;
+
+    if( T->n < 2 * ( n + 1 ) || T->p == NULL )
+        return( mpi_montmul( A, A, N, mm, T ) );
+
+    memset( T->p, 0, T->n * ciL );
+
+    d = T->p;
+
+    /*
+     * T = sum_{i < j} A[i] * A[j] * 2^(biL * (i + j))
+     */
+    for( i = 0; i + 1 < n; i++ )
+        mpi_mul_hlp( n - i - 1, A->p + i + 1, d + 2 * i + 1, A->p[i] );
+
+    /*
+     * T = 2 * T + sum_i A[i]^2 * 2^(2 * biL * i)
+     */
+    for( i = c = 0; i < 2 * n; i++ )
+    {
+        z = d[i] >> ( biL - 1 );
+        d[i] = ( d[i] << 1 ) | c;
+        c = z;
+    }
+
+    for( i = 0; i < n; i++ )
+        mpi_mul_hlp( 1, A->p + i, d + 2 * i, A->p[i] );
+
+    /*
+     * T = (T + U*N) / 2^(biL * n), with U chosen to clear the n lower limbs
+     */
+    for( i = 0; i < n; i++ )
+        mpi_mul_hlp( n, N->p, d + i, d[i] * mm );
+
+    memcpy( A->p, d + n, ( n + 1 ) * ciL );
+
+    if( mbedtls_mpi_cmp_abs( A, N ) >= 0 )
+        mpi_sub_hlp( n, N->p, A->p );
+    else
+        /* prevent timing attacks */
+        mpi_sub_hlp( n, A->p, T->p );
+
+    return( 0 );
+}
+
 /*
  * Montgomery reduction: A = A * R^-1 mod N
  */
@@ -1534,31 +1830,11 @@ static int mpi_montred( mbedtls_mpi *A, const mbedtls_mpi *N, mbedtls_mpi_uint m
 }
 
 /*
- * Sliding-window exponentiation: X = A^E mod N  (HAC 14.85)
+ * Window size used by the sliding-window exponentiation for the exponent E
  */
-int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E, const mbedtls_mpi *N, mbedtls_mpi *_RR )
+static size_t mpi_exp_window_size( const mbedtls_mpi *E )
 {
-    int ret;
-    size_t wbits, wsize, one = 1;
-    size_t i, j, nblimbs;
-    size_t bufsize, nbits;
-    mbedtls_mpi_uint ei, mm, state;
-    mbedtls_mpi RR, T, W[ 2 << MBEDTLS_MPI_WINDOW_SIZE ], Apos;
-    int neg;
-
-    if( mbedtls_mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
-        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
-
-    if( mbedtls_mpi_cmp_int( E, 0 ) < 0 )
-        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
-
-    /*
-     * Init temps and window size
-     */
-    mpi_montg_init( &mm, N );
-    mbedtls_mpi_init( &RR ); mbedtls_mpi_init( &T );
-    mbedtls_mpi_init( &Apos );
-    memset( W, 0, sizeof( W ) );
+    size_t i, wsize;
 
     i = mbedtls_mpi_bitlen( E );
 
@@ -1568,52 +1844,26 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
     if( wsize > MBEDTLS_MPI_WINDOW_SIZE )
         wsize = MBEDTLS_MPI_WINDOW_SIZE;
 
-    j = N->n + 1;
-    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, j ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &W[1],  j ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, j * 2 ) );
-
-    /*
-     * Compensate for negative A (and correct at the end)
-     */
-    neg = ( A->s == -1 );
-    if( neg )
-    {
-        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &Apos, A ) );
-        Apos.s = 1;
-        A = &Apos;
-    }
-
-    /*
-     * If 1st call, pre-compute R^2 mod N
-     */
-    if( _RR == NULL || _RR->p == NULL )
-    {
-        MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &RR, 1 ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_shift_l( &RR, N->n * 2 * biL ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &RR, &RR, N ) );
-
-        if( _RR != NULL )
-            memcpy( _RR, &RR, sizeof( mbedtls_mpi ) );
-    }
-    else
-        memcpy( &RR, _RR, sizeof( mbedtls_mpi ) );
-
-    /*
-     * W[1] = A * R^2 * R^-1 mod N = A * R mod N
-     */
-    if( mbedtls_mpi_cmp_mpi( A, N ) >= 0 )
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &W[1], A, N ) );
-    else
-        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &W[1], A ) );
-
-    MBEDTLS_MPI_CHK( mpi_montmul( &W[1], &RR, N, mm, &T ) );
+    return( wsize );
+}
 
-    /*
-     * X = R^2 * R^-1 mod N = R mod N
-     */
-    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, &RR ) );
-    MBEDTLS_MPI_CHK( mpi_montred( X, N, mm, &T ) );
+/*
+ * Sliding-window exponentiation in Montgomery form (HAC 14.85)
+ *
+ * On entry, X = R mod N and W[1] = A * R mod N, and both have (at least)
+ * N->n + 1 limbs. T has (at least) 2 * ( N->n + 1 ) limbs.
+ * On exit, X = A^E * R mod N.
+ * The other elements of W are used as the window table.
+ */
+static int mpi_mont_exp_window( mbedtls_mpi *X, mbedtls_mpi *W, size_t wsize,
+                                const mbedtls_mpi *E, const mbedtls_mpi *N,
+                                mbedtls_mpi_uint mm, mbedtls_mpi *T )
+{
+    int ret = 0;
+    size_t wbits, one = 1;
+    size_t i, j, nblimbs;
+    size_t bufsize, nbits;
+    mbedtls_mpi_uint ei, state;
 
     if( wsize > 1 )
     {
@@ -1626,7 +1876,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
         MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &W[j], &W[1]    ) );
 
         for( i = 0; i < wsize - 1; i++ )
-            MBEDTLS_MPI_CHK( mpi_montmul( &W[j], &W[j], N, mm, &T ) );
+            MBEDTLS_MPI_CHK( mpi_montsqr( &W[j], N, mm, T ) );
 
         /*
          * W[i] = W[i - 1] * W[1]
@@ -1636,7 +1886,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
             MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &W[i], N->n + 1 ) );
             MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &W[i], &W[i - 1] ) );
 
-            MBEDTLS_MPI_CHK( mpi_montmul( &W[i], &W[1], N, mm, &T ) );
+            MBEDTLS_MPI_CHK( mpi_montmul( &W[i], &W[1], N, mm, T ) );
         }
     }
 
@@ -1673,7 +1923,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
             /*
              * out of window, square X
              */
-            MBEDTLS_MPI_CHK( mpi_montmul( X, X, N, mm, &T ) );
+            MBEDTLS_MPI_CHK( mpi_montsqr( X, N, mm, T ) );
             continue;
         }
 
@@ -1691,12 +1941,12 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
              * X = X^wsize R^-1 mod N
              */
             for( i = 0; i < wsize; i++ )
-                MBEDTLS_MPI_CHK( mpi_montmul( X, X, N, mm, &T ) );
+                MBEDTLS_MPI_CHK( mpi_montsqr( X, N, mm, T ) );
 
             /*
              * X = X * W[wbits] R^-1 mod N
              */
-            MBEDTLS_MPI_CHK( mpi_montmul( X, &W[wbits], N, mm, &T ) );
+            MBEDTLS_MPI_CHK( mpi_montmul( X, &W[wbits], N, mm, T ) );
 
             state--;
             nbits = 0;
@@ -1709,14 +1959,127 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
      */
     for( i = 0; i < nbits; i++ )
     {
-        MBEDTLS_MPI_CHK( mpi_montmul( X, X, N, mm, &T ) );
+        MBEDTLS_MPI_CHK( mpi_montsqr( X, N, mm, T ) );
 
         wbits <<= 1;
 
         if( ( wbits & ( one << wsize ) ) != 0 )
-            MBEDTLS_MPI_CHK( mpi_montmul( X, &W[1], N, mm, &T ) );
+            MBEDTLS_MPI_CHK( mpi_montmul( X, &W[1], N, mm, T ) );
+    }
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Left-to-right square-and-multiply in Montgomery form (HAC 14.79), for
+ * short exponents
+ *
+ * On entry, A = a * R mod N has (at least) N->n + 1 limbs, and is not X.
+ * T has (at least) 2 * ( N->n + 1 ) limbs. E must be positive.
+ * On exit, X = a^E * R mod N.
+ */
+static int mpi_mont_exp_short( mbedtls_mpi *X, const mbedtls_mpi *A,
+                               const mbedtls_mpi *E, const mbedtls_mpi *N,
+                               mbedtls_mpi_uint mm, mbedtls_mpi *T )
+{
+    int ret;
+    size_t i;
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, A ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, N->n + 1 ) );
+
+    for( i = mbedtls_mpi_bitlen( E ) - 1; i > 0; i-- )
+    {
+        MBEDTLS_MPI_CHK( mpi_montsqr( X, N, mm, T ) );
+
+        if( mbedtls_mpi_get_bit( E, i - 1 ) == 1 )
+            MBEDTLS_MPI_CHK( mpi_montmul( X, A, N, mm, T ) );
     }
 
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Sliding-window exponentiation: X = A^E mod N  (HAC 14.85)
+ */
+int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E, const mbedtls_mpi *N, mbedtls_mpi *_RR )
+{
+    int ret;
+    size_t wsize, one = 1;
+    size_t i, j;
+    mbedtls_mpi_uint mm;
+    mbedtls_mpi RR, T, W[ 2 << MBEDTLS_MPI_WINDOW_SIZE ], Apos;
+    int neg;
+
+    if( mbedtls_mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    if( mbedtls_mpi_cmp_int( E, 0 ) < 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    /*
+     * Init temps and window size
+     */
+    mpi_montg_init( &mm, N );
+    mbedtls_mpi_init( &RR ); mbedtls_mpi_init( &T );
+    mbedtls_mpi_init( &Apos );
+    memset( W, 0, sizeof( W ) );
+
+    wsize = mpi_exp_window_size( E );
+
+    j = N->n + 1;
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, j ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &W[1],  j ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, j * 2 ) );
+
+    /*
+     * Compensate for negative A (and correct at the end)
+     */
+    neg = ( A->s == -1 );
+    if( neg )
+    {
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &Apos, A ) );
+        Apos.s = 1;
+        A = &Apos;
+    }
+
+    /*
+     * If 1st call, pre-compute R^2 mod N
+     */
+    if( _RR == NULL || _RR->p == NULL )
+    {
+        MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &RR, 1 ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_shift_l( &RR, N->n * 2 * biL ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &RR, &RR, N ) );
+
+        if( _RR != NULL )
+            memcpy( _RR, &RR, sizeof( mbedtls_mpi ) );
+    }
+    else
+        memcpy( &RR, _RR, sizeof( mbedtls_mpi ) );
+
+    /*
+     * W[1] = A * R^2 * R^-1 mod N = A * R mod N
+     */
+    if( mbedtls_mpi_cmp_mpi( A, N ) >= 0 )
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &W[1], A, N ) );
+    else
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &W[1], A ) );
+
+    MBEDTLS_MPI_CHK( mpi_montmul( &W[1], &RR, N, mm, &T ) );
+
+    /*
+     * X = R^2 * R^-1 mod N = R mod N
+     */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, &RR ) );
+    MBEDTLS_MPI_CHK( mpi_montred( X, N, mm, &T ) );
+
+    MBEDTLS_MPI_CHK( mpi_mont_exp_window( X, W, wsize, E, N, mm, &T ) );
+
     /*
      * X = A^E * R * R^-1 mod N = A^E mod N
      */
@@ -1741,6 +2104,253 @@ cleanup:
     return( ret );
 }
 
+/*
+ * Montgomery contexts
+ */
+void mbedtls_mpi_mont_init( mbedtls_mpi_mont_ctx *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+    mbedtls_mpi_init( &ctx->N );
+    mbedtls_mpi_init( &ctx->RR );
+    ctx->mm = 0;
+}
+
+int mbedtls_mpi_mont_setup( mbedtls_mpi_mont_ctx *ctx, const mbedtls_mpi *N )
+{
+    int ret;
+
+    if( mbedtls_mpi_cmp_int( N, 0 ) <= 0 || ( N->p[0] & 1 ) == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &ctx->N, N ) );
+    /* remove the leading zero limbs: N->n is the size of the Montgomery
+     * representation */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_shrink( &ctx->N, 0 ) );
+
+    mpi_montg_init( &ctx->mm, &ctx->N );
+
+    /*
+     * RR = R^2 mod N
+     */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &ctx->RR, 1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_shift_l( &ctx->RR, ctx->N.n * 2 * biL ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &ctx->RR, &ctx->RR, &ctx->N ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Montgomery context with a precomputed R^2 mod N
+ */
+int mbedtls_mpi_mont_setup_rr( mbedtls_mpi_mont_ctx *ctx, const mbedtls_mpi *N,
+                               const mbedtls_mpi *RR )
+{
+    int ret;
+    mbedtls_mpi X, T;
+
+    if( mbedtls_mpi_cmp_int( N, 0 ) <= 0 || ( N->p[0] & 1 ) == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    if( mbedtls_mpi_cmp_int( RR, 0 ) <= 0 || mbedtls_mpi_cmp_mpi( RR, N ) >= 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    mbedtls_mpi_init( &X ); mbedtls_mpi_init( &T );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &ctx->N, N ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_shrink( &ctx->N, 0 ) );
+
+    mpi_montg_init( &ctx->mm, &ctx->N );
+
+    /*
+     * R is invertible mod N: RR * R^-1 * R^-1 = 1 mod N iff RR = R^2 mod N
+     */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &X, RR ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &X, ctx->N.n + 1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, ( ctx->N.n + 1 ) * 2 ) );
+
+    MBEDTLS_MPI_CHK( mpi_montred( &X, &ctx->N, ctx->mm, &T ) );
+    MBEDTLS_MPI_CHK( mpi_montred( &X, &ctx->N, ctx->mm, &T ) );
+
+    if( mbedtls_mpi_cmp_int( &X, 1 ) != 0 )
+    {
+        ret = MBEDTLS_ERR_MPI_BAD_INPUT_DATA;
+        goto cleanup;
+    }
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &ctx->RR, RR ) );
+
+cleanup:
+
+    mbedtls_mpi_free( &X ); mbedtls_mpi_free( &T );
+
+    return( ret );
+}
+
+int mbedtls_mpi_mont_copy( mbedtls_mpi_mont_ctx *dst, const mbedtls_mpi_mont_ctx *src )
+{
+    int ret;
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->N, &src->N ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_shrink( &dst->N, 0 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RR, &src->RR ) );
+    dst->mm = src->mm;
+
+cleanup:
+
+    return( ret );
+}
+
+void mbedtls_mpi_mont_free( mbedtls_mpi_mont_ctx *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+    mbedtls_mpi_free( &ctx->N );
+    mbedtls_mpi_free( &ctx->RR );
+    ctx->mm = 0;
+}
+
+void mbedtls_mpi_mont_scratch_init( mbedtls_mpi_mont_scratch *S )
+{
+    size_t i;
+
+    if( S == NULL )
+        return;
+
+    mbedtls_mpi_init( &S->T );
+    for( i = 0; i < ( 2 << MBEDTLS_MPI_WINDOW_SIZE ); i++ )
+        mbedtls_mpi_init( &S->W[i] );
+}
+
+void mbedtls_mpi_mont_scratch_free( mbedtls_mpi_mont_scratch *S )
+{
+    size_t i;
+
+    if( S == NULL )
+        return;
+
+    mbedtls_mpi_free( &S->T );
+    for( i = 0; i < ( 2 << MBEDTLS_MPI_WINDOW_SIZE ); i++ )
+        mbedtls_mpi_free( &S->W[i] );
+}
+
+void mbedtls_mpi_mont_scratch_wipe( mbedtls_mpi_mont_scratch *S )
+{
+    size_t i;
+
+    if( S == NULL )
+        return;
+
+    if( S->T.p != NULL )
+        mbedtls_mpi_zeroize( S->T.p, S->T.n );
+    for( i = 0; i < ( 2 << MBEDTLS_MPI_WINDOW_SIZE ); i++ )
+    {
+        if( S->W[i].p != NULL )
+            mbedtls_mpi_zeroize( S->W[i].p, S->W[i].n );
+    }
+}
+
+/*
+ * Conversion to the Montgomery form: X = A * R mod N
+ */
+int mbedtls_mpi_mont_to( mbedtls_mpi *X, const mbedtls_mpi *A,
+                         const mbedtls_mpi_mont_ctx *ctx,
+                         mbedtls_mpi_mont_scratch *S )
+{
+    int ret;
+    const mbedtls_mpi *N = &ctx->N;
+
+    if( N->p == NULL )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    if( A->s < 0 || mbedtls_mpi_cmp_mpi( A, N ) >= 0 )
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( X, A, N ) );
+    else
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, A ) );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, N->n + 1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &S->T, ( N->n + 1 ) * 2 ) );
+
+    MBEDTLS_MPI_CHK( mpi_montmul( X, &ctx->RR, N, ctx->mm, &S->T ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Conversion from the Montgomery form: X = A * R^-1 mod N
+ */
+int mbedtls_mpi_mont_from( mbedtls_mpi *X, const mbedtls_mpi *A,
+                           const mbedtls_mpi_mont_ctx *ctx,
+                           mbedtls_mpi_mont_scratch *S )
+{
+    int ret;
+    const mbedtls_mpi *N = &ctx->N;
+
+    if( N->p == NULL )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, A ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, N->n + 1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &S->T, ( N->n + 1 ) * 2 ) );
+
+    MBEDTLS_MPI_CHK( mpi_montred( X, N, ctx->mm, &S->T ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Sliding-window exponentiation in Montgomery form
+ */
+int mbedtls_mpi_mont_exp( mbedtls_mpi *X, const mbedtls_mpi *A,
+                          const mbedtls_mpi *E,
+                          const mbedtls_mpi_mont_ctx *ctx,
+                          mbedtls_mpi_mont_scratch *S )
+{
+    int ret;
+    size_t j;
+    const mbedtls_mpi *N = &ctx->N;
+
+    if( N->p == NULL || mbedtls_mpi_cmp_int( E, 0 ) < 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    j = N->n + 1;
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &S->W[1], j ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &S->T, j * 2 ) );
+
+    /*
+     * W[1] = A (copied first, as X and A can be the same MPI)
+     */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &S->W[1], A ) );
+
+    if( mbedtls_mpi_cmp_int( E, 0 ) > 0 &&
+        mbedtls_mpi_bitlen( E ) <= MBEDTLS_MPI_SHORT_EXP_BITS )
+    {
+        return( mpi_mont_exp_short( X, &S->W[1], E, N, ctx->mm, &S->T ) );
+    }
+
+    /*
+     * X = R^2 * R^-1 mod N = R mod N
+     */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, &ctx->RR ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, j ) );
+    MBEDTLS_MPI_CHK( mpi_montred( X, N, ctx->mm, &S->T ) );
+
+    MBEDTLS_MPI_CHK( mpi_mont_exp_window( X, S->W, mpi_exp_window_size( E ),
+                                          E, N, ctx->mm, &S->T ) );
+
+cleanup:
+
+    return( ret );
+}
+
 /*
  * Greatest common divisor: G = gcd(A, B)  (HAC 14.54)
  */
@@ -72,6 +72,31 @@
 #define MBEDTLS_MPI_MAX_SIZE                              1024     /**< Maximum number of bytes for usable MPIs. */
 #endif /* !MBEDTLS_MPI_MAX_SIZE */
 
+#if !defined(MBEDTLS_MPI_POOL_MAX_LIMBS)
+/*
+ * Maximum number of limbs of the arrays recycled by the limb pool
+ * (see MBEDTLS_MPI_LIMB_POOL). Must be a power of 2.
+ * ( Default: 256 limbs => 16384 bits on 64-bit platforms, which covers the
+ *   temporaries of 4096-bit modular exponentiations )
+ */
+#define MBEDTLS_MPI_POOL_MAX_LIMBS                        256      /**< Maximum number of limbs of the pooled arrays. */
+#endif /* !MBEDTLS_MPI_POOL_MAX_LIMBS */
+
+#if !defined(MBEDTLS_MPI_POOL_DEPTH)
+/*
+ * Maximum number of arrays kept by the limb pool of a thread, for each size
+ * class. The excess arrays are returned to the heap.
+ */
+#define MBEDTLS_MPI_POOL_DEPTH                            32       /**< Maximum number of pooled arrays per size class. */
+#endif /* !MBEDTLS_MPI_POOL_DEPTH */
+
+/*
+ * Maximum size in bits of the exponents for which mbedtls_mpi_mont_exp uses
+ * square-and-multiply instead of the sliding window (below this size, the
+ * window would only contain one bit).
+ */
+#define MBEDTLS_MPI_SHORT_EXP_BITS                        23
+
 #define MBEDTLS_MPI_MAX_BITS                              ( 8 * MBEDTLS_MPI_MAX_SIZE )    /**< Maximum number of bits for usable MPIs. */
 
 /*
@@ -180,6 +205,34 @@ typedef struct
 }
 mbedtls_mpi;
 
+/**
+ * \brief          Montgomery context: modulus and precomputed constants.
+ *
+ *                 Once set up, the context is only read by the Montgomery
+ *                 functions, and can be shared between threads.
+ */
+typedef struct
+{
+    mbedtls_mpi N;          /*!<  the (odd) modulus         */
+    mbedtls_mpi RR;         /*!<  R^2 mod N                 */
+    mbedtls_mpi_uint mm;    /*!<  -N^-1 mod 2^biL           */
+}
+mbedtls_mpi_mont_ctx;
+
+/**
+ * \brief          Scratch space for the Montgomery functions.
+ *
+ *                 The scratch space grows on first use and is re-used by
+ *                 the subsequent calls. It must not be shared between
+ *                 threads.
+ */
+typedef struct
+{
+    mbedtls_mpi T;                                  /*!<  multiplication buffer  */
+    mbedtls_mpi W[ 2 << MBEDTLS_MPI_WINDOW_SIZE ];  /*!<  window table           */
+}
+mbedtls_mpi_mont_scratch;
+
 /**
  * \brief           Initialize one MPI (make internal references valid)
  *                  This just makes it ready to be set or freed,
@@ -669,6 +722,150 @@ int mbedtls_mpi_mod_int( mbedtls_mpi_uint *r, const mbedtls_mpi *A, mbedtls_mpi_
  */
 int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E, const mbedtls_mpi *N, mbedtls_mpi *_RR );
 
+/**
+ * \brief          Initialize a Montgomery context
+ *
+ * \param ctx      Montgomery context to be initialized
+ */
+void mbedtls_mpi_mont_init( mbedtls_mpi_mont_ctx *ctx );
+
+/**
+ * \brief          Set up a Montgomery context for the modulus N
+ *
+ * \param ctx      Montgomery context
+ * \param N        Modular MPI
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if N is negative or even
+ */
+int mbedtls_mpi_mont_setup( mbedtls_mpi_mont_ctx *ctx, const mbedtls_mpi *N );
+
+/**
+ * \brief          Set up a Montgomery context for the modulus N, with a
+ *                 precomputed value of R^2 mod N
+ *
+ * \param ctx      Montgomery context
+ * \param N        Modular MPI
+ * \param RR       R^2 mod N, as previously stored in a context for N
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if N is negative or even,
+ *                 or if RR is not R^2 mod N
+ *
+ * \note           RR is checked with two Montgomery reductions, which is
+ *                 much faster than the division done by
+ *                 mbedtls_mpi_mont_setup. R depends on the size of the
+ *                 limbs when the bit length of N is not a multiple of 64:
+ *                 the caller should fall back to mbedtls_mpi_mont_setup if
+ *                 the check fails.
+ */
+int mbedtls_mpi_mont_setup_rr( mbedtls_mpi_mont_ctx *ctx, const mbedtls_mpi *N,
+                               const mbedtls_mpi *RR );
+
+/**
+ * \brief          Copy the content of a Montgomery context
+ *
+ * \param dst      Destination context
+ * \param src      Source context
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed
+ */
+int mbedtls_mpi_mont_copy( mbedtls_mpi_mont_ctx *dst, const mbedtls_mpi_mont_ctx *src );
+
+/**
+ * \brief          Unallocate one Montgomery context
+ *
+ * \param ctx      Montgomery context to be unallocated
+ */
+void mbedtls_mpi_mont_free( mbedtls_mpi_mont_ctx *ctx );
+
+/**
+ * \brief          Initialize a Montgomery scratch space
+ *
+ * \param S        Scratch space to be initialized
+ */
+void mbedtls_mpi_mont_scratch_init( mbedtls_mpi_mont_scratch *S );
+
+/**
+ * \brief          Unallocate (and erase) a Montgomery scratch space
+ *
+ * \param S        Scratch space to be unallocated
+ */
+void mbedtls_mpi_mont_scratch_free( mbedtls_mpi_mont_scratch *S );
+
+/**
+ * \brief          Erase the content of a Montgomery scratch space, without
+ *                 unallocating it
+ *
+ * \param S        Scratch space to be erased
+ */
+void mbedtls_mpi_mont_scratch_wipe( mbedtls_mpi_mont_scratch *S );
+
+/**
+ * \brief          Conversion to the Montgomery form: X = A * R mod N
+ *
+ * \param X        Destination MPI
+ * \param A        Source MPI (reduced mod N if needed)
+ * \param ctx      Montgomery context
+ * \param S        Scratch space
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if ctx is not set up
+ */
+int mbedtls_mpi_mont_to( mbedtls_mpi *X, const mbedtls_mpi *A,
+                         const mbedtls_mpi_mont_ctx *ctx,
+                         mbedtls_mpi_mont_scratch *S );
+
+/**
+ * \brief          Conversion from the Montgomery form: X = A * R^-1 mod N
+ *
+ * \param X        Destination MPI
+ * \param A        Source MPI, in Montgomery form
+ * \param ctx      Montgomery context
+ * \param S        Scratch space
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if ctx is not set up
+ */
+int mbedtls_mpi_mont_from( mbedtls_mpi *X, const mbedtls_mpi *A,
+                           const mbedtls_mpi_mont_ctx *ctx,
+                           mbedtls_mpi_mont_scratch *S );
+
+/**
+ * \brief          Sliding-window exponentiation in Montgomery form:
+ *                 X = A^E * R^(1-E) mod N, i.e. the Montgomery form of
+ *                 a^E mod N when A is the Montgomery form of a.
+ *
+ * \param X        Destination MPI (can be A)
+ * \param A        Base MPI, in Montgomery form (0 <= A < N)
+ * \param E        Exponent MPI
+ * \param ctx      Montgomery context
+ * \param S        Scratch space
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if E is negative or if ctx
+ *                 is not set up
+ *
+ * \note           Contrary to mbedtls_mpi_exp_mod, there is no conversion
+ *                 to and from the Montgomery form: iterating the
+ *                 exponentiation on the same value only costs the
+ *                 exponentiations.
+ *
+ * \note           Short exponents (such as RSA public exponents) of at
+ *                 most MBEDTLS_MPI_SHORT_EXP_BITS bits use a plain
+ *                 square-and-multiply, without window table.
+ */
+int mbedtls_mpi_mont_exp( mbedtls_mpi *X, const mbedtls_mpi *A,
+                          const mbedtls_mpi *E,
+                          const mbedtls_mpi_mont_ctx *ctx,
+                          mbedtls_mpi_mont_scratch *S );
+
 /**
  * \brief          Fill an MPI X with size bytes of random
  *
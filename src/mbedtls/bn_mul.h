@@ -182,6 +182,35 @@
         : "rax", "rdx", "r8"                \
     );
 
+/*
+ * BMI2/ADX variant, selected at runtime by bignum.c.
+ * MULX does not modify the flags, which lets the low halves and the
+ * previous high half be accumulated on the CF chain (ADCX) while the
+ * destination limbs are accumulated on the OF chain (ADOX). Both chains
+ * are folded back into c by MULADDC_ADX_STOP, so the cores of a same
+ * INIT/STOP block must not be separated by flag-modifying instructions.
+ */
+#define MULADDC_ADX_INIT                    \
+    asm(                                    \
+        "xorl   %%r8d,   %%r8d      \n\t"
+
+#define MULADDC_ADX_CORE                    \
+        "mulxq  (%%rsi), %%rax, %%r9 \n\t"  \
+        "adcxq  %%rcx,   %%rax      \n\t"   \
+        "adoxq  (%%rdi), %%rax      \n\t"   \
+        "movq   %%r9,    %%rcx      \n\t"   \
+        "movq   %%rax,   (%%rdi)    \n\t"   \
+        "leaq   8(%%rsi), %%rsi     \n\t"   \
+        "leaq   8(%%rdi), %%rdi     \n\t"
+
+#define MULADDC_ADX_STOP                    \
+        "adcxq  %%r8,    %%rcx      \n\t"   \
+        "adoxq  %%r8,    %%rcx      \n\t"   \
+        : "+c" (c), "+D" (d), "+S" (s)      \
+        : "d" (b)                           \
+        : "rax", "r8", "r9", "cc", "memory" \
+    );
+
 #endif /* AMD64 */
 
 #if defined(__mc68020__) || defined(__mcpu32__)
@@ -73,6 +73,10 @@
 #error "MBEDTLS_CTR_DRBG_C defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_MPI_LIMB_POOL) && !defined(MBEDTLS_BIGNUM_C)
+#error "MBEDTLS_MPI_LIMB_POOL defined, but not all prerequisites"
+#endif
+
 #if defined(MBEDTLS_DHM_C) && !defined(MBEDTLS_BIGNUM_C)
 #error "MBEDTLS_DHM_C defined, but not all prerequisites"
 #endif
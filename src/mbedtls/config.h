@@ -239,6 +239,22 @@
  */
 #define MBEDTLS_GENPRIME
 
+/**
+ * \def MBEDTLS_MPI_LIMB_POOL
+ *
+ * Recycle the limb arrays of the MPIs through a per-thread pool, instead of
+ * calling mbedtls_calloc() and mbedtls_free() each time an MPI is grown or
+ * freed. Only the arrays of at most MBEDTLS_MPI_POOL_MAX_LIMBS limbs are
+ * pooled, and each size class keeps at most MBEDTLS_MPI_POOL_DEPTH arrays.
+ * The limbs are erased before being put back in the pool. The pool of a
+ * thread is released when the thread exits.
+ *
+ * Requires: MBEDTLS_BIGNUM_C, POSIX threads
+ *
+ * Comment this macro to allocate every limb array on the heap.
+ */
+#define MBEDTLS_MPI_LIMB_POOL
+
 /**
  * \def MBEDTLS_ENTROPY_NV_SEED
  *
@@ -561,6 +577,8 @@
 /* MPI / BIGNUM options */
 //#define MBEDTLS_MPI_WINDOW_SIZE            6 /**< Maximum windows size used. */
 //#define MBEDTLS_MPI_MAX_SIZE            1024 /**< Maximum number of bytes for usable MPIs. */
+//#define MBEDTLS_MPI_POOL_MAX_LIMBS       256 /**< Maximum number of limbs of the pooled arrays (power of 2). */
+//#define MBEDTLS_MPI_POOL_DEPTH            32 /**< Maximum number of pooled arrays per size class and per thread. */
 
 //#define MBEDTLS_PLATFORM_STD_MEM_HDR   <stdlib.h> /**< Header to include if MBEDTLS_PLATFORM_NO_STD_FUNCTIONS is defined. Don't define if no header is needed. */
 //#define MBEDTLS_PLATFORM_STD_CALLOC        calloc /**< Default allocator to use, can be undefined */
@@ -2,10 +2,19 @@
 #include "GMPpke.hpp"
 
 #include "prf.hpp"
+#include "thread_pool.hpp"
 #include "util.hpp"
 
 #include <cassert>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sodium/utils.h>
+
 namespace sse {
 
 namespace crypto {
@@ -15,6 +24,147 @@ using relicxx::G2;
 using relicxx::GT;
 using relicxx::ZR;
 
+namespace {
+
+// Minimum number of shares processed by a task of recoverBlind: every task
+// pays for a final exponentiation
+constexpr size_t kMinSharesPerTask = 16;
+
+// Number of threads for the parallel computations. relic's state is only per
+// thread when it is built with multithreading support. Otherwise, all the
+// computations must stay on the calling thread.
+unsigned int relic_thread_count()
+{
+#if defined(MULTI) && (MULTI == PTHREAD || MULTI == OPENMP)
+    return hardware_thread_count();
+#else
+    return 1;
+#endif
+}
+
+// The secret scalars of the deterministic key generation. The values are the
+// stream domains of GmppkeScalarDerivation::kChaChaStream: they are part of
+// the key format and must not change.
+enum class ScalarLabel : uint64_t
+{
+    kAlpha = 1,
+    kBeta  = 2,
+    kRy    = 3,
+    kR     = 4,
+    kRho   = 5,
+    kL     = 6,
+    kR1    = 7,
+};
+
+struct ScalarId
+{
+    ScalarLabel label;
+    size_t      index;
+};
+
+// Derives the secret scalars from the PRF, according to the derivation mode.
+// With kChaChaStream, the stream key is derived once, when the deriver is
+// constructed: keep the deriver around to derive several scalars.
+class ScalarDeriver
+{
+public:
+    ScalarDeriver(const relicxx::PairingGroup&                group,
+                  const sse::crypto::Prf<kPPKEPrfOutputSize>& prf,
+                  GmppkeScalarDerivation                      mode)
+        : group_(group), prf_(prf), mode_(mode)
+    {
+        static_assert(kPPKEPrfOutputSize
+                          >= relicxx::PairingGroup::kStreamKeySize,
+                      "The PRF output is too small to key the stream");
+
+        if (mode_ == GmppkeScalarDerivation::kChaChaStream) {
+            // the label is not a valid labeled PRF input: the two modes are
+            // domain separated
+            std::array<uint8_t, kPPKEPrfOutputSize> out
+                = prf_.prf(std::string("param_stream_v2"));
+            std::copy(out.begin(),
+                      out.begin() + stream_key_.size(),
+                      stream_key_.begin());
+            sodium_memzero(out.data(), out.size());
+        } else if (mode_ != GmppkeScalarDerivation::kLabeledPrf) {
+            /* LCOV_EXCL_START */
+            throw std::invalid_argument("Invalid scalar derivation mode");
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    ~ScalarDeriver()
+    {
+        sodium_memzero(stream_key_.data(), stream_key_.size());
+    }
+
+    ScalarDeriver(const ScalarDeriver&) = delete;
+    ScalarDeriver& operator=(const ScalarDeriver&) = delete;
+
+    ZR scalar(ScalarLabel label, size_t index = 0) const
+    {
+        if (mode_ == GmppkeScalarDerivation::kChaChaStream) {
+            return group_.streamZR(
+                stream_key_, static_cast<uint64_t>(label), index);
+        }
+        return group_.pseudoRandomZR(prf_, prf_label(label, index));
+    }
+
+    std::vector<ZR> scalars(const std::vector<ScalarId>& ids) const
+    {
+        if (mode_ == GmppkeScalarDerivation::kChaChaStream) {
+            std::vector<ZR> zrs;
+            zrs.reserve(ids.size());
+            for (const ScalarId& id : ids) {
+                zrs.push_back(scalar(id.label, id.index));
+            }
+            return zrs;
+        }
+
+        std::vector<std::string> seeds;
+        seeds.reserve(ids.size());
+        for (const ScalarId& id : ids) {
+            seeds.push_back(prf_label(id.label, id.index));
+        }
+        return group_.pseudoRandomZR(prf_, seeds);
+    }
+
+private:
+    // The labels of kLabeledPrf
+    static std::string prf_label(ScalarLabel label, size_t index)
+    {
+        switch (label) {
+        case ScalarLabel::kAlpha:
+            return "param_alpha";
+        case ScalarLabel::kBeta:
+            return "param_beta";
+        case ScalarLabel::kRy:
+            return "param_ry";
+        case ScalarLabel::kR:
+            return "param_r";
+        case ScalarLabel::kRho:
+            return "param_rho_" + std::to_string(index);
+        case ScalarLabel::kL:
+            return "param_l_" + std::to_string(index);
+        case ScalarLabel::kR1:
+            return "param_r1_" + std::to_string(index);
+        }
+        /* LCOV_EXCL_START */
+        throw std::invalid_argument("Invalid scalar label");
+        /* LCOV_EXCL_STOP */
+    }
+
+    using stream_key_type
+        = std::array<uint8_t, relicxx::PairingGroup::kStreamKeySize>;
+
+    const relicxx::PairingGroup&                group_;
+    const sse::crypto::Prf<kPPKEPrfOutputSize>& prf_;
+    const GmppkeScalarDerivation                mode_;
+    stream_key_type                             stream_key_{};
+};
+
+} // namespace
+
 // static const string  NULLTAG = "whoever wishes to keep a secret, must hide
 // from us that he possesses one.-- Johann Wolfgang von Goethe"; // the reserved
 // tag
@@ -40,6 +190,14 @@ std::string tag2string(const tag_type& tag)
     return std::string(reinterpret_cast<const char*>(tag.data()), tag.size());
 }
 
+// The workers of the thread pool are long lived: they initialize their relic
+// context on their first task, and keep it until they exit.
+void init_thread_relic_context()
+{
+    static thread_local relicxx::relicResourceHandle handle(true);
+    (void)handle;
+}
+
 
 bool GmppkePrivateKey::isPuncturedOnTag(const tag_type& tag) const
 {
@@ -93,12 +251,12 @@ void Gmppke::keygen(const sse::crypto::Prf<kPPKEPrfOutputSize>& prf,
     GmppkePublicKey bpk;
     //    const ZR alpha = group.randomZR();
 
-    const ZR alpha = group.pseudoRandomZR(prf, "param_alpha");
+    const ZR alpha = sp.alpha;
 
     bpk.gG1 = group.generatorG1();
     bpk.gG2 = group.generatorG2();
     //    const ZR beta = group.randomZR();
-    const ZR beta = group.pseudoRandomZR(prf, "param_beta");
+    const ZR beta = sp.beta;
     bpk.g2G1      = group.exp(bpk.gG1, beta);
     bpk.g2G2      = group.exp(bpk.gG2, beta);
     pk.gG1        = bpk.gG1;
@@ -113,9 +271,11 @@ void Gmppke::keygen(const sse::crypto::Prf<kPPKEPrfOutputSize>& prf,
 void Gmppke::paramgen(const sse::crypto::Prf<kPPKEPrfOutputSize>& prf,
                       GmppkeSecretParameters&                     sp) const
 {
-    sp.alpha = group.pseudoRandomZR(prf, "param_alpha");
-    sp.beta  = group.pseudoRandomZR(prf, "param_beta");
-    sp.ry    = group.pseudoRandomZR(prf, "param_ry");
+    const ScalarDeriver deriver(group, prf, scalarDerivation);
+
+    sp.alpha = deriver.scalar(ScalarLabel::kAlpha);
+    sp.beta  = deriver.scalar(ScalarLabel::kBeta);
+    sp.ry    = deriver.scalar(ScalarLabel::kRy);
 }
 
 
@@ -125,6 +285,7 @@ void Gmppke::keygenPartial(const ZR&                     alpha,
                            const GmppkeSecretParameters& sp) const
 {
     pk.ppkeg1 = group.exp(pk.gG2, alpha);
+    pk.blindingTable.reset();
 
     // Select a random polynomial of degree d subject to q(0)= beta. We do this
     // by selecting d+1 points. Because we don't actually  care about the
@@ -166,6 +327,7 @@ void Gmppke::keygenPartial(const sse::crypto::Prf<kPPKEPrfOutputSize>& prf,
                            const GmppkeSecretParameters&               sp) const
 {
     pk.ppkeg1 = group.exp(pk.gG2, alpha);
+    pk.blindingTable.reset();
 
     // Select a random polynomial of degree d subject to q(0)= beta. We do this
     // by selecting d+1 points. Because we don't actually  care about the
@@ -211,8 +373,9 @@ GmppkePrivateKeyShare Gmppke::skgen(const GmppkeSecretParameters& sp) const
 
     const ZR h = group.hashListToZR(NULLTAG);
 
-    share.sk3 = group.exp(group.generatorG2(), r);           // g^r
-    share.sk2 = group.exp(share.sk3, sp.beta + (h * sp.ry)); // v(t0)^r
+    share.sk3 = group.exp(group.generatorG2(), r); // g^r
+    // v(t0)^r = g^(r (beta + h ry)), on the generator's fixed base
+    share.sk2 = group.exp(group.generatorG2(), r * (sp.beta + (h * sp.ry)));
 
     return share;
 }
@@ -224,14 +387,16 @@ GmppkePrivateKeyShare Gmppke::skgen(
     GmppkePrivateKeyShare share;
     share.sk4 = NULLTAG;
     //    const ZR r = group.randomZR();
-    const ZR r = group.pseudoRandomZR(prf, "param_r");
+    const ZR r
+        = ScalarDeriver(group, prf, scalarDerivation).scalar(ScalarLabel::kR);
     //    share.sk1 = group.exp(pk.g2G2, group.add(r,alpha));
     share.sk1 = group.exp(group.generatorG2(), sp.beta * (r + sp.alpha));
 
     const ZR h = group.hashListToZR(NULLTAG);
 
-    share.sk3 = group.exp(group.generatorG2(), r);           // g^r
-    share.sk2 = group.exp(share.sk3, sp.beta + (h * sp.ry)); // v(t0)^r
+    share.sk3 = group.exp(group.generatorG2(), r); // g^r
+    // v(t0)^r = g^(r (beta + h ry)), on the generator's fixed base
+    share.sk2 = group.exp(group.generatorG2(), r * (sp.beta + (h * sp.ry)));
 
     return share;
 }
@@ -244,33 +409,35 @@ GmppkePrivateKeyShare Gmppke::sk0Gen(
     const ZR              h = group.hashListToZR(NULLTAG);
     GmppkePrivateKeyShare sk_0;
 
-    std::string d_string = std::to_string(d);
+    const ScalarDeriver deriver(group, prf, scalarDerivation);
 
     //    assert(d > 0);
     if (d == 0) {
         // this is the initial first key share, we have to act a bit differently
 
-        const ZR r = group.pseudoRandomZR(prf, "param_rho_0");
+        const ZR r = deriver.scalar(ScalarLabel::kRho, 0);
         sk_0.sk1   = group.exp(group.generatorG2(), sp.beta * (r + sp.alpha));
 
-        sk_0.sk3 = group.exp(group.generatorG2(), r);          // g^r
-        sk_0.sk2 = group.exp(sk_0.sk3, sp.beta + (h * sp.ry)); // v(t0)^r
+        sk_0.sk3 = group.exp(group.generatorG2(), r); // g^r
+        // v(t0)^r = g^(r (beta + h ry)), on the generator's fixed base
+        sk_0.sk2 = group.exp(group.generatorG2(), r * (sp.beta + (h * sp.ry)));
 
 
     } else {
-        const ZR rho_d = group.pseudoRandomZR(prf, ("param_rho_" + d_string));
+        const ZR rho_d = deriver.scalar(ScalarLabel::kRho, d);
         //        std::cout << std::string("param_rho_%d",d) << std::endl;
         //        const ZR rho_d_1 = group.pseudoRandomZR(prf,
         //        std::string("param_rho_%d",d-1));
 
-        const ZR l_d = group.pseudoRandomZR(prf, ("param_l_" + d_string));
+        const ZR l_d = deriver.scalar(ScalarLabel::kL, d);
 
         //        const ZR l_d_1 = (d > 1) ? (group.pseudoRandomZR(prf,
         //        std::string("param_l_%d",d-1))) : (-sp.alpha);
         auto g   = group.generatorG2();
         sk_0.sk1 = group.exp(g, sp.beta * (rho_d - l_d));
-        sk_0.sk3 = group.exp(g, rho_d);                        // g^r
-        sk_0.sk2 = group.exp(sk_0.sk3, sp.beta + (h * sp.ry)); // v(t0)^r
+        sk_0.sk3 = group.exp(g, rho_d); // g^r
+        // v(t0)^r = g^(r (beta + h ry)), on the generator's fixed base
+        sk_0.sk2 = group.exp(g, rho_d * (sp.beta + (h * sp.ry)));
     }
 
     sk_0.sk4 = NULLTAG;
@@ -288,25 +455,75 @@ GmppkePrivateKeyShare Gmppke::skShareGen(
 
     assert(d > 0);
     assert(tag != NULLTAG);
-    std::string d_string = std::to_string(d);
+    const ScalarDeriver deriver(group, prf, scalarDerivation);
 
-    const ZR r1 = group.pseudoRandomZR(prf, ("param_r1_" + d_string));
+    const ZR r1 = deriver.scalar(ScalarLabel::kR1, d);
 
-    const ZR l_d = group.pseudoRandomZR(prf, ("param_l_" + d_string));
-    const ZR l_d_1
-        = (d > 1) ? (group.pseudoRandomZR(
-                        prf, std::string("param_l_" + std::to_string(d - 1))))
-                  : (-sp.alpha);
+    const ZR l_d   = deriver.scalar(ScalarLabel::kL, d);
+    const ZR l_d_1 = (d > 1) ? deriver.scalar(ScalarLabel::kL, d - 1)
+                             : (-sp.alpha);
 
     share.sk1 = group.exp(group.generatorG2(), sp.beta * (l_d - l_d_1 + r1));
-    share.sk3 = group.exp(group.generatorG2(), r1);          // g^r
-    share.sk2 = group.exp(share.sk3, sp.beta + (h * sp.ry)); // v(t0)^r
+    share.sk3 = group.exp(group.generatorG2(), r1); // g^r
+    // v(t0)^r = g^(r (beta + h ry)), on the generator's fixed base
+    share.sk2 = group.exp(group.generatorG2(), r1 * (sp.beta + (h * sp.ry)));
 
 
     share.sk4 = tag;
     return share;
 }
 
+std::vector<GmppkePrivateKeyShare> Gmppke::skShareGen(
+    const sse::crypto::Prf<kPPKEPrfOutputSize>& prf,
+    const GmppkeSecretParameters&               sp,
+    size_t                                      d_start,
+    const std::vector<tag_type>&                tags) const
+{
+    const size_t n = tags.size();
+
+    assert(d_start > 0);
+
+    // scalars[2k], scalars[2k+1] and scalars[2k+2] are l_{d-1}, r1 and l_d
+    // for the k-th share: consecutive shares have one l in common
+    std::vector<ScalarId> ids;
+    ids.reserve(2 * n + 1);
+    ids.push_back({ScalarLabel::kL, d_start - 1});
+    for (size_t k = 0; k < n; k++) {
+        assert(tags[k] != NULLTAG);
+
+        ids.push_back({ScalarLabel::kR1, d_start + k});
+        ids.push_back({ScalarLabel::kL, d_start + k});
+    }
+    std::vector<ZR> scalars
+        = ScalarDeriver(group, prf, scalarDerivation).scalars(ids);
+    if (d_start == 1) {
+        scalars[0] = -sp.alpha;
+    }
+
+    std::vector<GmppkePrivateKeyShare> shares(n);
+
+    parallel_for(n, relic_thread_count(), [&](size_t begin, size_t end) {
+        init_thread_relic_context();
+        const G2 g = group.generatorG2();
+
+        for (size_t k = begin; k < end; k++) {
+            const ZR& l_d_1 = scalars[2 * k];
+            const ZR& r1    = scalars[2 * k + 1];
+            const ZR& l_d   = scalars[2 * k + 2];
+
+            const ZR               h     = group.hashListToZR(tags[k]);
+            GmppkePrivateKeyShare& share = shares[k];
+
+            share.sk1 = group.exp(g, sp.beta * (l_d - l_d_1 + r1));
+            share.sk3 = group.exp(g, r1); // g^r
+            // v(t0)^r = g^(r (beta + h ry)), on the generator's fixed base
+            share.sk2 = group.exp(g, r1 * (sp.beta + (h * sp.ry)));
+            share.sk4 = tags[k];
+        }
+    });
+
+    return shares;
+}
 
 void Gmppke::puncture(const GmppkePublicKey& pk,
                       GmppkePrivateKey&      sk,
@@ -344,6 +561,22 @@ void Gmppke::puncture(const GmppkePublicKey& pk,
     sk.shares.push_back(skentryn);
 }
 
+std::shared_ptr<const relicxx::GTFixedBase> Gmppke::blindingTable(
+    const GmppkePublicKey& pk) const
+{
+    std::shared_ptr<const relicxx::GTFixedBase> table
+        = std::atomic_load(&pk.blindingTable);
+
+    if (!table) {
+        // Concurrent encryptions might all build the table: they compute the
+        // same value, and only one of them is kept.
+        table = std::make_shared<const relicxx::GTFixedBase>(
+            group.pair(pk.g2G1, pk.ppkeg1));
+        std::atomic_store(&pk.blindingTable, table);
+    }
+    return table;
+}
+
 PartialGmmppkeCT Gmppke::blind(const GmppkePublicKey& pk,
                                const ZR&              s,
                                const tag_type&        tag) const
@@ -377,56 +610,170 @@ PartialGmmppkeCT Gmppke::blind(const GmppkeSecretParameters& sp,
     ZR h = group.hashListToZR(tag);
     G1 g = group.generatorG1();
 
-    ct.ct3 = group.exp(ct.ct2, (sp.beta + (h * sp.ry)));
+    ct.ct3 = group.exp(g, s * (sp.beta + (h * sp.ry)));
 
     ct.tag = tag;
     return ct;
 }
 
 
-GT Gmppke::recoverBlind(const GmppkePrivateKey& sk,
-                        const PartialGmmppkeCT& ct) const
+GmppkePreparedPrivateKey Gmppke::prepare(const GmppkePrivateKey& sk) const
 {
-    static ZR zr_zero = ZR(0);
-    ZR        ctTag   = group.hashListToZR(ct.tag);
+    GmppkePreparedPrivateKey prepared;
 
-    const unsigned int numshares = static_cast<unsigned int>(sk.shares.size());
+    const size_t numshares = sk.shares.size();
 
+    prepared.puncturedTags.reserve(numshares);
+    prepared.shareTags.reserve(numshares);
+    prepared.pairingG2.resize(2 * numshares + 1);
 
-    // Compute w_i coefficients for recovery
-    std::vector<GT> z(numshares);
+    // e(a, b)^-1 = e(a, -b): the divisions of recoverBlind are done with the
+    // negated shares
+    G2 sk1prod;
+    for (size_t i = 0; i < numshares; i++) {
+        const GmppkePrivateKeyShare& s0 = sk.shares[i];
 
+        prepared.puncturedTags.insert(s0.sk4);
+        prepared.shareTags.push_back(group.hashListToZR(s0.sk4));
+        prepared.pairingG2[2 * i]     = -s0.sk3;
+        prepared.pairingG2[2 * i + 1] = -s0.sk2;
 
-    relicxx::relicResourceHandle h(true);
-#pragma omp parallel for private(h) firstprivate(shareTags)
-    for (unsigned int i = 0; i < numshares; i++) {
-        const GmppkePrivateKeyShare& s0         = sk.shares.at(i);
-        ZR                           currentTag = group.hashListToZR(s0.sk4);
+        sk1prod = group.mul(sk1prod, s0.sk1);
+    }
+    prepared.pairingG2[2 * numshares] = sk1prod;
+
+    return prepared;
+}
 
+GT Gmppke::recoverBlind(const GmppkePrivateKey& sk,
+                        const PartialGmmppkeCT& ct) const
+{
+    return recoverBlind(prepare(sk), ct);
+}
 
-        ZR w0 = LagrangeBasisCoefficients<2>(
-            group, 0, zr_zero, {{ctTag, currentTag}});
-        const ZR wstar = LagrangeBasisCoefficients<2>(
-            group, 1, zr_zero, {{ctTag, currentTag}});
+GT Gmppke::recoverBlind(const GmppkePreparedPrivateKey& sk,
+                        const PartialGmmppkeCT&         ct) const
+{
+    return recoverBlind(sk, std::vector<const PartialGmmppkeCT*>{&ct})[0];
+}
 
+std::vector<GT> Gmppke::recoverBlind(
+    const GmppkePreparedPrivateKey&             sk,
+    const std::vector<const PartialGmmppkeCT*>& cts) const
+{
+    const size_t numshares = sk.shareTags.size();
+    const size_t numcts    = cts.size();
+
+    const unsigned int n_threads = relic_thread_count();
+
+    std::vector<GT> blinds(numcts);
+
+    if (numcts >= n_threads || numshares < 2 * kMinSharesPerTask) {
+        // one multi-pairing per ciphertext, the ciphertexts are spread among
+        // the threads
+        parallel_for(numcts, n_threads, [&](size_t begin, size_t end) {
+            init_thread_relic_context();
+
+            // Lagrange inverses of the current ciphertext, reused by all the
+            // ciphertexts of the task
+            std::vector<ZR> inverses;
+            for (size_t c = begin; c < end; c++) {
+                const ZR ctTag = group.hashListToZR(cts[c]->tag);
+                blinds[c]      = recoverBlindShares(
+                    sk, *cts[c], ctTag, 0, numshares, inverses);
+            }
+        });
+        return blinds;
+    }
 
-        G1 ct3prod_j;
+    // Few ciphertexts, and a large key: the shares of every ciphertext are
+    // split among the threads. Every task computes the multi-pairing of its
+    // shares (the final exponentiation distributes over the product), and
+    // the partial products are combined two by two.
+    const unsigned int n_tasks = static_cast<unsigned int>(
+        std::min<size_t>(n_threads, numshares / kMinSharesPerTask));
+
+    std::vector<GT> partials(n_tasks);
+    for (size_t c = 0; c < numcts; c++) {
+        const ZR ctTag = group.hashListToZR(cts[c]->tag);
+
+        parallel_for(n_tasks, n_tasks, [&](size_t begin, size_t end) {
+            init_thread_relic_context();
+
+            std::vector<ZR> inverses;
+            for (size_t t = begin; t < end; t++) {
+                partials[t] = recoverBlindShares(sk,
+                                                 *cts[c],
+                                                 ctTag,
+                                                 t * numshares / n_tasks,
+                                                 (t + 1) * numshares / n_tasks,
+                                                 inverses);
+            }
+        });
+
+        for (size_t stride = 1; stride < n_tasks; stride *= 2) {
+            for (size_t t = 0; t + stride < n_tasks; t += 2 * stride) {
+                partials[t] = group.mul(partials[t], partials[t + stride]);
+            }
+        }
+        blinds[c] = partials[0];
+    }
 
-        ct3prod_j = group.mul(ct3prod_j, group.exp(ct.ct3, w0));
+    return blinds;
+}
 
-        GT denominator
-            = group.mul(group.pair(ct3prod_j, s0.sk3),
-                        group.pair(group.exp(ct.ct2, wstar), s0.sk2));
-        GT nominator = group.pair(ct.ct2, s0.sk1);
+GT Gmppke::recoverBlindShares(const GmppkePreparedPrivateKey& sk,
+                              const PartialGmmppkeCT&         ct,
+                              const ZR&                       ctTag,
+                              size_t                          begin,
+                              size_t                          end,
+                              std::vector<ZR>&                inverses) const
+{
+    const size_t numshares = sk.shareTags.size();
+
+    // The Lagrange coefficients for the ciphertext tag t and the share tag
+    // t_i are w0 = -t_i / (t - t_i) and wstar = t / (t - t_i): all the
+    // (t - t_i) of the range are inverted at once.
+    try {
+        BatchInverse(
+            group,
+            end - begin,
+            [&](size_t i) { return ctTag - sk.shareTags[begin + i]; },
+            inverses);
+    } catch (const std::logic_error&) {
+        throw std::logic_error("LagrangeBasisCoefficient calculation "
+                               "failed. Almost certainly a duplicate "
+                               "x-coordinate");
+    }
 
-        z.at(i) = group.div(nominator, denominator);
+    // z = prod_i e(ct2, sk1_i) / (e(ct3^w0_i, sk3_i) * e(ct2^wstar_i, sk2_i))
+    //   = e(ct2, sum_i sk1_i)
+    //     * prod_i e(ct3^w0_i, -sk3_i) * e(ct2^wstar_i, -sk2_i)
+    // is computed with a single multi-pairing: one final exponentiation for
+    // all the shares, and the Miller loops share their squarings. The G2
+    // side only depends on the key, and is computed by prepare(). The
+    // e(ct2, sum_i sk1_i) term goes with the last range of shares.
+    const bool   last  = (end == numshares);
+    const size_t count = 2 * (end - begin) + (last ? 1 : 0);
+
+    std::vector<G1> pair_g1(count);
+    for (size_t i = begin; i < end; i++) {
+        const ZR w0    = -(sk.shareTags[i] * inverses[i - begin]);
+        const ZR wstar = ctTag * inverses[i - begin];
+
+        pair_g1[2 * (i - begin)]     = group.exp(ct.ct3, w0);
+        pair_g1[2 * (i - begin) + 1] = group.exp(ct.ct2, wstar);
+    }
+    if (last) {
+        pair_g1[count - 1] = ct.ct2;
     }
 
-    GT zprod;
-    for (unsigned int i = 0; i < numshares; i++) {
-        zprod = group.mul(zprod, z.at(i));
+    if (begin == 0 && last) {
+        return group.pairProd(pair_g1, sk.pairingG2);
     }
-    return zprod;
+    const std::vector<G2> pair_g2(sk.pairingG2.begin() + 2 * begin,
+                                  sk.pairingG2.begin() + 2 * begin + count);
+    return group.pairProd(pair_g1, pair_g2);
 }
 
 } // namespace crypto
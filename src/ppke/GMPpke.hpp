@@ -17,6 +17,10 @@
 #include <sse/crypto/prf.hpp>
 
 #include <array>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_set>
 #include <utility>
 
 namespace sse {
@@ -35,6 +39,25 @@ using tag_type = std::array<uint8_t, kTagSize>;
 
 std::string tag2string(const tag_type& tag);
 
+// Initializes the relic context of the calling thread, until it exits. This is
+// a no-op on the threads whose context is already initialized.
+void init_thread_relic_context();
+
+// Hash function for the tags, to index them in unordered containers
+struct TagHash
+{
+    size_t operator()(const tag_type& tag) const
+    {
+        uint64_t low, high;
+        static_assert(sizeof(low) + sizeof(high) == kTagSize,
+                      "Invalid tag size");
+        std::memcpy(&low, tag.data(), sizeof(low));
+        std::memcpy(&high, tag.data() + sizeof(low), sizeof(high));
+
+        return std::hash<uint64_t>()(low ^ (high * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
 class BadCiphertext : public std::invalid_argument
 {
 public:
@@ -79,6 +102,27 @@ class GmppkePrivateKey;
 class GmppkePublicKey : public virtual baseKey
 {
 public:
+    GmppkePublicKey() = default;
+
+    // The blinding table can be published by a concurrent encryption with
+    // the copied key: it is read atomically
+    GmppkePublicKey(const GmppkePublicKey& pk)
+        : baseKey(pk), ppkeg1(pk.ppkeg1), gqofxG1(pk.gqofxG1),
+          gqofxG2(pk.gqofxG2),
+          blindingTable(std::atomic_load(&pk.blindingTable))
+    {
+    }
+
+    GmppkePublicKey& operator=(const GmppkePublicKey& pk)
+    {
+        baseKey::operator=(pk);
+        ppkeg1  = pk.ppkeg1;
+        gqofxG1 = pk.gqofxG1;
+        gqofxG2 = pk.gqofxG2;
+        std::atomic_store(&blindingTable, std::atomic_load(&pk.blindingTable));
+        return *this;
+    }
+
     friend bool operator==(const GmppkePublicKey& x, const GmppkePublicKey& y)
     {
         return (dynamic_cast<const baseKey&>(x)
@@ -97,6 +141,11 @@ protected:
     std::array<relicxx::G1, 2> gqofxG1;
     std::array<relicxx::G2, 2> gqofxG2;
 
+    // Fixed-base table for e(g2G1, ppkeg1), the base of the blinding factor
+    // of the encryptions. It is computed on the first encryption, and shared
+    // between the copies of the key.
+    mutable std::shared_ptr<const relicxx::GTFixedBase> blindingTable;
+
     friend class Gmppke;
 };
 
@@ -105,17 +154,40 @@ class GmppkePrivateKeyShare
 public:
     static constexpr size_t kByteSize
         = 3 * relicxx::G2::kCompactByteSize + kTagSize;
+    // The uncompressed serialization is larger, but it is parsed without
+    // decompressing the points, i.e. without computing square roots
+    static constexpr size_t kUncompressedByteSize
+        = 3 * relicxx::G2::kByteSize + kTagSize;
 
     GmppkePrivateKeyShare() = default;
     ;
     explicit GmppkePrivateKeyShare(const uint8_t* bytes)
-        : sk1(bytes, true), sk2(bytes + relicxx::G2::kCompactByteSize, true),
-          sk3(bytes + 2 * relicxx::G2::kCompactByteSize, true)
+        : GmppkePrivateKeyShare(bytes, true)
+    {
+    }
+    GmppkePrivateKeyShare(const uint8_t* bytes, bool compressed)
+        : sk1(bytes, compressed),
+          sk2(bytes + pointSize(compressed), compressed),
+          sk3(bytes + 2 * pointSize(compressed), compressed)
     {
-        ::memcpy(
-            sk4.data(), bytes + 3 * relicxx::G2::kCompactByteSize, kTagSize);
+        ::memcpy(sk4.data(), bytes + 3 * pointSize(compressed), kTagSize);
     };
 
+    // Checks the encoding prefixes of the points of a serialized share,
+    // without decoding the points: 0x02 or 0x03 for the compressed points,
+    // 0x04 for the uncompressed ones
+    static bool hasValidFraming(const uint8_t* bytes, bool compressed)
+    {
+        for (size_t i = 0; i < 3; i++) {
+            const uint8_t prefix = bytes[i * pointSize(compressed)];
+            if (compressed ? (prefix != 0x02 && prefix != 0x03)
+                           : (prefix != 0x04)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
 
     friend bool operator==(const GmppkePrivateKeyShare& x,
                            const GmppkePrivateKeyShare& y)
@@ -129,13 +201,14 @@ public:
         return !(x == y);
     }
 
-    void writeBytes(uint8_t* bytes) const
+    // Writes kByteSize bytes if compress is true, kUncompressedByteSize
+    // otherwise
+    void writeBytes(uint8_t* bytes, bool compress = true) const
     {
-        sk1.writeBytes(bytes, true); // compress
-        sk2.writeBytes(bytes + relicxx::G2::kCompactByteSize, true);
-        sk3.writeBytes(bytes + 2 * relicxx::G2::kCompactByteSize, true);
-        ::memcpy(
-            bytes + 3 * relicxx::G2::kCompactByteSize, sk4.data(), sk4.size());
+        sk1.writeBytes(bytes, compress);
+        sk2.writeBytes(bytes + pointSize(compress), compress);
+        sk3.writeBytes(bytes + 2 * pointSize(compress), compress);
+        ::memcpy(bytes + 3 * pointSize(compress), sk4.data(), sk4.size());
     }
 
     inline const tag_type& get_tag() const
@@ -144,6 +217,12 @@ public:
     }
 
 protected:
+    static constexpr size_t pointSize(bool compressed)
+    {
+        return compressed ? relicxx::G2::kCompactByteSize
+                          : relicxx::G2::kByteSize;
+    }
+
     relicxx::G2 sk1;
     relicxx::G2 sk2;
     relicxx::G2 sk3;
@@ -183,6 +262,35 @@ protected:
     friend class Gmppke;
 };
 
+// Part of the decryption with a private key that does not depend on the
+// ciphertext: the G2 side of the pairings of recoverBlind, and the hashed
+// tags of the key shares. Preparing a key once saves their computation on
+// every decryption. The tags of the shares are also indexed, so that the
+// puncture checks do not scan the shares.
+class GmppkePreparedPrivateKey
+{
+public:
+    GmppkePreparedPrivateKey() = default;
+
+    // Constant time in the number of shares, unlike
+    // GmppkePrivateKey::isPuncturedOnTag
+    bool isPuncturedOnTag(const tag_type& tag) const
+    {
+        return puncturedTags.count(tag) != 0;
+    }
+
+protected:
+    // sk4 for every share
+    std::unordered_set<tag_type, TagHash> puncturedTags;
+    // hashListToZR(sk4) for every share
+    std::vector<relicxx::ZR> shareTags;
+    // G2 arguments of the multi-pairing: -sk3 and -sk2 for every share, then
+    // the sum of the sk1
+    std::vector<relicxx::G2> pairingG2;
+
+    friend class Gmppke;
+};
+
 class GmppkeSecretParameters
 {
     friend bool operator==(const GmppkeSecretParameters& l,
@@ -209,14 +317,21 @@ class PartialGmmppkeCT
 public:
     static constexpr size_t kByteSize
         = 2 * relicxx::G1::kCompactByteSize + kTagSize;
+    // The uncompressed serialization is larger, but it is parsed without
+    // decompressing the points
+    static constexpr size_t kUncompressedByteSize
+        = 2 * relicxx::G1::kByteSize + kTagSize;
 
     PartialGmmppkeCT() = default;
     ;
     explicit PartialGmmppkeCT(const uint8_t* bytes)
-        : ct2(bytes, true), ct3(bytes + relicxx::G1::kCompactByteSize, true)
+        : PartialGmmppkeCT(bytes, true)
+    {
+    }
+    PartialGmmppkeCT(const uint8_t* bytes, bool compressed)
+        : ct2(bytes, compressed), ct3(bytes + pointSize(compressed), compressed)
     {
-        ::memcpy(
-            tag.data(), bytes + 2 * relicxx::G1::kCompactByteSize, kTagSize);
+        ::memcpy(tag.data(), bytes + 2 * pointSize(compressed), kTagSize);
     };
 
     friend bool operator==(const PartialGmmppkeCT& x, const PartialGmmppkeCT& y)
@@ -237,15 +352,22 @@ public:
     friend bool canDecrypt(const GmppkePrivateKey& sk,
                            const PartialGmmppkeCT& ct);
 
-    void writeBytes(uint8_t* bytes) const
+    // Writes kByteSize bytes if compress is true, kUncompressedByteSize
+    // otherwise
+    void writeBytes(uint8_t* bytes, bool compress = true) const
     {
-        ct2.writeBytes(bytes, true); // compress
-        ct3.writeBytes(bytes + relicxx::G1::kCompactByteSize, true);
-        ::memcpy(
-            bytes + 2 * relicxx::G1::kCompactByteSize, tag.data(), tag.size());
+        ct2.writeBytes(bytes, compress);
+        ct3.writeBytes(bytes + pointSize(compress), compress);
+        ::memcpy(bytes + 2 * pointSize(compress), tag.data(), tag.size());
     }
 
 protected:
+    static constexpr size_t pointSize(bool compressed)
+    {
+        return compressed ? relicxx::G1::kCompactByteSize
+                          : relicxx::G1::kByteSize;
+    }
+
     relicxx::G1 ct2;
     relicxx::G1 ct3;
     tag_type    tag;
@@ -260,11 +382,16 @@ class GmmppkeCT : public PartialGmmppkeCT
 public:
     static constexpr size_t kCTByteSize
         = PartialGmmppkeCT::kByteSize + sizeof(T);
+    static constexpr size_t kUncompressedCTByteSize
+        = PartialGmmppkeCT::kUncompressedByteSize + sizeof(T);
 
     GmmppkeCT() = default;
     ;
-    explicit GmmppkeCT(const uint8_t* bytes)
-        : PartialGmmppkeCT(bytes + sizeof(T))
+    explicit GmmppkeCT(const uint8_t* bytes) : GmmppkeCT(bytes, true)
+    {
+    }
+    GmmppkeCT(const uint8_t* bytes, bool compressed)
+        : PartialGmmppkeCT(bytes + sizeof(T), compressed)
     {
         ::memcpy(&ct1, bytes, sizeof(T));
     };
@@ -272,10 +399,10 @@ public:
     {
     }
 
-    void writeBytes(uint8_t* bytes) const
+    void writeBytes(uint8_t* bytes, bool compress = true) const
     {
         ::memcpy(bytes, &ct1, sizeof(T));
-        PartialGmmppkeCT::writeBytes(bytes + sizeof(T));
+        PartialGmmppkeCT::writeBytes(bytes + sizeof(T), compress);
     }
 
 protected:
@@ -296,16 +423,37 @@ protected:
 };
 
 
+// How the secret scalars of the deterministic key generation are derived from
+// the PRF. The values are part of the key format: a key has to be regenerated
+// with the mode it was created with.
+enum class GmppkeScalarDerivation : uint8_t
+{
+    // One PRF evaluation per scalar, on a textual label ("param_l_12")
+    kLabeledPrf = 1,
+    // One PRF evaluation keys a ChaCha20 stream, and the scalars are read
+    // from the stream, addressed by a label identifier and an integer index
+    kChaChaStream = 2,
+};
+
 class Gmppke
 {
 public:
     static constexpr uint8_t kPRFKeySize = 32; // 256 bits
     static const tag_type    NULLTAG;
 
-    Gmppke()  = default;
+    Gmppke() = default;
+    explicit Gmppke(GmppkeScalarDerivation derivation)
+        : scalarDerivation(derivation)
+    {
+    }
     ~Gmppke() = default;
     ;
 
+    GmppkeScalarDerivation scalar_derivation() const
+    {
+        return scalarDerivation;
+    }
+
     void keygen(GmppkePublicKey&        pk,
                 GmppkePrivateKey&       sk,
                 GmppkeSecretParameters& sp) const;
@@ -332,8 +480,19 @@ public:
                            const relicxx::ZR&            s,
                            const tag_type&               tag) const;
 
+    GmppkePreparedPrivateKey prepare(const GmppkePrivateKey& sk) const;
+
     relicxx::GT recoverBlind(const GmppkePrivateKey& sk,
                              const PartialGmmppkeCT& ct) const;
+    relicxx::GT recoverBlind(const GmppkePreparedPrivateKey& sk,
+                             const PartialGmmppkeCT&         ct) const;
+    // Recovers the blinding factors of several ciphertexts. The tags of the
+    // ciphertexts must not have been punctured. The Lagrange coefficients
+    // and the pairings are spread among the threads of the shared ThreadPool,
+    // with a single modular inversion per thread.
+    std::vector<relicxx::GT> recoverBlind(
+        const GmppkePreparedPrivateKey&             sk,
+        const std::vector<const PartialGmmppkeCT*>& cts) const;
 
     template<typename T>
     GmmppkeCT<T> encrypt(const GmppkePublicKey& pk,
@@ -349,7 +508,7 @@ public:
             sse::crypto::Key<kTagSize>(arr.data()));
 
         std::array<uint8_t, 12 * FP_BYTES> gt_blind_bytes;
-        group.exp(group.pair(pk.g2G1, pk.ppkeg1), s)
+        group.exp(*blindingTable(pk), s)
             .getBytes(false, gt_blind_bytes.size(), gt_blind_bytes.data());
 
         T mask;
@@ -409,25 +568,54 @@ public:
         return true;
     }
 
-    // For testing purposes only
     template<typename T>
-    T decrypt_unchecked(const GmppkePrivateKey& sk,
-                        const GmmppkeCT<T>&     ct) const
+    bool decrypt(const GmppkePreparedPrivateKey& sk,
+                 const GmmppkeCT<T>&             ct,
+                 T&                              m) const
     {
-        std::vector<uint8_t> gt_blind_bytes
-            = recoverBlind(sk, ct).getBytes(false);
+        if (sk.isPuncturedOnTag(ct.tag)) {
+            return false;
+        }
+        m = unmask(recoverBlind(sk, ct), ct);
 
-        auto                                           arr = ct.tag;
-        sse::crypto::HMac<sse::crypto::Hash, kTagSize> hkdf(
-            sse::crypto::Key<kTagSize>(arr.data()));
+        return true;
+    }
 
-        T mask;
-        hkdf.hmac(gt_blind_bytes.data(),
-                  gt_blind_bytes.size(),
-                  reinterpret_cast<uint8_t*>(&mask),
-                  sizeof(mask));
+    // Decrypts cts[i] in ms[i], and sets ok[i] to false if the key is
+    // punctured on the tag of cts[i] (ms[i] is then left unspecified)
+    template<typename T>
+    void decrypt_batch(const GmppkePreparedPrivateKey&   sk,
+                       const std::vector<GmmppkeCT<T>>& cts,
+                       std::vector<T>&                  ms,
+                       std::vector<bool>&               ok) const
+    {
+        ms.resize(cts.size());
+        ok.assign(cts.size(), false);
+
+        std::vector<const PartialGmmppkeCT*> unpunctured;
+        unpunctured.reserve(cts.size());
+        for (size_t i = 0; i < cts.size(); i++) {
+            if (!sk.isPuncturedOnTag(cts[i].tag)) {
+                unpunctured.push_back(&cts[i]);
+                ok[i] = true;
+            }
+        }
 
-        return mask ^ ct.ct1;
+        const std::vector<relicxx::GT> blinds = recoverBlind(sk, unpunctured);
+
+        for (size_t i = 0, j = 0; i < cts.size(); i++) {
+            if (ok[i]) {
+                ms[i] = unmask(blinds[j++], cts[i]);
+            }
+        }
+    }
+
+    // For testing purposes only
+    template<typename T>
+    T decrypt_unchecked(const GmppkePrivateKey& sk,
+                        const GmmppkeCT<T>&     ct) const
+    {
+        return unmask(recoverBlind(sk, ct), ct);
     }
 
     GmppkePrivateKeyShare sk0Gen(
@@ -439,9 +627,54 @@ public:
         const GmppkeSecretParameters&               sp,
         size_t                                      d,
         const tag_type&                             tag) const;
+    // Generates the shares for tags[k], at the puncture count d_start + k.
+    // The result is the same as calling skShareGen on every tag, but the PRF
+    // is evaluated in a single batch, and the shares are generated
+    // concurrently.
+    std::vector<GmppkePrivateKeyShare> skShareGen(
+        const sse::crypto::Prf<kPPKEPrfOutputSize>& prf,
+        const GmppkeSecretParameters&               sp,
+        size_t                                      d_start,
+        const std::vector<tag_type>&                tags) const;
 
 private:
-    relicxx::PairingGroup group;
+    relicxx::PairingGroup  group;
+    GmppkeScalarDerivation scalarDerivation{
+        GmppkeScalarDerivation::kLabeledPrf};
+
+    // Computes the part of the blinding factor of ct that comes from the
+    // shares [begin, end) of sk. inverses is a scratch buffer for the
+    // Lagrange coefficients, that the caller can reuse across calls.
+    relicxx::GT recoverBlindShares(const GmppkePreparedPrivateKey& sk,
+                                   const PartialGmmppkeCT&         ct,
+                                   const relicxx::ZR&              ctTag,
+                                   size_t                          begin,
+                                   size_t                          end,
+                                   std::vector<relicxx::ZR>& inverses) const;
+
+    // Returns the fixed-base table of e(pk.g2G1, pk.ppkeg1), and builds it if
+    // necessary
+    std::shared_ptr<const relicxx::GTFixedBase> blindingTable(
+        const GmppkePublicKey& pk) const;
+
+    // Recover the message of ct from the blinding factor
+    template<typename T>
+    T unmask(const relicxx::GT& blind, const GmmppkeCT<T>& ct) const
+    {
+        std::vector<uint8_t> gt_blind_bytes = blind.getBytes(false);
+
+        auto                                           arr = ct.tag;
+        sse::crypto::HMac<sse::crypto::Hash, kTagSize> hkdf(
+            sse::crypto::Key<kTagSize>(arr.data()));
+
+        T mask;
+        hkdf.hmac(gt_blind_bytes.data(),
+                  gt_blind_bytes.size(),
+                  reinterpret_cast<uint8_t*>(&mask),
+                  sizeof(mask));
+
+        return mask ^ ct.ct1;
+    }
 
     template<class T, size_t N>
     T vx(const std::array<T, N>& gqofxG1, const tag_type& x) const
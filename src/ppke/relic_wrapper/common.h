@@ -5,7 +5,10 @@
 // At last on osx  causes error: conflicting types for 'operator<<'.
 // including gmpxx.h prevents this issue.
 //#include <gmpxx.h>
-#define ___cplusplus __cplusplus
+// __cplusplus is saved and restored: the C++ headers included afterwards
+// need it.
+#pragma push_macro("__cplusplus")
+#define ___cplusplus
 #undef __cplusplus
 extern "C" {
 #endif
@@ -13,7 +16,7 @@ extern "C" {
 #include <relic/relic_conf.h>
 #ifdef ___cplusplus
 }
-#define __cplusplus ___cplusplus
+#pragma pop_macro("__cplusplus")
 #undef ___cplusplus
 #endif
 
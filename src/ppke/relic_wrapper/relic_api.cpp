@@ -2,10 +2,78 @@
 
 #include <cassert>
 
+#include <atomic>
+#include <memory>
 #include <stdexcept>
 
+#include <sodium/crypto_stream_chacha20.h>
+#include <sodium/utils.h>
+
 namespace relicxx {
 
+namespace {
+
+#ifdef RELICXX_COUNT_OPERATIONS
+
+// The increments are relaxed: they cost next to nothing compared to the
+// counted operations
+std::atomic<uint64_t> miller_loop_count{0};
+std::atomic<uint64_t> final_exp_count{0};
+std::atomic<uint64_t> g1_exp_count{0};
+std::atomic<uint64_t> g2_exp_count{0};
+std::atomic<uint64_t> gt_exp_count{0};
+
+inline void count_operation(std::atomic<uint64_t>& counter, uint64_t n = 1)
+{
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+#else
+
+// The counters are compiled out: the shared cache line of the atomic
+// counters would be contended by all the threads of the decryptions
+struct NoCounter
+{
+};
+
+NoCounter miller_loop_count;
+NoCounter final_exp_count;
+NoCounter g1_exp_count;
+NoCounter g2_exp_count;
+NoCounter gt_exp_count;
+
+inline void count_operation(NoCounter& /*counter*/, uint64_t /*n*/ = 1)
+{
+}
+
+#endif
+
+} // namespace
+
+OperationCounts OperationCounts::current()
+{
+    OperationCounts c;
+#ifdef RELICXX_COUNT_OPERATIONS
+    c.miller_loops = miller_loop_count.load(std::memory_order_relaxed);
+    c.final_exps   = final_exp_count.load(std::memory_order_relaxed);
+    c.g1_exps      = g1_exp_count.load(std::memory_order_relaxed);
+    c.g2_exps      = g2_exp_count.load(std::memory_order_relaxed);
+    c.gt_exps      = gt_exp_count.load(std::memory_order_relaxed);
+#endif
+    return c;
+}
+
+OperationCounts OperationCounts::operator-(const OperationCounts& c) const
+{
+    OperationCounts r;
+    r.miller_loops = miller_loops - c.miller_loops;
+    r.final_exps   = final_exps - c.final_exps;
+    r.g1_exps      = g1_exps - c.g1_exps;
+    r.g2_exps      = g2_exps - c.g2_exps;
+    r.gt_exps      = gt_exps - c.gt_exps;
+    return r;
+}
+
 void ro_error()
 {
     throw std::invalid_argument("writing to read only object");
@@ -314,6 +382,7 @@ G1 power(const G1& g, const ZR& zr)
 {
     G1 g1;
     g1_mul(g1.g, g.g, zr.z);
+    count_operation(g1_exp_count);
     return g1;
 }
 
@@ -340,6 +409,7 @@ bool G1::ismember(const bn_t order) const
     g1_inits(r);
 
     g1_mul(r, g, order);
+    count_operation(g1_exp_count);
     if (g1_is_infty(r) == 1) {
         result = true;
     }
@@ -422,6 +492,7 @@ G2 power(const G2& g, const ZR& zr)
     RELICXX_G2unconst(g, g1);
     RELICXX_ZRunconst(zr, zr1);
     g2_mul(g2.g, g1.g, zr1.z);
+    count_operation(g2_exp_count);
     return g2;
 }
 
@@ -448,6 +519,7 @@ bool G2::ismember(bn_t order)
     g2_t r;
     g2_inits(r);
     g2_mul(r, g, order);
+    count_operation(g2_exp_count);
     if (g2_is_infty(r) == 1) {
         result = true;
     }
@@ -531,6 +603,7 @@ GT power(const GT& g, const ZR& zr)
     }
 
     gt_exp(gt.g, gg.g, zr1.z);
+    count_operation(gt_exp_count);
     return gt;
 }
 
@@ -550,6 +623,46 @@ GT pairing(const G1& g1, const G2& g2)
     /* compute optimal ate pairing */
     pp_map_oatep_k12(gt.g, g11.g, g22.g);
     // pp_map_k12(gt.g, g11.g, g22.g);
+    count_operation(miller_loop_count);
+    count_operation(final_exp_count);
+    return gt;
+}
+
+GT pairingProduct(const std::vector<G1>& g1, const std::vector<G2>& g2)
+{
+    if (g1.size() != g2.size()) {
+        throw std::invalid_argument(
+            "Invalid pairing product: g1 and g2 must have the same size");
+    }
+
+    GT           gt;
+    const size_t m = g1.size();
+
+    if (m == 0) {
+        return gt;
+    }
+
+    // relic takes arrays of points, and normalizes them in place: copy them
+    std::unique_ptr<g1_t[]> p(new g1_t[m]);
+    std::unique_ptr<g2_t[]> q(new g2_t[m]);
+
+    for (size_t i = 0; i < m; i++) {
+        g1_inits(p[i]);
+        g1_copy(p[i], const_cast<G1&>(g1[i]).g);
+        g2_inits(q[i]);
+        g2_copy(q[i], const_cast<G2&>(g2[i]).g);
+    }
+
+    /* compute the product of optimal ate pairings */
+    pp_map_sim_oatep_k12(gt.g, p.get(), q.get(), static_cast<int>(m));
+    count_operation(miller_loop_count, m);
+    count_operation(final_exp_count);
+
+    for (size_t i = 0; i < m; i++) {
+        g1_free(p[i]);
+        g2_free(q[i]);
+    }
+
     return gt;
 }
 
@@ -560,6 +673,7 @@ bool GT::ismember(bn_t order)
     gt_t r;
     gt_inits(r);
     gt_exp(r, g, order);
+    count_operation(gt_exp_count);
     if (gt_is_unity(r) == 1) {
         result = true;
     }
@@ -646,12 +760,145 @@ bool relicResourceHandle::isInitalized()
 {
     return isInit;
 }
+G1FixedBase::G1FixedBase(const G1& base) : base_(base)
+{
+    for (size_t i = 0; i < RELICXX_EP_TABLE; i++) {
+        g1_inits(table_[i]);
+    }
+    g1_mul_pre(table_, base_.g);
+}
+
+G1FixedBase::~G1FixedBase()
+{
+    for (size_t i = 0; i < RELICXX_EP_TABLE; i++) {
+        g1_free(table_[i]);
+    }
+}
+
+G1 G1FixedBase::power(const ZR& zr) const
+{
+    G1 g1;
+    ZR& zr1 = const_cast<ZR&>(zr);
+    g1_mul_fix(g1.g, const_cast<g1_t*>(table_), zr1.z);
+    count_operation(g1_exp_count);
+    return g1;
+}
+
+G2FixedBase::G2FixedBase(const G2& base) : base_(base)
+{
+    for (size_t i = 0; i < RELICXX_EP_TABLE; i++) {
+        g2_inits(table_[i]);
+    }
+    g2_mul_pre(table_, base_.g);
+}
+
+G2FixedBase::~G2FixedBase()
+{
+    for (size_t i = 0; i < RELICXX_EP_TABLE; i++) {
+        g2_free(table_[i]);
+    }
+}
+
+G2 G2FixedBase::power(const ZR& zr) const
+{
+    G2 g2;
+    ZR& zr1 = const_cast<ZR&>(zr);
+    g2_mul_fix(g2.g, const_cast<g2_t*>(table_), zr1.z);
+    count_operation(g2_exp_count);
+    return g2;
+}
+
+GTFixedBase::GTFixedBase(const GT& base)
+    : base_(base), table_(static_cast<size_t>(1) << kTeeth)
+{
+    bn_t order;
+    bn_inits(order);
+    g1_get_ord(order);
+    spacing_ = (static_cast<size_t>(bn_bits(order)) + kTeeth - 1) / kTeeth;
+    bn_free(order);
+
+    // the teeth: base^(2^(j*spacing_))
+    std::array<GT, kTeeth> teeth;
+    teeth[0] = base_;
+    for (size_t j = 1; j < kTeeth; j++) {
+        teeth[j] = teeth[j - 1];
+        for (size_t i = 0; i < spacing_; i++) {
+            gt_sqr(teeth[j].g, teeth[j].g);
+        }
+    }
+
+    // table_[0] is the unity
+    for (size_t i = 1; i < table_.size(); i++) {
+        size_t j = 0;
+        while (((i >> j) & 1) == 0) {
+            j++;
+        }
+        // i without its lowest set bit is smaller than i
+        gt_mul(table_[i].g, table_[i & (i - 1)].g, teeth[j].g);
+    }
+}
+
+GT GTFixedBase::power(const ZR& zr) const
+{
+    GT gt;
+    ZR& zr1 = const_cast<ZR&>(zr);
+    count_operation(gt_exp_count);
+    if (bn_sign(zr1.z) == BN_NEG
+        || static_cast<size_t>(bn_bits(zr1.z)) > kTeeth * spacing_) {
+        // the exponent does not fit the table
+        gt_exp(gt.g, const_cast<GT&>(base_).g, zr1.z);
+        return gt;
+    }
+
+    for (size_t i = spacing_; i > 0; i--) {
+        gt_sqr(gt.g, gt.g);
+
+        size_t index = 0;
+        for (size_t j = 0; j < kTeeth; j++) {
+            const int bit = static_cast<int>(j * spacing_ + i - 1);
+            index |= static_cast<size_t>(bn_get_bit(zr1.z, bit)) << j;
+        }
+        gt_mul(gt.g, gt.g, const_cast<GT&>(table_[index]).g);
+    }
+    return gt;
+}
+
+namespace {
+
+// The fixed-base tables of the generators only depend on the curve: they are
+// built by the first PairingGroup, and shared by all the groups of the
+// process.
+std::shared_ptr<const G1FixedBase> g1_generator_table()
+{
+    static const std::shared_ptr<const G1FixedBase> table = []() {
+        G1 g;
+        g1_get_gen(g.g);
+        return std::make_shared<const G1FixedBase>(g);
+    }();
+    return table;
+}
+
+std::shared_ptr<const G2FixedBase> g2_generator_table()
+{
+    static const std::shared_ptr<const G2FixedBase> table = []() {
+        G2 g;
+        g2_get_gen(g.g);
+        return std::make_shared<const G2FixedBase>(g);
+    }();
+    return table;
+}
+
+} // namespace
+
 PairingGroup::PairingGroup()
 {
     error_if_relic_not_init();
     bn_inits(grp_order);
     g1_get_ord(grp_order);
     isInit = true; // user needs to call setCurve after construction
+
+    g1_gen_table = g1_generator_table();
+    g2_gen_table = g2_generator_table();
 }
 
 PairingGroup::~PairingGroup()
@@ -680,6 +927,55 @@ ZR PairingGroup::pseudoRandomZR(const sse::crypto::Prf<kPrfOutputSize>& prf,
     return zr;
 }
 
+std::vector<ZR> PairingGroup::pseudoRandomZR(
+    const sse::crypto::Prf<kPrfOutputSize>& prf,
+    const std::vector<std::string>&         seeds) const
+{
+    std::vector<std::array<uint8_t, kPrfOutputSize>> prf_out;
+    prf.prf_batch(seeds, prf_out);
+
+    std::vector<ZR> zrs(seeds.size());
+    ZR              tt;
+    for (size_t i = 0; i < seeds.size(); i++) {
+        bn_read_bin(tt.z, prf_out[i].data(), kPrfOutputSize);
+        bn_mod(zrs[i].z, tt.z, grp_order);
+    }
+    return zrs;
+}
+
+ZR PairingGroup::streamZR(const std::array<uint8_t, kStreamKeySize>& key,
+                          uint64_t                                   domain,
+                          uint64_t index) const
+{
+    static_assert(kStreamKeySize == crypto_stream_chacha20_KEYBYTES,
+                  "Invalid stream key size");
+    static_assert(kPrfOutputSize <= 64,
+                  "A scalar must fit in a single ChaCha20 block");
+
+    std::array<uint8_t, crypto_stream_chacha20_NONCEBYTES> nonce;
+    for (size_t i = 0; i < nonce.size(); i++) {
+        nonce[i] = static_cast<uint8_t>(domain >> (8 * i));
+    }
+
+    // as many bytes as pseudoRandomZR, for the same statistical distance to
+    // the uniform distribution after the reduction
+    std::array<uint8_t, kPrfOutputSize> block;
+    block.fill(0);
+    crypto_stream_chacha20_xor_ic(block.data(),
+                                  block.data(),
+                                  block.size(),
+                                  nonce.data(),
+                                  index,
+                                  key.data());
+
+    ZR zr, tt;
+    bn_read_bin(tt.z, block.data(), kPrfOutputSize);
+    bn_mod(zr.z, tt.z, grp_order);
+
+    sodium_memzero(block.data(), block.size());
+    return zr;
+}
+
 G1 PairingGroup::randomG1() const
 {
     G1 g1;
@@ -773,14 +1069,37 @@ G2 PairingGroup::div(const G2& g, const G2& h) const
 
 G2 PairingGroup::exp(const G2& g, const ZR& r) const
 {
+    // comparing the points is much cheaper than the multiplication we save
+    if (g == g2_gen_table->base()) {
+        return g2_gen_table->power(r);
+    }
     // g ^ r == g * r OR scalar multiplication
     return power(g, r);
 }
 
 G2 PairingGroup::exp(const G2& g, const int& r) const
 {
-    // g ^ r == g * r OR scalar multiplication
-    return power(g, ZR(r));
+    return exp(g, ZR(r));
+}
+
+G2 PairingGroup::exp(const G2FixedBase& g, const ZR& r) const
+{
+    return g.power(r);
+}
+
+G2 PairingGroup::mul_exp2(const G2& a,
+                          const ZR& x,
+                          const G2& b,
+                          const ZR& y) const
+{
+    G2 g2;
+    G2& a1 = const_cast<G2&>(a);
+    G2& b1 = const_cast<G2&>(b);
+    ZR& x1 = const_cast<ZR&>(x);
+    ZR& y1 = const_cast<ZR&>(y);
+    g2_mul_sim(g2.g, a1.g, x1.z, b1.g, y1.z);
+    count_operation(g2_exp_count);
+    return g2;
 }
 
 GT PairingGroup::pair(const G1& g, const G2& h) const
@@ -793,6 +1112,12 @@ GT PairingGroup::pair(const G2& h, const G1& g) const
     return pairing(g, h);
 }
 
+GT PairingGroup::pairProd(const std::vector<G1>& g,
+                          const std::vector<G2>& h) const
+{
+    return pairingProduct(g, h);
+}
+
 bool PairingGroup::ismember(GT& g)
 {
     return g.ismember(grp_order); // add code to check
@@ -887,14 +1212,36 @@ ZR PairingGroup::exp(const ZR& x, const ZR& y) const
 //// exp for G1 & GT
 G1 PairingGroup::exp(const G1& g, const ZR& r) const
 {
+    if (g == g1_gen_table->base()) {
+        return g1_gen_table->power(r);
+    }
     // g ^ r == g * r OR scalar multiplication
     return power(g, r);
 }
 
 G1 PairingGroup::exp(const G1& g, const int& r) const
 {
-    // g ^ r == g * r OR scalar multiplication
-    return power(g, ZR(r));
+    return exp(g, ZR(r));
+}
+
+G1 PairingGroup::exp(const G1FixedBase& g, const ZR& r) const
+{
+    return g.power(r);
+}
+
+G1 PairingGroup::mul_exp2(const G1& a,
+                          const ZR& x,
+                          const G1& b,
+                          const ZR& y) const
+{
+    G1 g1;
+    G1& a1 = const_cast<G1&>(a);
+    G1& b1 = const_cast<G1&>(b);
+    ZR& x1 = const_cast<ZR&>(x);
+    ZR& y1 = const_cast<ZR&>(y);
+    g1_mul_sim(g1.g, a1.g, x1.z, b1.g, y1.z);
+    count_operation(g1_exp_count);
+    return g1;
 }
 
 GT PairingGroup::exp(const GT& g, const ZR& r) const
@@ -903,6 +1250,11 @@ GT PairingGroup::exp(const GT& g, const ZR& r) const
     return power(g, r);
 }
 
+GT PairingGroup::exp(const GTFixedBase& g, const ZR& r) const
+{
+    return g.power(r);
+}
+
 GT PairingGroup::exp(const GT& g, const int& r) const
 {
     // g ^ r == g * r OR scalar multiplication
@@ -12,6 +12,7 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <type_traits> // for static assert
@@ -23,7 +24,10 @@
 // At last on osx  causes error: conflicting types for 'operator<<'.
 // undefinning __cplusplus "FIXES" this.
 //#include <gmpxx.h>
-#define ___cplusplus __cplusplus
+// __cplusplus is saved and restored: the C++ headers included afterwards
+// need it.
+#pragma push_macro("__cplusplus")
+#define ___cplusplus
 #undef __cplusplus
 extern "C" {
 #endif
@@ -32,7 +36,7 @@ extern "C" {
 
 #ifdef ___cplusplus
 }
-#define __cplusplus ___cplusplus
+#pragma pop_macro("__cplusplus")
 #undef ___cplusplus
 #endif
 
@@ -73,6 +77,16 @@ static_assert(MULTI == OPENMP,
 
 #define convert_str(a) a /* nothing */
 
+// The wrappers can be moved: the moved-from object hands its relic storage
+// over instead of having it copied, and can then only be assigned to or
+// destroyed. Define RELICXX_NO_MOVE to always copy.
+#ifndef RELICXX_NO_MOVE
+#define RELICXX_MOVEZR
+#define RELICXX_MOVEG1
+#define RELICXX_MOVEG2
+#define RELICXX_MOVEGT
+#endif
+
 // Starting from commit 70884fc8b6d893bcc5fd41b8ca0c4d204e03f882, RELIC does not
 // define RELIC_BN_BYTES anymore.
 // Do it ourself if necessary.
@@ -81,6 +95,14 @@ static_assert(MULTI == OPENMP,
 #define RELIC_BN_BYTES CEIL(RELIC_BN_BITS, 8)
 #endif
 
+// Same thing for the size of the fixed-base precomputation tables, that got
+// the RLC_ prefix at the same time.
+#if defined(RLC_EP_TABLE)
+#define RELICXX_EP_TABLE RLC_EP_TABLE
+#else
+#define RELICXX_EP_TABLE EP_TABLE
+#endif
+
 namespace relicxx {
 using bytes_vec = std::vector<uint8_t>;
 void ro_error();
@@ -99,6 +121,24 @@ public:
     }
 };
 
+// Number of expensive group operations performed by the whole process. They
+// are meant for benchmarking: the difference between two snapshots is the
+// cost of the operations run in between. The operations are only counted
+// when the library is built with RELICXX_COUNT_OPERATIONS defined (the
+// counts are always 0 otherwise).
+struct OperationCounts
+{
+    uint64_t miller_loops{0}; // a product of n pairings counts for n
+    uint64_t final_exps{0};   // one per pairing or product of pairings
+    uint64_t g1_exps{0};      // a multi-exponentiation counts for one
+    uint64_t g2_exps{0};
+    uint64_t gt_exps{0};
+
+    static OperationCounts current();
+
+    OperationCounts operator-(const OperationCounts& c) const;
+};
+
 void error_if_relic_not_init();
 class ZR
 {
@@ -139,30 +179,31 @@ public:
     }
 
 #ifdef RELICXX_MOVEZR
-    ZR(ZR&& other)
+    // With ALLOC == DYNAMIC, bn_t is a pointer and the copy below takes the
+    // ownership of the digits. Otherwise, it copies them, without any call
+    // to relic.
+    ZR(ZR&& other) : isInit(other.isInit)
     {
-        *this = std::move(other);
+        if (isInit) {
+            std::memcpy(&z, &other.z, sizeof(z));
+            std::memcpy(&order, &other.order, sizeof(order));
+            other.isInit = false;
+        }
     }
 
     ZR& operator=(ZR&& rhs)
     {
-        if (this != &rhs && rhs.isInit) {
-            isInit     = rhs.isInit;
-            rhs.isInit = false;
+        if (this != &rhs) {
             if (isInit) {
                 bn_free(z);
                 bn_free(order);
             }
-#if ALLOC == AUTO
-            z[0]     = rhs.z[0];
-            order[0] = rhs.order[0];
-            std::memset((&rhs.z[0]), 0, sizeof(rhs.z[0]));
-#else
-            z         = rhs.z;
-            order     = rhs.order;
-            rhs.z     = nullptr;
-            rhs.order = nulltpr;
-#endif
+            isInit = rhs.isInit;
+            if (isInit) {
+                std::memcpy(&z, &rhs.z, sizeof(z));
+                std::memcpy(&order, &rhs.order, sizeof(order));
+                rhs.isInit = false;
+            }
         }
         return *this;
     }
@@ -176,20 +217,14 @@ public:
     }
     ZR& operator=(const ZR& w)
     {
-        if (isInit) {
-            bn_copy(z, w.z);
-            bn_copy(order, w.order);
-        } else {
-            {
-                {
-                    {
-                        {
-                            ro_error();
-                        }
-                    }
-                }
-            }
+        if (!isInit) {
+            // moved-from object
+            bn_inits(z);
+            bn_inits(order);
+            isInit = true;
         }
+        bn_copy(z, w.z);
+        bn_copy(order, w.order);
         return *this;
     }
 
@@ -350,25 +385,24 @@ public:
         }
     }
 #ifdef RELICXX_MOVEG1
-    G1(G1&& other)
+    G1(G1&& other) : isInit(other.isInit)
     {
-        *this = std::move(other);
+        if (isInit) {
+            std::memcpy(&g, &other.g, sizeof(g));
+            other.isInit = false;
+        }
     }
     G1& operator=(G1&& rhs)
     {
-        if (this != &rhs && rhs.isInit) {
-            isInit     = rhs.isInit;
-            rhs.isInit = false;
+        if (this != &rhs) {
             if (isInit) {
                 g1_free(g);
             }
-#if ALLOC == AUTO
-            g[0] = rhs.g[0];
-            std::memset((&rhs.g[0]), 0, sizeof(rhs.g[0]));
-#else
-            g         = rhs.g;
-            rhs.g     = nullptr;
-#endif
+            isInit = rhs.isInit;
+            if (isInit) {
+                std::memcpy(&g, &rhs.g, sizeof(g));
+                rhs.isInit = false;
+            }
         }
         return *this;
     }
@@ -376,27 +410,12 @@ public:
 #endif
     G1& operator=(const G1& w)
     {
-        if (isInit) {
-            {
-                {
-                    {
-                        {
-                            g1_copy(g, w.g);
-                        }
-                    }
-                }
-            }
-        } else {
-            {
-                {
-                    {
-                        {
-                            ro_error();
-                        }
-                    }
-                }
-            }
+        if (!isInit) {
+            // moved-from object
+            g1_inits(g);
+            isInit = true;
         }
+        g1_copy(g, w.g);
         return *this;
     }
 
@@ -451,25 +470,24 @@ public:
         }
     }
 #ifdef RELICXX_MOVEG2
-    G2(G2&& other)
+    G2(G2&& other) : isInit(other.isInit)
     {
-        *this = std::move(other);
+        if (isInit) {
+            std::memcpy(&g, &other.g, sizeof(g));
+            other.isInit = false;
+        }
     }
     G2& operator=(G2&& rhs)
     {
-        if (this != &rhs && rhs.isInit) {
-            isInit     = rhs.isInit;
-            rhs.isInit = false;
+        if (this != &rhs) {
             if (isInit) {
                 g2_free(g);
             }
-#if ALLOC == AUTO
-            g[0] = rhs.g[0];
-            std::memset((&rhs.g[0]), 0, sizeof(rhs.g[0]));
-#else
-            g         = rhs.g;
-            rhs.g     = nulltpr;
-#endif
+            isInit = rhs.isInit;
+            if (isInit) {
+                std::memcpy(&g, &rhs.g, sizeof(g));
+                rhs.isInit = false;
+            }
         }
         return *this;
     }
@@ -477,27 +495,12 @@ public:
 
     G2& operator=(const G2& w)
     {
-        if (isInit) {
-            {
-                {
-                    {
-                        {
-                            g2_copy(g, const_cast<G2&>(w).g);
-                        }
-                    }
-                }
-            }
-        } else {
-            {
-                {
-                    {
-                        {
-                            ro_error();
-                        }
-                    }
-                }
-            }
+        if (!isInit) {
+            // moved-from object
+            g2_inits(g);
+            isInit = true;
         }
+        g2_copy(g, const_cast<G2&>(w).g);
         return *this;
     }
     bool                 ismember(bn_t /*order*/);
@@ -553,45 +556,35 @@ public:
 
     GT& operator=(const GT& x)
     {
-        if (isInit) {
-            {
-                {
-                    {
-                        {
-                            gt_copy(g, const_cast<GT&>(x).g);
-                        }
-                    }
-                }
-            }
-        } else {
-            {
-                {
-                    {
-                        {
-                            ro_error();
-                        }
-                    }
-                }
-            }
+        if (!isInit) {
+            // moved-from object
+            gt_inits(g);
+            isInit = true;
         }
+        gt_copy(g, const_cast<GT&>(x).g);
         return *this;
     }
 #ifdef RELICXX_MOVEGT
+    // gt_t is an array of fp_t: with ALLOC == DYNAMIC, the copy takes the
+    // ownership of all the coordinates
+    GT(GT&& other) : isInit(other.isInit)
+    {
+        if (isInit) {
+            std::memcpy(&g, &other.g, sizeof(g));
+            other.isInit = false;
+        }
+    }
     GT& operator=(GT&& rhs)
     {
-        if (this != &rhs && rhs.isInit) {
-            isInit     = rhs.isInit;
-            rhs.isInit = false;
+        if (this != &rhs) {
             if (isInit) {
                 gt_free(g);
             }
-#if ALLOC == AUTO
-            std::memcpy(*g, *(rhs.g), sizeof(g));
-            std::memset((&rhs.g[0]), 0, sizeof(rhs.g[0]));
-#else
-            g         = rhs.g;
-            rhs.g     = nullptr;
-#endif
+            isInit = rhs.isInit;
+            if (isInit) {
+                std::memcpy(&g, &rhs.g, sizeof(g));
+                rhs.isInit = false;
+            }
         }
         return *this;
     }
@@ -604,6 +597,8 @@ public:
 
     friend GT            pairing(const G1&, const G1&);
     friend GT            pairing(const G1& /*g1*/, const G2& /*g2*/);
+    friend GT            pairingProduct(const std::vector<G1>& /*g1*/,
+                                        const std::vector<G2>& /*g2*/);
     friend GT            power(const GT& /*g*/, const ZR& /*zr*/);
     friend GT            operator-(const GT& /*g*/);
     friend GT            operator/(const GT& /*x*/, const GT& /*y*/);
@@ -619,6 +614,86 @@ public:
     }
 };
 
+// Precomputed table for the scalar multiplications by a fixed G1 element.
+// The table is built once (g1_mul_pre) and is read-only afterwards: it can be
+// shared between threads.
+class G1FixedBase
+{
+public:
+    explicit G1FixedBase(const G1& base);
+    ~G1FixedBase();
+
+    G1FixedBase(const G1FixedBase&) = delete;
+    G1FixedBase& operator=(const G1FixedBase&) = delete;
+
+    const G1& base() const
+    {
+        return base_;
+    }
+
+    // Returns base^zr, using g1_mul_fix
+    G1 power(const ZR& zr) const;
+
+private:
+    G1   base_;
+    g1_t table_[RELICXX_EP_TABLE];
+};
+
+// Precomputed table for the scalar multiplications by a fixed G2 element.
+class G2FixedBase
+{
+public:
+    explicit G2FixedBase(const G2& base);
+    ~G2FixedBase();
+
+    G2FixedBase(const G2FixedBase&) = delete;
+    G2FixedBase& operator=(const G2FixedBase&) = delete;
+
+    const G2& base() const
+    {
+        return base_;
+    }
+
+    // Returns base^zr, using g2_mul_fix
+    G2 power(const ZR& zr) const;
+
+private:
+    G2   base_;
+    g2_t table_[RELICXX_EP_TABLE];
+};
+
+// Precomputed table for the exponentiations of a fixed GT element. relic has
+// no fixed-base exponentiation in GT, so this is a Lim-Lee comb: the exponent
+// is split in kTeeth interleaved chunks, and every step of the evaluation
+// consumes one bit of each chunk, with a single squaring and a single
+// multiplication.
+class GTFixedBase
+{
+public:
+    static constexpr unsigned int kTeeth = 8;
+
+    explicit GTFixedBase(const GT& base);
+
+    GTFixedBase(const GTFixedBase&) = delete;
+    GTFixedBase& operator=(const GTFixedBase&) = delete;
+
+    const GT& base() const
+    {
+        return base_;
+    }
+
+    // Returns base^zr
+    GT power(const ZR& zr) const;
+
+private:
+    GT base_;
+    // number of bits of each chunk of the exponent
+    size_t spacing_;
+    // table_[i] is the product of the base^(2^(j*spacing_)) for the bits j
+    // set in i
+    std::vector<GT> table_;
+};
+
 class relicResourceHandle
 {
 public:
@@ -653,6 +728,19 @@ public:
     ZR randomZR() const;
     ZR pseudoRandomZR(const sse::crypto::Prf<kPrfOutputSize>& prf,
                       const std::string&                      seed) const;
+    // Same as calling pseudoRandomZR on every seed, with a single PRF batch
+    std::vector<ZR> pseudoRandomZR(
+        const sse::crypto::Prf<kPrfOutputSize>& prf,
+        const std::vector<std::string>&         seeds) const;
+
+    constexpr static size_t kStreamKeySize = 32;
+    // Deterministic stream of scalars, addressed by a domain and an index:
+    // the scalar is read from the index-th ChaCha20 block under key, with the
+    // domain as the nonce. It is much cheaper than pseudoRandomZR: there is
+    // no HMAC, and no label to format.
+    ZR streamZR(const std::array<uint8_t, kStreamKeySize>& key,
+                uint64_t                                   domain,
+                uint64_t                                   index) const;
 
 
     G1 randomG1() const;
@@ -673,10 +761,22 @@ public:
     G2 random(G2_type) const;
     G2 mul(const G2& /*g*/, const G2& /*h*/) const;
     G2 div(const G2& /*g*/, const G2& /*h*/) const;
+    // The exponentiations of the generators of G1 and G2 are routed to
+    // precomputed fixed-base tables. Other long-lived bases can be
+    // precomputed by the caller, using G1FixedBase and G2FixedBase.
     G2 exp(const G2& /*g*/, const ZR& /*r*/) const;
     G2 exp(const G2& /*g*/, const int& /*r*/) const;
+    G2 exp(const G2FixedBase& /*g*/, const ZR& /*r*/) const;
+    // a^x * b^y, with a simultaneous multi-exponentiation (g2_mul_sim): it
+    // shares the doublings of the two exponentiations
+    G2 mul_exp2(const G2& a, const ZR& x, const G2& b, const ZR& y) const;
     GT pair(const G1& /*g*/, const G2& /*h*/) const;
     GT pair(const G2& /*h*/, const G1& /*g*/) const;
+    // Product of the pairings e(g[i], h[i]), computed with a simultaneous
+    // multi-pairing: the Miller loops share their squarings, and there is a
+    // single final exponentiation. g and h must have the same size.
+    GT pairProd(const std::vector<G1>& /*g*/,
+                const std::vector<G2>& /*h*/) const;
     ZR order() const; // returns the order of the group
 
     ZR hashListToZR(const std::string& str) const;
@@ -708,8 +808,12 @@ public:
     ZR exp(const ZR& /*x*/, const ZR& /*y*/) const;
     G1 exp(const G1& /*g*/, const ZR& /*r*/) const;
     G1 exp(const G1& /*g*/, const int& /*r*/) const;
+    G1 exp(const G1FixedBase& /*g*/, const ZR& /*r*/) const;
+    // a^x * b^y, with a simultaneous multi-exponentiation (g1_mul_sim)
+    G1 mul_exp2(const G1& a, const ZR& x, const G1& b, const ZR& y) const;
     GT exp(const GT& /*g*/, const ZR& /*r*/) const;
     GT exp(const GT& /*g*/, const int& /*r*/) const;
+    GT exp(const GTFixedBase& /*g*/, const ZR& /*r*/) const;
 
     ZR  add(const ZR& /*g*/, const ZR& /*h*/) const;
     int add(const int& /*g*/, const int& /*h*/) const;
@@ -726,6 +830,10 @@ public:
 private:
     bool isInit;
     bn_t grp_order;
+
+    // fixed-base tables for the generators, shared by all the groups
+    std::shared_ptr<const G1FixedBase> g1_gen_table;
+    std::shared_ptr<const G2FixedBase> g2_gen_table;
 };
 
 } // namespace relicxx
@@ -3,6 +3,8 @@
 #include "relic_wrapper/relic_api.h"
 
 #include <array>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace sse {
@@ -38,6 +40,42 @@ relicxx::ZR LagrangeBasisCoefficients(
     return prod;
 }
 
+// Sets inverses[i] to the inverse of value(i) for i in [0, n), with a single
+// modular inversion (Montgomery's trick). value(i) is evaluated twice instead
+// of being stored, so that inverses is the only buffer: it can be reused
+// across calls. Throws a std::logic_error if one of the values is zero.
+template<class F>
+void BatchInverse(const relicxx::PairingGroup& group,
+                  size_t                       n,
+                  const F&                     value,
+                  std::vector<relicxx::ZR>&    inverses)
+{
+    inverses.resize(n);
+    if (n == 0) {
+        return;
+    }
+
+    const relicxx::ZR zero(0);
+
+    // inverses[i] is first the product of value(0..i)
+    for (size_t i = 0; i < n; i++) {
+        relicxx::ZR v = value(i);
+        if (v == zero) {
+            throw std::logic_error("BatchInverse failed: zero element");
+        }
+        inverses[i] = (i == 0) ? v : group.mul(inverses[i - 1], v);
+    }
+
+    // inv is the inverse of the product of value(0..i)
+    relicxx::ZR inv = group.inv(inverses[n - 1]);
+    for (size_t i = n - 1; i > 0; i--) {
+        relicxx::ZR inv_i = group.mul(inv, inverses[i - 1]);
+        inv               = group.mul(inv, value(i));
+        inverses[i]       = std::move(inv_i);
+    }
+    inverses[0] = std::move(inv);
+}
+
 relicxx::ZR LagrangeInterp(
     const relicxx::PairingGroup&    group,
     const relicxx::ZR&              x,
@@ -51,13 +89,27 @@ type LagrangeInterpInExponent(
     const std::array<relicxx::ZR, N>& polynomial_xcordinates,
     const std::array<type, N>&        exp_polynomial_ycordinates)
 {
-    type prod;
+    std::array<relicxx::ZR, N> lagrangeBasisPolyatX;
     for (uint j = 0; j < N; j++) {
-        relicxx::ZR lagrangeBasisPolyatX
+        lagrangeBasisPolyatX[j]
             = LagrangeBasisCoefficients(group, j, x, polynomial_xcordinates);
+    }
+
+    // the terms are exponentiated two at a time, with a simultaneous
+    // multi-exponentiation
+    type prod;
+    uint j = 0;
+    for (; j + 1 < N; j += 2) {
+        prod = group.mul(prod,
+                         group.mul_exp2(exp_polynomial_ycordinates[j],
+                                        lagrangeBasisPolyatX[j],
+                                        exp_polynomial_ycordinates[j + 1],
+                                        lagrangeBasisPolyatX[j + 1]));
+    }
+    if (j < N) {
         prod = group.mul(
             prod,
-            group.exp(exp_polynomial_ycordinates[j], lagrangeBasisPolyatX));
+            group.exp(exp_polynomial_ycordinates[j], lagrangeBasisPolyatX[j]));
     }
     return prod;
 }
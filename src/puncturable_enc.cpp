@@ -23,6 +23,12 @@
 #include "ppke/GMPpke.hpp"
 #include "prf.hpp"
 
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+
+#include <sodium/utils.h>
+
 namespace sse {
 
 namespace crypto {
@@ -33,20 +39,47 @@ static_assert(punct::kCiphertextSize == GmmppkeCT<uint64_t>::kCTByteSize,
               "Invalid Ciphertext Size");
 static_assert(punct::kKeyShareSize == GmppkePrivateKeyShare::kByteSize,
               "Invalid Key share Size");
+static_assert(punct::kUncompressedCiphertextSize
+                  == GmmppkeCT<uint64_t>::kUncompressedCTByteSize,
+              "Invalid Uncompressed Ciphertext Size");
+static_assert(punct::kUncompressedKeyShareSize
+                  == GmppkePrivateKeyShare::kUncompressedByteSize,
+              "Invalid Uncompressed Key share Size");
+
+namespace punct {
+uncompressed_key_share_type uncompress(const key_share_type& keyshare)
+{
+    uncompressed_key_share_type out;
+    GmppkePrivateKeyShare(keyshare.data(), true).writeBytes(out.data(), false);
+
+    return out;
+}
+
+uncompressed_ciphertext_type uncompress(const ciphertext_type& ciphertext)
+{
+    uncompressed_ciphertext_type out;
+    GmmppkeCT<uint64_t>(ciphertext.data(), true).writeBytes(out.data(), false);
+
+    return out;
+}
+} // namespace punct
 
 class PuncturableEncryption::PEncImpl
 {
 public:
-    explicit PEncImpl(punct::master_key_type&& key);
+    PEncImpl(punct::master_key_type&& key, punct::ScalarDerivation derivation);
 
     punct::ciphertext_type encrypt(const uint64_t         m,
                                    const punct::tag_type& tag);
     punct::key_share_type  initial_keyshare(const size_t d);
     punct::key_share_type  inc_puncture(const size_t           d,
                                         const punct::tag_type& tag);
+    std::vector<punct::key_share_type> inc_puncture_batch(
+        const size_t                        d_start,
+        const std::vector<punct::tag_type>& tags);
 
 private:
-    const Gmppke ppke_{};
+    const Gmppke ppke_;
 
     sse::crypto::GmppkeSecretParameters        sp_;
     const sse::crypto::Prf<kPPKEPrfOutputSize> master_prf_;
@@ -54,11 +87,21 @@ private:
     static_assert(punct::kMasterKeySize
                       == sse::crypto::Prf<kPPKEPrfOutputSize>::kKeySize,
                   "PPKE: Invalid master key size");
+    static_assert(static_cast<uint8_t>(punct::ScalarDerivation::kLabeledPrf)
+                          == static_cast<uint8_t>(
+                              GmppkeScalarDerivation::kLabeledPrf)
+                      && static_cast<uint8_t>(
+                             punct::ScalarDerivation::kChaChaStream)
+                             == static_cast<uint8_t>(
+                                 GmppkeScalarDerivation::kChaChaStream),
+                  "PPKE: Inconsistent scalar derivation modes");
 };
 
 
-PuncturableEncryption::PEncImpl::PEncImpl(punct::master_key_type&& key)
-    : master_prf_(std::move(key))
+PuncturableEncryption::PEncImpl::PEncImpl(punct::master_key_type&& key,
+                                          punct::ScalarDerivation  derivation)
+    : ppke_(static_cast<GmppkeScalarDerivation>(derivation)),
+      master_prf_(std::move(key))
 {
     PPKE.paramgen(master_prf_, sp_);
 }
@@ -87,6 +130,33 @@ punct::key_share_type PuncturableEncryption::PEncImpl::inc_puncture(
     return ks_bytes;
 }
 
+std::vector<punct::key_share_type> PuncturableEncryption::PEncImpl::
+    inc_puncture_batch(const size_t                        d_start,
+                       const std::vector<punct::tag_type>& tags)
+{
+    if (d_start == 0) {
+        throw std::invalid_argument(
+            "Invalid puncture count: the first keyshare is generated by "
+            "initial_keyshare.");
+    }
+    for (const auto& tag : tags) {
+        if (tag == Gmppke::NULLTAG) {
+            throw std::invalid_argument(
+                "Invalid tag: the NULLTAG is reserved and cannot be used.");
+        }
+    }
+
+    const std::vector<GmppkePrivateKeyShare> shares
+        = PPKE.skShareGen(master_prf_, sp_, d_start, tags);
+
+    std::vector<punct::key_share_type> shares_bytes(shares.size());
+    for (size_t i = 0; i < shares.size(); i++) {
+        shares[i].writeBytes(shares_bytes[i].data());
+    }
+
+    return shares_bytes;
+}
+
 punct::key_share_type PuncturableEncryption::PEncImpl::initial_keyshare(
     const size_t d)
 {
@@ -97,8 +167,10 @@ punct::key_share_type PuncturableEncryption::PEncImpl::initial_keyshare(
     return ks_bytes;
 }
 
-PuncturableEncryption::PuncturableEncryption(punct::master_key_type&& key)
-    : penc_imp_(new PEncImpl(std::move(key)))
+PuncturableEncryption::PuncturableEncryption(
+    punct::master_key_type&& key,
+    punct::ScalarDerivation  derivation)
+    : penc_imp_(new PEncImpl(std::move(key), derivation))
 {
 }
 
@@ -126,37 +198,172 @@ punct::key_share_type PuncturableEncryption::inc_puncture(
     return penc_imp_->inc_puncture(d, tag);
 }
 
+std::vector<punct::key_share_type> PuncturableEncryption::inc_puncture_batch(
+    const size_t                        d_start,
+    const std::vector<punct::tag_type>& tags)
+{
+    return penc_imp_->inc_puncture_batch(d_start, tags);
+}
+
 
 class PuncturableDecryption::PDecImpl
 {
 public:
     explicit PDecImpl(const punct::punctured_key_type& punctured_key);
+    explicit PDecImpl(
+        const punct::uncompressed_punctured_key_type& punctured_key);
+
+    // Wipes the serialized key shares if the key was never prepared
+    ~PDecImpl();
 
     bool is_punctured_on_tag(const punct::tag_type& tag);
-    bool decrypt(const punct::ciphertext_type& ct_bytes, uint64_t& m) const;
+
+    template<size_t N>
+    bool decrypt(const std::array<uint8_t, N>& ct_bytes, uint64_t& m) const;
+
+    template<size_t N>
+    void decrypt_batch(const std::vector<std::array<uint8_t, N>>& cts_bytes,
+                       std::vector<uint64_t>&                     ms,
+                       std::vector<bool>&                         ok) const;
 
 private:
     const Gmppke ppke_{};
 
-    GmppkePrivateKey sk_;
+    // The key is immutable: the ciphertext independent part of the
+    // decryption is computed once. It is only done on the first decryption,
+    // as parsing the shares (and decompressing their points) is expensive.
+    // The framing of the shares is checked by the constructor.
+    const GmppkePreparedPrivateKey& prepared_key() const;
+
+    // Throws a std::invalid_argument if the key has no share, or if the
+    // encoding of one of its points is invalid
+    void check_framing() const;
+
+    mutable std::once_flag           prepare_flag_;
+    mutable GmppkePreparedPrivateKey sk_;
+    // the error of the preparation, rethrown by every decryption
+    mutable std::exception_ptr prepare_error_;
+
+    // the serialized key shares, until the key is prepared
+    mutable std::vector<uint8_t> key_bytes_;
+    bool                         key_compressed_;
 };
 
 PuncturableDecryption::PDecImpl::PDecImpl(
     const punct::punctured_key_type& punctured_key)
+    : key_compressed_(true)
+{
+    key_bytes_.reserve(punctured_key.size() * punct::kKeyShareSize);
+    for (const auto& share : punctured_key) {
+        key_bytes_.insert(key_bytes_.end(), share.begin(), share.end());
+    }
+    check_framing();
+}
+
+PuncturableDecryption::PDecImpl::PDecImpl(
+    const punct::uncompressed_punctured_key_type& punctured_key)
+    : key_compressed_(false)
 {
-    std::vector<GmppkePrivateKeyShare> shares(punctured_key.size());
-    for (size_t i = 0; i < punctured_key.size(); i++) {
-        shares[i] = GmppkePrivateKeyShare(punctured_key[i].data());
+    key_bytes_.reserve(punctured_key.size()
+                       * punct::kUncompressedKeyShareSize);
+    for (const auto& share : punctured_key) {
+        key_bytes_.insert(key_bytes_.end(), share.begin(), share.end());
     }
+    check_framing();
+}
+
+PuncturableDecryption::PDecImpl::~PDecImpl()
+{
+    if (!key_bytes_.empty()) {
+        sodium_memzero(key_bytes_.data(), key_bytes_.size());
+    }
+}
 
-    sk_ = GmppkePrivateKey(shares);
+void PuncturableDecryption::PDecImpl::check_framing() const
+{
+    const size_t share_size
+        = key_compressed_ ? GmppkePrivateKeyShare::kByteSize
+                          : GmppkePrivateKeyShare::kUncompressedByteSize;
+
+    if (key_bytes_.empty()) {
+        throw std::invalid_argument("Invalid punctured key: no key share");
+    }
+    for (size_t pos = 0; pos < key_bytes_.size(); pos += share_size) {
+        if (!GmppkePrivateKeyShare::hasValidFraming(key_bytes_.data() + pos,
+                                                    key_compressed_)) {
+            throw std::invalid_argument(
+                "Invalid punctured key: invalid point encoding");
+        }
+    }
 }
 
+const GmppkePreparedPrivateKey& PuncturableDecryption::PDecImpl::prepared_key()
+    const
+{
+    std::call_once(prepare_flag_, [this]() {
+        const size_t share_size
+            = key_compressed_ ? GmppkePrivateKeyShare::kByteSize
+                              : GmppkePrivateKeyShare::kUncompressedByteSize;
+        const size_t n_shares = key_bytes_.size() / share_size;
+
+        // do not parse the key again on the next decryptions if it fails
+        try {
+            std::vector<GmppkePrivateKeyShare> shares;
+            shares.reserve(n_shares);
+            for (size_t i = 0; i < n_shares; i++) {
+                shares.emplace_back(key_bytes_.data() + i * share_size,
+                                    key_compressed_);
+            }
+
+            sk_ = PPKE.prepare(GmppkePrivateKey(std::move(shares)));
+        } catch (...) {
+            prepare_error_ = std::current_exception();
+        }
+
+        // the serialized key is not needed anymore: wipe it before freeing
+        // its buffer
+        sodium_memzero(key_bytes_.data(), key_bytes_.size());
+        std::vector<uint8_t>().swap(key_bytes_);
+    });
+
+    if (prepare_error_) {
+        std::rethrow_exception(prepare_error_);
+    }
+    return sk_;
+}
+
+template<size_t N>
 bool PuncturableDecryption::PDecImpl::decrypt(
-    const punct::ciphertext_type& ct_bytes,
+    const std::array<uint8_t, N>& ct_bytes,
     uint64_t&                     m) const
 {
-    return PPKE.decrypt(sk_, GmmppkeCT<uint64_t>(ct_bytes.data()), m);
+    static_assert(N == punct::kCiphertextSize
+                      || N == punct::kUncompressedCiphertextSize,
+                  "Invalid ciphertext size");
+
+    return PPKE.decrypt(
+        prepared_key(),
+        GmmppkeCT<uint64_t>(ct_bytes.data(), N == punct::kCiphertextSize),
+        m);
+}
+
+template<size_t N>
+void PuncturableDecryption::PDecImpl::decrypt_batch(
+    const std::vector<std::array<uint8_t, N>>& cts_bytes,
+    std::vector<uint64_t>&                     ms,
+    std::vector<bool>&                         ok) const
+{
+    static_assert(N == punct::kCiphertextSize
+                      || N == punct::kUncompressedCiphertextSize,
+                  "Invalid ciphertext size");
+
+    std::vector<GmmppkeCT<uint64_t>> cts;
+    cts.reserve(cts_bytes.size());
+    for (const auto& ct_bytes : cts_bytes) {
+        cts.emplace_back(ct_bytes.data(), N == punct::kCiphertextSize);
+    }
+
+    PPKE.decrypt_batch(prepared_key(), cts, ms, ok);
 }
 
 
@@ -166,6 +373,12 @@ PuncturableDecryption::PuncturableDecryption(
 {
 }
 
+PuncturableDecryption::PuncturableDecryption(
+    const punct::uncompressed_punctured_key_type& punctured_key)
+    : pdec_imp_(new PDecImpl(punctured_key))
+{
+}
+
 PuncturableDecryption::~PuncturableDecryption()
 {
     delete pdec_imp_;
@@ -178,6 +391,29 @@ bool PuncturableDecryption::decrypt(const punct::ciphertext_type& ct,
     return pdec_imp_->decrypt(ct, m);
 }
 
+bool PuncturableDecryption::decrypt(
+    const punct::uncompressed_ciphertext_type& ct,
+    uint64_t&                                  m)
+{
+    return pdec_imp_->decrypt(ct, m);
+}
+
+void PuncturableDecryption::decrypt_batch(
+    const std::vector<punct::ciphertext_type>& cts,
+    std::vector<uint64_t>&                     ms,
+    std::vector<bool>&                         ok)
+{
+    pdec_imp_->decrypt_batch(cts, ms, ok);
+}
+
+void PuncturableDecryption::decrypt_batch(
+    const std::vector<punct::uncompressed_ciphertext_type>& cts,
+    std::vector<uint64_t>&                                  ms,
+    std::vector<bool>&                                      ok)
+{
+    pdec_imp_->decrypt_batch(cts, ms, ok);
+}
+
 
 } // namespace crypto
 } // namespace sse
@@ -82,39 +82,62 @@ using TdpMultPoolImpl_Current = TdpMultPoolImpl_mbedTLS;
 
 static_assert(Tdp::kMessageSize == TdpInverse::kMessageSize,
               "Constants kMessageSize of Tdp and TdpInverse do not match");
+static_assert(Tdp::kMessageSize == TdpChain::kMessageSize,
+              "Constants kMessageSize of Tdp and TdpChain do not match");
 
-Tdp::Tdp(const std::string& pk) : tdp_imp_(new TdpImpl_Current(pk))
+TdpChain::TdpChain(TdpChainImpl* chain_imp) : chain_imp_(chain_imp)
+{
+}
+
+TdpChain::TdpChain(TdpChain&& c) noexcept : chain_imp_(c.chain_imp_)
+{
+    c.chain_imp_ = nullptr;
+}
+
+TdpChain::~TdpChain()
 {
+    delete chain_imp_;
+    chain_imp_ = nullptr;
 }
 
-Tdp::Tdp(const Tdp& t)
-    : tdp_imp_(new TdpImpl_Current(
-          *dynamic_cast<const TdpImpl_Current*>(t.tdp_imp_)))
+void TdpChain::next(std::array<uint8_t, kMessageSize>& out)
 {
+    chain_imp_->next(out);
 }
 
-Tdp::~Tdp()
+void TdpChain::advance(uint32_t steps)
 {
-    delete tdp_imp_;
-    tdp_imp_ = nullptr;
+    chain_imp_->advance(steps);
 }
 
-Tdp& Tdp::operator=(const Tdp& t)
+void TdpChain::value(std::array<uint8_t, kMessageSize>& out) const
 {
-    if ((this != &t) && (tdp_imp_ != t.tdp_imp_)) {
-        delete tdp_imp_;
-        tdp_imp_ = new TdpImpl_Current(
-            *dynamic_cast<const TdpImpl_Current*>(t.tdp_imp_));
-    }
+    chain_imp_->value(out);
+}
+
 
-    return *this;
+Tdp::Tdp(const std::string& pk) : tdp_imp_(new TdpImpl_Current(pk))
+{
 }
 
+// The implementations are never modified after their construction: the
+// copies share them
+Tdp::Tdp(const Tdp& t) = default;
+
+Tdp::~Tdp() = default;
+
+Tdp& Tdp::operator=(const Tdp& t) = default;
+
 std::string Tdp::public_key() const
 {
     return tdp_imp_->public_key();
 }
 
+std::string Tdp::public_key_binary() const
+{
+    return tdp_imp_->public_key_binary();
+}
+
 std::string Tdp::sample() const
 {
     return tdp_imp_->sample();
@@ -149,6 +172,21 @@ std::array<uint8_t, Tdp::kMessageSize> Tdp::generate_array(
     return tdp_imp_->generate_array(prf, seed);
 }
 
+void Tdp::sample_batch(
+    size_t                                          n,
+    std::vector<std::array<uint8_t, kMessageSize>>& out) const
+{
+    tdp_imp_->sample_batch(n, out);
+}
+
+void Tdp::generate_batch(
+    const Prf<Tdp::kRSAPrfSize>&                    prf,
+    const std::vector<std::string>&                 seeds,
+    std::vector<std::array<uint8_t, kMessageSize>>& out) const
+{
+    tdp_imp_->generate_batch(prf, seeds, out);
+}
+
 void Tdp::eval(const std::string& in, std::string& out) const
 {
     tdp_imp_->eval(in, out);
@@ -168,6 +206,24 @@ std::array<uint8_t, Tdp::kMessageSize> Tdp::eval(
     return tdp_imp_->eval(in);
 }
 
+void Tdp::eval(const std::array<uint8_t, kMessageSize>& in,
+               std::array<uint8_t, kMessageSize>&       out) const
+{
+    tdp_imp_->eval(in, out);
+}
+
+TdpChain Tdp::eval_chain(const std::array<uint8_t, kMessageSize>& start) const
+{
+    return TdpChain(tdp_imp_->eval_chain(start));
+}
+
+void Tdp::eval_batch(const std::vector<std::array<uint8_t, kMessageSize>>& in,
+                     std::vector<std::array<uint8_t, kMessageSize>>&       out,
+                     unsigned int n_threads) const
+{
+    tdp_imp_->eval_batch(in, out, n_threads);
+}
+
 TdpInverse::TdpInverse() : tdp_inv_imp_(new TdpInverseImpl_Current())
 {
 }
@@ -188,11 +244,21 @@ std::string TdpInverse::public_key() const
     return tdp_inv_imp_->public_key();
 }
 
+std::string TdpInverse::public_key_binary() const
+{
+    return tdp_inv_imp_->public_key_binary();
+}
+
 std::string TdpInverse::private_key() const
 {
     return tdp_inv_imp_->private_key();
 }
 
+std::string TdpInverse::private_key_binary() const
+{
+    return tdp_inv_imp_->private_key_binary();
+}
+
 std::string TdpInverse::sample() const
 {
     return tdp_inv_imp_->sample();
@@ -227,6 +293,21 @@ std::array<uint8_t, TdpInverse::kMessageSize> TdpInverse::generate_array(
     return tdp_inv_imp_->generate_array(prf, seed);
 }
 
+void TdpInverse::sample_batch(
+    size_t                                          n,
+    std::vector<std::array<uint8_t, kMessageSize>>& out) const
+{
+    tdp_inv_imp_->sample_batch(n, out);
+}
+
+void TdpInverse::generate_batch(
+    const Prf<Tdp::kRSAPrfSize>&                    prf,
+    const std::vector<std::string>&                 seeds,
+    std::vector<std::array<uint8_t, kMessageSize>>& out) const
+{
+    tdp_inv_imp_->generate_batch(prf, seeds, out);
+}
+
 void TdpInverse::eval(const std::string& in, std::string& out) const
 {
     tdp_inv_imp_->eval(in, out);
@@ -246,6 +327,26 @@ std::array<uint8_t, TdpInverse::kMessageSize> TdpInverse::eval(
     return tdp_inv_imp_->eval(in);
 }
 
+void TdpInverse::eval(const std::array<uint8_t, kMessageSize>& in,
+                      std::array<uint8_t, kMessageSize>&       out) const
+{
+    tdp_inv_imp_->eval(in, out);
+}
+
+TdpChain TdpInverse::eval_chain(
+    const std::array<uint8_t, kMessageSize>& start) const
+{
+    return TdpChain(tdp_inv_imp_->eval_chain(start));
+}
+
+void TdpInverse::eval_batch(
+    const std::vector<std::array<uint8_t, kMessageSize>>& in,
+    std::vector<std::array<uint8_t, kMessageSize>>&       out,
+    unsigned int                                          n_threads) const
+{
+    tdp_inv_imp_->eval_batch(in, out, n_threads);
+}
+
 void TdpInverse::invert(const std::string& in, std::string& out) const
 {
     tdp_inv_imp_->invert(in, out);
@@ -265,6 +366,12 @@ std::array<uint8_t, TdpInverse::kMessageSize> TdpInverse::invert(
     return tdp_inv_imp_->invert(in);
 }
 
+void TdpInverse::invert(const std::array<uint8_t, kMessageSize>& in,
+                        std::array<uint8_t, kMessageSize>&       out) const
+{
+    tdp_inv_imp_->invert(in, out);
+}
+
 void TdpInverse::invert_mult(const std::string& in,
                              std::string&       out,
                              uint32_t           order) const
@@ -287,39 +394,63 @@ std::array<uint8_t, TdpInverse::kMessageSize> TdpInverse::invert_mult(
     return tdp_inv_imp_->invert_mult(in, order);
 }
 
-TdpMultPool::TdpMultPool(const std::string& pk, const uint8_t size)
-    : tdp_pool_imp_(new TdpMultPoolImpl_Current(pk, size))
+void TdpInverse::invert_mult(const std::array<uint8_t, kMessageSize>& in,
+                             std::array<uint8_t, kMessageSize>&       out,
+                             uint32_t order) const
 {
+    tdp_inv_imp_->invert_mult(in, out, order);
 }
 
-TdpMultPool::TdpMultPool(const TdpMultPool& pool)
-    : tdp_pool_imp_(new TdpMultPoolImpl_Current(
-          *dynamic_cast<const TdpMultPoolImpl_Current*>(pool.tdp_pool_imp_)))
+void TdpInverse::prewarm_invert_mult(uint32_t first_order,
+                                     uint32_t last_order) const
 {
+    tdp_inv_imp_->prewarm_invert_mult(first_order, last_order);
 }
 
-TdpMultPool& TdpMultPool::operator=(const TdpMultPool& t)
+TdpChain TdpInverse::invert_chain(
+    const std::array<uint8_t, kMessageSize>& start) const
 {
-    if ((this != &t) && (tdp_pool_imp_ != t.tdp_pool_imp_)) {
-        delete tdp_pool_imp_;
-        tdp_pool_imp_ = new TdpMultPoolImpl_Current(
-            *dynamic_cast<const TdpMultPoolImpl_Current*>(t.tdp_pool_imp_));
-    }
-    return *this;
+    return TdpChain(tdp_inv_imp_->invert_chain(start));
 }
 
+void TdpInverse::invert_batch(
+    const std::vector<std::array<uint8_t, kMessageSize>>& in,
+    std::vector<std::array<uint8_t, kMessageSize>>&       out,
+    unsigned int                                          n_threads) const
+{
+    tdp_inv_imp_->invert_batch(in, out, n_threads);
+}
 
-TdpMultPool::~TdpMultPool()
+void TdpInverse::invert_mult_batch(
+    const std::vector<std::array<uint8_t, kMessageSize>>& in,
+    std::vector<std::array<uint8_t, kMessageSize>>&       out,
+    uint32_t                                              order,
+    unsigned int                                          n_threads) const
 {
-    delete tdp_pool_imp_;
-    tdp_pool_imp_ = nullptr;
+    tdp_inv_imp_->invert_mult_batch(in, out, order, n_threads);
 }
 
+TdpMultPool::TdpMultPool(const std::string& pk, const uint8_t size)
+    : tdp_pool_imp_(new TdpMultPoolImpl_Current(pk, size))
+{
+}
+
+TdpMultPool::TdpMultPool(const TdpMultPool& pool) = default;
+
+TdpMultPool& TdpMultPool::operator=(const TdpMultPool& t) = default;
+
+TdpMultPool::~TdpMultPool() = default;
+
 std::string TdpMultPool::public_key() const
 {
     return tdp_pool_imp_->public_key();
 }
 
+std::string TdpMultPool::public_key_binary() const
+{
+    return tdp_pool_imp_->public_key_binary();
+}
+
 std::string TdpMultPool::sample() const
 {
     return tdp_pool_imp_->sample();
@@ -354,6 +485,21 @@ std::array<uint8_t, TdpMultPool::kMessageSize> TdpMultPool::generate_array(
     return tdp_pool_imp_->generate_array(prf, seed);
 }
 
+void TdpMultPool::sample_batch(
+    size_t                                          n,
+    std::vector<std::array<uint8_t, kMessageSize>>& out) const
+{
+    tdp_pool_imp_->sample_batch(n, out);
+}
+
+void TdpMultPool::generate_batch(
+    const Prf<Tdp::kRSAPrfSize>&                    prf,
+    const std::vector<std::string>&                 seeds,
+    std::vector<std::array<uint8_t, kMessageSize>>& out) const
+{
+    tdp_pool_imp_->generate_batch(prf, seeds, out);
+}
+
 void TdpMultPool::eval(const std::string& in,
                        std::string&       out,
                        uint8_t            order) const
@@ -378,13 +524,13 @@ std::array<uint8_t, Tdp::kMessageSize> TdpMultPool::eval(
 
 void TdpMultPool::eval(const std::string& in, std::string& out) const
 {
-    static_cast<TdpImpl*>(tdp_pool_imp_)->eval(in, out);
+    static_cast<const TdpImpl*>(tdp_pool_imp_.get())->eval(in, out);
 }
 
 std::string TdpMultPool::eval(const std::string& in) const
 {
     std::string out;
-    static_cast<TdpImpl*>(tdp_pool_imp_)->eval(in, out);
+    static_cast<const TdpImpl*>(tdp_pool_imp_.get())->eval(in, out);
 
     return out;
 }
@@ -392,7 +538,29 @@ std::string TdpMultPool::eval(const std::string& in) const
 std::array<uint8_t, Tdp::kMessageSize> TdpMultPool::eval(
     const std::array<uint8_t, kMessageSize>& in) const
 {
-    return static_cast<TdpImpl*>(tdp_pool_imp_)->eval(in);
+    return static_cast<const TdpImpl*>(tdp_pool_imp_.get())->eval(in);
+}
+
+void TdpMultPool::eval(const std::array<uint8_t, kMessageSize>& in,
+                       std::array<uint8_t, kMessageSize>&       out) const
+{
+    static_cast<const TdpImpl*>(tdp_pool_imp_.get())->eval(in, out);
+}
+
+TdpChain TdpMultPool::eval_chain(
+    const std::array<uint8_t, kMessageSize>& start) const
+{
+    return TdpChain(
+        static_cast<const TdpImpl*>(tdp_pool_imp_.get())->eval_chain(start));
+}
+
+void TdpMultPool::eval_batch(
+    const std::vector<std::array<uint8_t, kMessageSize>>& in,
+    std::vector<std::array<uint8_t, kMessageSize>>&       out,
+    unsigned int                                          n_threads) const
+{
+    static_cast<const TdpImpl*>(tdp_pool_imp_.get())
+        ->eval_batch(in, out, n_threads);
 }
 
 uint8_t TdpMultPool::maximum_order() const
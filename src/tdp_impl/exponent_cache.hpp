@@ -0,0 +1,124 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace sse {
+namespace crypto {
+
+/// @class ExponentCache
+/// @brief Bounded, thread-safe, LRU cache of values indexed by a TDP order.
+///
+/// It is used by the TDP backends to store the CRT exponents
+/// (d_p^order, d_q^order) used by invert_mult. The values are shared
+/// through std::shared_ptr so that a thread can keep using an entry while
+/// another thread evicts it. T's destructor is in charge of erasing the
+/// secret values it stores.
+///
+/// @tparam T   Type of the cached values
+///
+template<class T>
+class ExponentCache
+{
+public:
+    using value_ptr = std::shared_ptr<const T>;
+
+    explicit ExponentCache(const size_t capacity) : capacity_(capacity)
+    {
+    }
+
+    ExponentCache(const ExponentCache&) = delete;
+    ExponentCache& operator=(const ExponentCache&) = delete;
+
+    /// @brief Return the value associated to order, or nullptr if there
+    /// is none
+    value_ptr get(const uint32_t order) const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        auto it = index_.find(order);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        // mark the entry as the most recently used
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->second;
+    }
+
+    /// @brief Insert the value associated to order, evicting the least
+    /// recently used entry if the cache is full
+    void insert(const uint32_t order, value_ptr value) const
+    {
+        if (capacity_ == 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        auto it = index_.find(order);
+        if (it != index_.end()) {
+            // another thread already inserted the value
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+
+        if (entries_.size() >= capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(order, std::move(value));
+        index_[order] = entries_.begin();
+    }
+
+    /// @brief Number of entries currently in the cache
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return entries_.size();
+    }
+
+    /// @brief Maximum number of entries in the cache
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    using entry_list = std::list<std::pair<uint32_t, value_ptr>>;
+
+    const size_t capacity_;
+
+    mutable std::mutex                                              mtx_;
+    mutable entry_list                                              entries_;
+    mutable std::unordered_map<uint32_t, typename entry_list::iterator> index_;
+};
+
+} // namespace crypto
+} // namespace sse
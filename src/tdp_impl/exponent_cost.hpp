@@ -0,0 +1,134 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+namespace sse {
+namespace crypto {
+
+/// @brief Maximum size (in bits) of the exponents for which the TDP backends
+/// use a plain square-and-multiply instead of a sliding window
+constexpr size_t kShortExponentBits = 23;
+
+/// @brief Cost of a modular multiplication, relative to a modular squaring
+///
+/// Both backends have a dedicated squaring routine. The value was measured
+/// with 2048 bits moduli.
+constexpr double kModMultiplicationCost = 1.3;
+
+/// @struct ModExpCost
+/// @brief Number of modular operations of an exponentiation
+struct ModExpCost
+{
+    size_t squarings{0};
+    size_t multiplications{0};
+
+    /// @brief Estimated cost, in modular squarings
+    double total() const
+    {
+        return static_cast<double>(squarings)
+               + kModMultiplicationCost * static_cast<double>(multiplications);
+    }
+};
+
+/// @brief Count the modular operations of x^e mod n, as computed by the TDP
+/// backends: square-and-multiply for short exponents, and sliding window
+/// (HAC 14.85, with the same window sizes as mbedTLS and OpenSSL) otherwise.
+///
+/// @param e    The exponent, as a big endian byte array
+inline ModExpCost mod_exp_cost(const std::vector<uint8_t>& e)
+{
+    ModExpCost cost;
+
+    const size_t n_bits = 8 * e.size();
+    auto         bit    = [&e, n_bits](size_t i) -> bool {
+        return ((e[(n_bits - 1 - i) / 8] >> (i % 8)) & 1) != 0;
+    };
+
+    size_t bit_len = n_bits;
+    while (bit_len > 0 && !bit(bit_len - 1)) {
+        bit_len--;
+    }
+    if (bit_len == 0) {
+        return cost;
+    }
+
+    if (bit_len <= kShortExponentBits) {
+        for (size_t i = 0; i + 1 < bit_len; i++) {
+            cost.squarings++;
+            cost.multiplications += bit(i) ? 1 : 0;
+        }
+        return cost;
+    }
+
+    const size_t w = (bit_len > 671) ? 6
+                     : (bit_len > 239) ? 5
+                     : (bit_len > 79) ? 4
+                                      : 3;
+
+    // precomputation of the odd powers of x in the window table
+    cost.squarings += w - 1;
+    cost.multiplications += (size_t(1) << (w - 1)) - 1;
+
+    // scan the exponent from the most significant bit
+    size_t i = bit_len;
+    while (i > 0) {
+        if (!bit(i - 1)) {
+            cost.squarings++;
+            i--;
+            continue;
+        }
+        // the longest window of at most w bits starting at bit i-1 and
+        // ending with a 1
+        size_t j = (i > w) ? i - w : 0;
+        while (!bit(j)) {
+            j++;
+        }
+        cost.squarings += i - j;
+        cost.multiplications++;
+        i = j;
+    }
+
+    return cost;
+}
+
+/// @brief Decide if the TDP of exponent e is faster evaluated at a given
+/// order as order successive exponentiations by e, rather than as a single
+/// exponentiation by e_order = e^order
+///
+/// @param e        The exponent, as a big endian byte array
+/// @param e_order  e^order, as a big endian byte array
+/// @param order    The evaluation order
+inline bool chained_eval_is_faster(const std::vector<uint8_t>& e,
+                                   const std::vector<uint8_t>& e_order,
+                                   unsigned                    order)
+{
+    return static_cast<double>(order) * mod_exp_cost(e).total()
+           < mod_exp_cost(e_order).total();
+}
+
+} // namespace crypto
+} // namespace sse
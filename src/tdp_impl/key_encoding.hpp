@@ -0,0 +1,207 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <sse/crypto/tdp.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <sodium/utils.h>
+
+namespace sse {
+namespace crypto {
+
+/// @namespace binary_key
+/// @brief Raw binary encoding of the TDP keys.
+///
+/// Contrary to the PEM encoding, there is no base64 or ASN.1 parsing: the
+/// integers are stored as fixed-width big endian fields, at fixed offsets.
+/// The encoding also stores R^2 mod m (R being the Montgomery radix) for
+/// the moduli used by the TDP, so that the mbedTLS backend can set up its
+/// Montgomery contexts without a long division. The OpenSSL backend ignores
+/// these fields: BN_MONT_CTX_set always recomputes R^2 mod m.
+///
+/// Public key:  header | N | E | R^2 mod N
+/// Private key: public key | D | P | Q | DP | DQ | QP | R^2 mod P | R^2 mod Q
+///
+/// where header is the 6 bytes magic string "SSETDP", followed by a version
+/// byte and a key type byte. N, E, D and R^2 mod N are kModulusSize bytes
+/// long, the other fields are kPrimeSize bytes long.
+namespace binary_key {
+
+constexpr char    kMagic[]   = {'S', 'S', 'E', 'T', 'D', 'P'};
+constexpr size_t  kMagicSize = sizeof(kMagic);
+constexpr uint8_t kVersion   = 1;
+
+constexpr uint8_t kPublicKeyType  = 1;
+constexpr uint8_t kPrivateKeyType = 2;
+
+constexpr size_t kHeaderSize  = kMagicSize + 2;
+constexpr size_t kModulusSize = Tdp::kMessageSize;
+constexpr size_t kPrimeSize   = kModulusSize / 2;
+
+constexpr size_t kPublicKeySize = kHeaderSize + 3 * kModulusSize;
+constexpr size_t kPrivateKeySize
+    = kPublicKeySize + kModulusSize + 7 * kPrimeSize;
+
+/// @brief Check if key starts with the header of a binary key of the given
+/// type
+inline bool has_header(const std::string& key, const uint8_t type)
+{
+    return key.size() >= kHeaderSize
+           && memcmp(key.data(), kMagic, kMagicSize) == 0
+           && static_cast<uint8_t>(key[kMagicSize + 1]) == type;
+}
+
+/// @class Reader
+/// @brief Sequential reader of the fields of a binary key.
+class Reader
+{
+public:
+    /// @exception std::runtime_error   key is not a binary key of the given
+    ///                                 type and version
+    Reader(const std::string& key, const uint8_t type)
+        : data_(reinterpret_cast<const uint8_t*>(key.data())),
+          size_(key.size()), pos_(kHeaderSize)
+    {
+        const size_t expected_size
+            = (type == kPublicKeyType) ? kPublicKeySize : kPrivateKeySize;
+
+        if (!has_header(key, type)
+            || static_cast<uint8_t>(key[kMagicSize]) != kVersion
+            || size_ != expected_size) {
+            throw std::runtime_error("Invalid binary TDP key");
+        }
+    }
+
+    /// @brief Return a pointer to the next field, of length size
+    const uint8_t* next(const size_t size)
+    {
+        if (size > size_ - pos_) {
+            throw std::runtime_error(
+                "Truncated binary TDP key"); /* LCOV_EXCL_LINE */
+        }
+        const uint8_t* field = data_ + pos_;
+        pos_ += size;
+        return field;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t         size_;
+    size_t         pos_;
+};
+
+/// @class Writer
+/// @brief Sequential writer of the fields of a binary key.
+class Writer
+{
+public:
+    explicit Writer(const uint8_t type)
+        : key_(type == kPublicKeyType ? kPublicKeySize : kPrivateKeySize,
+               '\0'),
+          pos_(kHeaderSize)
+    {
+        memcpy(&key_[0], kMagic, kMagicSize);
+        key_[kMagicSize]     = static_cast<char>(kVersion);
+        key_[kMagicSize + 1] = static_cast<char>(type);
+    }
+
+    /// @brief Return a pointer to the next field, of length size, to be
+    /// filled by the caller
+    uint8_t* next(const size_t size)
+    {
+        if (size > key_.size() - pos_) {
+            throw std::runtime_error(
+                "Binary TDP key overflow"); /* LCOV_EXCL_LINE */
+        }
+        uint8_t* field = reinterpret_cast<uint8_t*>(&key_[pos_]);
+        pos_ += size;
+        return field;
+    }
+
+    /// @brief Get the encoded key. The writer is empty after the call.
+    std::string release()
+    {
+        return std::move(key_);
+    }
+
+private:
+    std::string key_;
+    size_t      pos_;
+};
+
+} // namespace binary_key
+
+/// @class SerializedKeyCache
+/// @brief Lazily computed serialization of a key.
+///
+/// The serialization is computed on the first call to get(), and shared by
+/// the copies of the cache (the keys of the TDP objects are never
+/// modified). It can be used concurrently by several threads: at worst, the
+/// serialization is computed several times. The string is erased on
+/// destruction, as it might hold a private key.
+class SerializedKeyCache
+{
+public:
+    SerializedKeyCache() = default;
+
+    SerializedKeyCache(const SerializedKeyCache& c)
+        : value_(std::atomic_load(&c.value_))
+    {
+    }
+
+    SerializedKeyCache& operator=(const SerializedKeyCache& c)
+    {
+        std::atomic_store(&value_, std::atomic_load(&c.value_));
+        return *this;
+    }
+
+    template<class F>
+    std::string get(F&& serialize) const
+    {
+        std::shared_ptr<const std::string> v = std::atomic_load(&value_);
+        if (!v) {
+            v = std::shared_ptr<const std::string>(
+                new std::string(serialize()), [](const std::string* s) {
+                    sodium_memzero(const_cast<char*>(s->data()), s->size());
+                    delete s;
+                });
+            std::atomic_store(&value_, v);
+        }
+        return *v;
+    }
+
+private:
+    mutable std::shared_ptr<const std::string> value_;
+};
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,391 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "multi_buffer_mod_exp.hpp"
+
+#include "mbedtls/bignum.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SSE_CRYPTO_MB_IFMA 1
+#include <immintrin.h>
+#define SSE_CRYPTO_IFMA_TARGET                                                 \
+    __attribute__((target("avx512f,avx512ifma")))
+#endif
+
+namespace sse {
+namespace crypto {
+
+constexpr size_t MultiBufferModExp::kLanes;
+constexpr size_t MultiBufferModExp::kModulusSize;
+constexpr size_t MultiBufferModExp::kMinMessages;
+constexpr size_t MultiBufferModExp::kLimbs;
+
+namespace {
+
+constexpr size_t   kLimbs  = MultiBufferModExp::kLimbs;
+constexpr size_t   kLanes  = MultiBufferModExp::kLanes;
+constexpr size_t   kWords  = MultiBufferModExp::kModulusSize / 8;
+constexpr uint64_t kMask52 = (1ULL << 52) - 1;
+
+static_assert(52 * kLimbs >= 8 * MultiBufferModExp::kModulusSize + 2,
+              "R = 2^(52*kLimbs) must be larger than 4N");
+
+// big endian bytes to little endian 64 bits words
+void bytes_to_words(const uint8_t* in, uint64_t* w)
+{
+    for (size_t i = 0; i < kWords; i++) {
+        uint64_t v = 0;
+        for (size_t j = 0; j < 8; j++) {
+            v = (v << 8) | in[MultiBufferModExp::kModulusSize - 8 * (i + 1) + j];
+        }
+        w[i] = v;
+    }
+}
+
+// little endian 64 bits words to big endian bytes
+void words_to_bytes(const uint64_t* w, uint8_t* out)
+{
+    for (size_t i = 0; i < kWords; i++) {
+        uint64_t v = w[i];
+        for (size_t j = 0; j < 8; j++) {
+            out[MultiBufferModExp::kModulusSize - 8 * i - 1 - j]
+                = static_cast<uint8_t>(v & 0xFF);
+            v >>= 8;
+        }
+    }
+}
+
+// radix 2^64 to radix 2^52
+void words_to_limbs(const uint64_t* w, uint64_t* limbs)
+{
+    for (size_t k = 0; k < kLimbs; k++) {
+        const size_t bit  = 52 * k;
+        const size_t word = bit / 64;
+        const size_t off  = bit % 64;
+
+        uint64_t v = (word < kWords) ? (w[word] >> off) : 0;
+        if (off > 12 && word + 1 < kWords) {
+            v |= w[word + 1] << (64 - off);
+        }
+        limbs[k] = v & kMask52;
+    }
+}
+
+// radix 2^52 to radix 2^64. The value must fit in kWords words.
+void limbs_to_words(const uint64_t* limbs, uint64_t* w)
+{
+    std::memset(w, 0, kWords * sizeof(uint64_t));
+
+    for (size_t k = 0; k < kLimbs; k++) {
+        const size_t bit  = 52 * k;
+        const size_t word = bit / 64;
+        const size_t off  = bit % 64;
+
+        if (word < kWords) {
+            w[word] |= limbs[k] << off;
+        }
+        if (off > 12 && word + 1 < kWords) {
+            w[word + 1] |= limbs[k] >> (64 - off);
+        }
+    }
+}
+
+// w = w - n if w >= n
+void conditional_subtract(uint64_t* w, const uint64_t* n)
+{
+    size_t i = kWords;
+    while (i > 0 && w[i - 1] == n[i - 1]) {
+        i--;
+    }
+    if (i > 0 && w[i - 1] < n[i - 1]) {
+        return; // w < n
+    }
+
+    uint64_t borrow = 0;
+    for (size_t j = 0; j < kWords; j++) {
+        const uint64_t d  = w[j] - n[j];
+        const uint64_t b1 = (w[j] < n[j]) ? 1 : 0;
+        const uint64_t r  = d - borrow;
+        const uint64_t b2 = (d < borrow) ? 1 : 0;
+        w[j]              = r;
+        borrow            = b1 | b2;
+    }
+}
+
+#ifdef SSE_CRYPTO_MB_IFMA
+
+// Some versions of GCC warn about the use of _mm512_undefined_epi32 in the
+// implementation of the AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+// Almost Montgomery Multiplication, lane by lane: r = a * b / R mod N, with
+// R = 2^(52*kLimbs).
+// The limbs of a and b must be smaller than 2^52 (IFMA only uses the 52 low
+// bits of its operands). If a, b < 2N, then r < 2N (because R > 4N), and the
+// limbs of r are normalized. r can alias a or b.
+SSE_CRYPTO_IFMA_TARGET
+void amm(__m512i*        r,
+         const __m512i*  a,
+         const __m512i*  b,
+         const uint64_t* n,
+         const __m512i   k0)
+{
+    // the accumulator is never shifted: during the i-th iteration, the
+    // limb j of the partial result is in t[i + j]
+    __m512i       t[2 * kLimbs + 1];
+    const __m512i zero = _mm512_setzero_si512();
+
+    for (size_t j = 0; j < 2 * kLimbs + 1; j++) {
+        t[j] = zero;
+    }
+
+    // Each t[k] receives at most 4 products of 52 bits per iteration, for at
+    // most kLimbs + 1 iterations: no overflow can happen (4 * 41 < 2^12)
+    for (size_t i = 0; i < kLimbs; i++) {
+        __m512i*      ti = t + i;
+        const __m512i bi = b[i];
+
+        for (size_t j = 0; j < kLimbs; j++) {
+            ti[j]     = _mm512_madd52lo_epu64(ti[j], a[j], bi);
+            ti[j + 1] = _mm512_madd52hi_epu64(ti[j + 1], a[j], bi);
+        }
+
+        // m = t_i * (-N^-1) mod 2^52
+        const __m512i m = _mm512_madd52lo_epu64(zero, ti[0], k0);
+
+        for (size_t j = 0; j < kLimbs; j++) {
+            const __m512i nj = _mm512_set1_epi64(static_cast<long long>(n[j]));
+            ti[j]            = _mm512_madd52lo_epu64(ti[j], nj, m);
+            ti[j + 1]        = _mm512_madd52hi_epu64(ti[j + 1], nj, m);
+        }
+
+        // the 52 low bits of t_i are now 0: propagate the carry
+        ti[1] = _mm512_add_epi64(ti[1], _mm512_srli_epi64(ti[0], 52));
+    }
+
+    // normalize the limbs
+    const __m512i mask  = _mm512_set1_epi64(static_cast<long long>(kMask52));
+    __m512i       carry = zero;
+    for (size_t j = 0; j < kLimbs; j++) {
+        const __m512i v = _mm512_add_epi64(t[kLimbs + j], carry);
+        r[j]            = _mm512_and_si512(v, mask);
+        carry           = _mm512_srli_epi64(v, 52);
+    }
+}
+
+// out = in^e mod N (lane by lane), in radix 2^52 with the lanes interleaved:
+// limbs[j * kLanes + l] is the j-th limb of the l-th message.
+// The result is in [0, N].
+SSE_CRYPTO_IFMA_TARGET
+void mod_exp_ifma(const uint64_t*             in,
+                  uint64_t*                   out,
+                  const std::vector<uint8_t>& e,
+                  const uint64_t*             n,
+                  const uint64_t*             rr,
+                  uint64_t                    k0)
+{
+    __m512i x[kLimbs], acc[kLimbs], tmp[kLimbs];
+
+    const __m512i k0_v = _mm512_set1_epi64(static_cast<long long>(k0));
+
+    for (size_t j = 0; j < kLimbs; j++) {
+        acc[j] = _mm512_loadu_si512(in + j * kLanes);
+        tmp[j] = _mm512_set1_epi64(static_cast<long long>(rr[j]));
+    }
+
+    // to the Montgomery form: x = in * R^2 / R
+    amm(x, acc, tmp, n, k0_v);
+
+    // skip the leading zero bits of e
+    size_t bit_count = 8 * e.size();
+    size_t pos       = 0;
+    while (pos < bit_count && ((e[pos / 8] >> (7 - pos % 8)) & 1) == 0) {
+        pos++;
+    }
+
+    if (pos == bit_count) {
+        // e == 0: the result is 1
+        for (size_t j = 0; j < kLimbs; j++) {
+            _mm512_storeu_si512(out + j * kLanes, _mm512_setzero_si512());
+        }
+        for (size_t l = 0; l < kLanes; l++) {
+            out[l] = 1;
+        }
+        return;
+    }
+
+    // left-to-right square and multiply
+    for (size_t j = 0; j < kLimbs; j++) {
+        acc[j] = x[j];
+    }
+    for (pos++; pos < bit_count; pos++) {
+        amm(acc, acc, acc, n, k0_v);
+        if (((e[pos / 8] >> (7 - pos % 8)) & 1) != 0) {
+            amm(acc, acc, x, n, k0_v);
+        }
+    }
+
+    // out of the Montgomery form: multiply by 1
+    for (size_t j = 0; j < kLimbs; j++) {
+        tmp[j] = _mm512_setzero_si512();
+    }
+    tmp[0] = _mm512_set1_epi64(1);
+    amm(acc, acc, tmp, n, k0_v);
+
+    for (size_t j = 0; j < kLimbs; j++) {
+        _mm512_storeu_si512(out + j * kLanes, acc[j]);
+    }
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+} // namespace
+
+bool MultiBufferModExp::is_available()
+{
+#ifdef SSE_CRYPTO_MB_IFMA
+    static const bool available = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f")
+               && __builtin_cpu_supports("avx512ifma");
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+MultiBufferModExp::MultiBufferModExp(const message_type& modulus)
+{
+    if (!is_available()) {
+        throw std::runtime_error(
+            "The multi-buffer modular exponentiation is not supported by this "
+            "CPU");
+    }
+
+    bytes_to_words(modulus.data(), n_words_.data());
+
+    if ((n_words_[0] & 1) == 0) {
+        throw std::invalid_argument(
+            "Invalid modulus for the multi-buffer modular exponentiation: "
+            "the modulus must be odd");
+    }
+
+    words_to_limbs(n_words_.data(), n_.data());
+
+    // -N^-1 mod 2^64 using Newton's iteration (each iteration doubles the
+    // number of correct bits, and N*N = 1 mod 8)
+    uint64_t inv = n_words_[0];
+    for (size_t i = 0; i < 5; i++) {
+        inv *= 2 - n_words_[0] * inv;
+    }
+    k0_ = (0 - inv) & kMask52;
+
+    // R^2 mod N = 2^(2*52*kLimbs) mod N
+    mbedtls_mpi N, RR;
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&RR);
+
+    message_type rr_bytes;
+    int          ret;
+
+    MBEDTLS_MPI_CHK(
+        mbedtls_mpi_read_binary(&N, modulus.data(), modulus.size()));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&RR, 1));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_shift_l(&RR, 2 * 52 * kLimbs));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&RR, &RR, &N));
+    MBEDTLS_MPI_CHK(
+        mbedtls_mpi_write_binary(&RR, rr_bytes.data(), rr_bytes.size()));
+
+    // cppcheck does not see the use of goto cleanup in the MBEDTLS_MPI_CHK
+    // macros
+// cppcheck-suppress unusedLabel
+cleanup:
+    mbedtls_mpi_free(&N);
+    mbedtls_mpi_free(&RR);
+
+    if (ret != 0) {
+        throw std::runtime_error(
+            "Unable to compute R^2 mod N"); /* LCOV_EXCL_LINE */
+    }
+
+    std::array<uint64_t, kWords> rr_words;
+    bytes_to_words(rr_bytes.data(), rr_words.data());
+    words_to_limbs(rr_words.data(), rr_.data());
+}
+
+void MultiBufferModExp::mod_exp(const message_type*         in,
+                                message_type*               out,
+                                size_t                      count,
+                                const std::vector<uint8_t>& e) const
+{
+#ifdef SSE_CRYPTO_MB_IFMA
+    alignas(64) uint64_t lanes_in[kLimbs * kLanes];
+    alignas(64) uint64_t lanes_out[kLimbs * kLanes];
+
+    std::array<uint64_t, kWords>  words;
+    std::array<uint64_t, kLimbs> limbs;
+
+    for (size_t first = 0; first < count; first += kLanes) {
+        const size_t n_msg = std::min(kLanes, count - first);
+
+        std::memset(lanes_in, 0, sizeof(lanes_in));
+        for (size_t l = 0; l < n_msg; l++) {
+            bytes_to_words(in[first + l].data(), words.data());
+            words_to_limbs(words.data(), limbs.data());
+            for (size_t j = 0; j < kLimbs; j++) {
+                lanes_in[j * kLanes + l] = limbs[j];
+            }
+        }
+
+        mod_exp_ifma(lanes_in, lanes_out, e, n_.data(), rr_.data(), k0_);
+
+        for (size_t l = 0; l < n_msg; l++) {
+            for (size_t j = 0; j < kLimbs; j++) {
+                limbs[j] = lanes_out[j * kLanes + l];
+            }
+            limbs_to_words(limbs.data(), words.data());
+            // the result of the exponentiation is in [0, N]
+            conditional_subtract(words.data(), n_words_.data());
+            words_to_bytes(words.data(), out[first + l].data());
+        }
+    }
+#else
+    (void)in;
+    (void)out;
+    (void)count;
+    (void)e;
+    throw std::runtime_error(
+        "The multi-buffer modular exponentiation is not supported by this "
+        "CPU"); /* LCOV_EXCL_LINE */
+#endif
+}
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,95 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <vector>
+
+namespace sse {
+namespace crypto {
+
+/// @class MultiBufferModExp
+/// @brief Multi-buffer modular exponentiation for 2048 bits moduli.
+///
+/// Computes \f$ x_i^e \bmod N\f$ for up to kLanes messages at once, with the
+/// same modulus N and public exponent e. The messages are processed in the
+/// lanes of AVX-512 registers, in radix \f$ 2^{52}\f$, using the IFMA52
+/// instructions. The exponentiation is NOT constant time: it must only be
+/// used with public exponents.
+///
+/// The vectorized code is only available on CPUs supporting AVX-512 IFMA
+/// (see is_available()). The TDP backends fall back to their scalar
+/// implementations otherwise.
+///
+class MultiBufferModExp
+{
+public:
+    /// @brief Number of messages processed in parallel
+    static constexpr size_t kLanes = 8;
+    /// @brief Size (in bytes) of the modulus and of the messages
+    static constexpr size_t kModulusSize = 256;
+    /// @brief Minimum number of messages for which the multi-buffer code is
+    /// faster than the scalar implementations
+    static constexpr size_t kMinMessages = 2;
+
+    using message_type = std::array<uint8_t, kModulusSize>;
+
+    /// @brief Returns true if the CPU supports the vectorized implementation
+    static bool is_available();
+
+    /// @brief Constructor
+    ///
+    /// @param modulus  The odd modulus, big endian encoded
+    ///
+    /// @exception std::invalid_argument    The modulus is even or zero
+    /// @exception std::runtime_error       The CPU does not support the
+    ///                                     implementation
+    ///
+    explicit MultiBufferModExp(const message_type& modulus);
+
+    /// @brief Compute out[i] = in[i]^e mod N for 0 <= i < count
+    ///
+    /// @param in       The input messages, big endian encoded
+    /// @param out      The output messages, big endian encoded. out can be
+    ///                 equal to in.
+    /// @param count    The number of messages
+    /// @param e        The public exponent, big endian encoded
+    ///
+    void mod_exp(const message_type*         in,
+                 message_type*               out,
+                 size_t                      count,
+                 const std::vector<uint8_t>& e) const;
+
+    /// @brief Number of 52 bits limbs of the internal representation
+    static constexpr size_t kLimbs = 40;
+
+private:
+    std::array<uint64_t, kLimbs> n_;  // N in radix 2^52
+    std::array<uint64_t, kLimbs> rr_; // R^2 mod N, with R = 2^(52*kLimbs)
+    std::array<uint64_t, kModulusSize / 8> n_words_; // N in radix 2^64
+    uint64_t                                k0_;      // -N^-1 mod 2^52
+};
+
+} // namespace crypto
+} // namespace sse
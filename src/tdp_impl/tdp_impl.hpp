@@ -21,17 +21,41 @@
 
 #pragma once
 
+#include "thread_pool.hpp"
+
 #include <sse/crypto/key.hpp>
 #include <sse/crypto/prf.hpp>
+#include <sse/crypto/random.hpp>
 #include <sse/crypto/tdp.hpp>
 
 #include <cstdint>
 
 #include <array>
 #include <string>
+#include <vector>
+
+#include <sodium/utils.h>
 
 namespace sse {
 namespace crypto {
+
+class TdpChainImpl
+{
+public:
+    static constexpr uint kMessageSpaceSize = Tdp::kMessageSize;
+
+    virtual ~TdpChainImpl() = default;
+
+    virtual void advance(uint32_t steps)                                = 0;
+    virtual void value(std::array<uint8_t, kMessageSpaceSize>& out) const = 0;
+
+    void next(std::array<uint8_t, kMessageSpaceSize>& out)
+    {
+        advance(1);
+        value(out);
+    }
+};
+
 class TdpImpl
 {
 public:
@@ -42,11 +66,30 @@ public:
 
     virtual size_t rsa_size() const = 0;
 
-    virtual std::string public_key() const = 0;
+    virtual std::string public_key() const        = 0;
+    virtual std::string public_key_binary() const = 0;
 
     virtual void eval(const std::string& in, std::string& out) const = 0;
     virtual std::array<uint8_t, kMessageSpaceSize> eval(
         const std::array<uint8_t, kMessageSpaceSize>& in) const = 0;
+    virtual void eval(const std::array<uint8_t, kMessageSpaceSize>& in,
+                      std::array<uint8_t, kMessageSpaceSize>& out) const = 0;
+    virtual TdpChainImpl* eval_chain(
+        const std::array<uint8_t, kMessageSpaceSize>& start) const = 0;
+
+    // Evaluate the TDP on all the elements of in, using n_threads threads (0
+    // for one thread per core). in and out can be the same vector.
+    void eval_batch(
+        const std::vector<std::array<uint8_t, kMessageSpaceSize>>& in,
+        std::vector<std::array<uint8_t, kMessageSpaceSize>>&       out,
+        unsigned int n_threads) const
+    {
+        out.resize(in.size());
+        parallel_for(
+            in.size(), n_threads, [this, &in, &out](size_t begin, size_t end) {
+                eval_range(in.data() + begin, out.data() + begin, end - begin);
+            });
+    }
 
     virtual std::string                            sample() const       = 0;
     virtual std::array<uint8_t, kMessageSpaceSize> sample_array() const = 0;
@@ -61,6 +104,57 @@ public:
     virtual std::array<uint8_t, kMessageSpaceSize> generate_array(
         Key<Prf<Tdp::kRSAPrfSize>::kKeySize>&& key,
         const std::string&                     seed) const = 0;
+
+    // Generate a message for every seed: the PRF is evaluated on all the
+    // seeds at once, and the outputs are reduced with the same context.
+    void generate_batch(
+        const Prf<Tdp::kRSAPrfSize>&                         prg,
+        const std::vector<std::string>&                      seeds,
+        std::vector<std::array<uint8_t, kMessageSpaceSize>>& out) const
+    {
+        std::vector<std::array<uint8_t, Tdp::kRSAPrfSize>> rnd;
+
+        prg.prf_batch(seeds, rnd);
+        out.resize(rnd.size());
+        reduce_range(rnd.data(), out.data(), rnd.size());
+
+        sodium_memzero(rnd.data(), rnd.size() * Tdp::kRSAPrfSize);
+    }
+
+    // Sample n random messages, from a single read of the RNG
+    void sample_batch(
+        size_t                                               n,
+        std::vector<std::array<uint8_t, kMessageSpaceSize>>& out) const
+    {
+        std::vector<std::array<uint8_t, Tdp::kRSAPrfSize>> rnd(n);
+
+        random_bytes(n * Tdp::kRSAPrfSize,
+                     reinterpret_cast<unsigned char*>(rnd.data()));
+        out.resize(n);
+        reduce_range(rnd.data(), out.data(), n);
+
+        sodium_memzero(rnd.data(), n * Tdp::kRSAPrfSize);
+    }
+
+protected:
+    // Reduce the count kRSAPrfSize bytes integers of in modulo N, and write
+    // the results to out. The bias of the results is negligible
+    // (kStatisticalSecurity bits).
+    virtual void reduce_range(const std::array<uint8_t, Tdp::kRSAPrfSize>* in,
+                              std::array<uint8_t, kMessageSpaceSize>*      out,
+                              size_t count) const = 0;
+
+    // Evaluate the TDP on the count messages of in, and write the results to
+    // out (in and out can be equal). Used by eval_batch: the backends can
+    // override it to process several messages at once.
+    virtual void eval_range(const std::array<uint8_t, kMessageSpaceSize>* in,
+                            std::array<uint8_t, kMessageSpaceSize>*       out,
+                            size_t count) const
+    {
+        for (size_t i = 0; i < count; i++) {
+            eval(in[i], out[i]);
+        }
+    }
 };
 
 class TdpInverseImpl : virtual public TdpImpl
@@ -70,9 +164,12 @@ public:
     ;
 
     virtual std::string private_key() const                            = 0;
+    virtual std::string private_key_binary() const                     = 0;
     virtual void invert(const std::string& in, std::string& out) const = 0;
     virtual std::array<uint8_t, kMessageSpaceSize> invert(
         const std::array<uint8_t, kMessageSpaceSize>& in) const = 0;
+    virtual void invert(const std::array<uint8_t, kMessageSpaceSize>& in,
+                        std::array<uint8_t, kMessageSpaceSize>& out) const = 0;
 
     virtual std::array<uint8_t, kMessageSpaceSize> invert_mult(
         const std::array<uint8_t, kMessageSpaceSize>& in,
@@ -80,6 +177,49 @@ public:
     virtual void invert_mult(const std::string& in,
                              std::string&       out,
                              uint32_t           order) const = 0;
+    virtual void invert_mult(const std::array<uint8_t, kMessageSpaceSize>& in,
+                             std::array<uint8_t, kMessageSpaceSize>&       out,
+                             uint32_t order) const = 0;
+
+    virtual void prewarm_invert_mult(uint32_t first_order,
+                                     uint32_t last_order) const = 0;
+
+    virtual TdpChainImpl* invert_chain(
+        const std::array<uint8_t, kMessageSpaceSize>& start) const = 0;
+
+    void invert_batch(
+        const std::vector<std::array<uint8_t, kMessageSpaceSize>>& in,
+        std::vector<std::array<uint8_t, kMessageSpaceSize>>&       out,
+        unsigned int n_threads) const
+    {
+        out.resize(in.size());
+        parallel_for(
+            in.size(), n_threads, [this, &in, &out](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    invert(in[i], out[i]);
+                }
+            });
+    }
+
+    void invert_mult_batch(
+        const std::vector<std::array<uint8_t, kMessageSpaceSize>>& in,
+        std::vector<std::array<uint8_t, kMessageSpaceSize>>&       out,
+        uint32_t                                                   order,
+        unsigned int n_threads) const
+    {
+        // compute the CRT exponents once, before fanning out
+        if (order != 0) {
+            prewarm_invert_mult(order, order);
+        }
+        out.resize(in.size());
+        parallel_for(in.size(),
+                     n_threads,
+                     [this, &in, &out, order](size_t begin, size_t end) {
+                         for (size_t i = begin; i < end; i++) {
+                             invert_mult(in[i], out[i], order);
+                         }
+                     });
+    }
 };
 
 class TdpMultPoolImpl : virtual public TdpImpl
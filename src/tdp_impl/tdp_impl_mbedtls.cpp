@@ -23,6 +23,7 @@
 #include "mbedtls/bignum.h"
 #include "mbedtls/rsa.h"
 #include "mbedtls/rsa_io.h"
+#include "exponent_cost.hpp"
 #include "prf.hpp"
 #include "random.hpp"
 
@@ -31,6 +32,10 @@
 #include <exception>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <sodium/utils.h>
 
@@ -62,6 +67,443 @@ static void zeroize_rsa(mbedtls_rsa_context* rsa)
     mbedtls_mpi_lset(&rsa->Vf, 0);
 }
 
+static std::shared_ptr<const mbedtls_mpi_mont_ctx> make_mont_ctx(
+    const mbedtls_mpi& N)
+{
+    auto* ctx = new mbedtls_mpi_mont_ctx;
+    mbedtls_mpi_mont_init(ctx);
+
+    if (mbedtls_mpi_mont_setup(ctx, &N) != 0) {
+        /* LCOV_EXCL_START */
+        mbedtls_mpi_mont_free(ctx);
+        delete ctx;
+        throw std::runtime_error("Unable to setup a Montgomery context");
+        /* LCOV_EXCL_STOP */
+    }
+
+    return std::shared_ptr<const mbedtls_mpi_mont_ctx>(
+        ctx, [](const mbedtls_mpi_mont_ctx* c) {
+            auto* m = const_cast<mbedtls_mpi_mont_ctx*>(c);
+            mbedtls_mpi_mont_free(m);
+            delete m;
+        });
+}
+
+// Montgomery context for N, using a precomputed value of R^2 mod N. If RR
+// turns out to be invalid, the context is set up from scratch.
+static std::shared_ptr<const mbedtls_mpi_mont_ctx> make_mont_ctx(
+    const mbedtls_mpi& N,
+    const mbedtls_mpi& RR)
+{
+    auto* ctx = new mbedtls_mpi_mont_ctx;
+    mbedtls_mpi_mont_init(ctx);
+
+    if (mbedtls_mpi_mont_setup_rr(ctx, &N, &RR) != 0) {
+        mbedtls_mpi_mont_free(ctx);
+        delete ctx;
+        return make_mont_ctx(N);
+    }
+
+    return std::shared_ptr<const mbedtls_mpi_mont_ctx>(
+        ctx, [](const mbedtls_mpi_mont_ctx* c) {
+            auto* m = const_cast<mbedtls_mpi_mont_ctx*>(c);
+            mbedtls_mpi_mont_free(m);
+            delete m;
+        });
+}
+
+static_assert(std::is_same<MultiBufferModExp::message_type,
+                           std::array<uint8_t, TdpImpl::kMessageSpaceSize>>::value,
+              "The multi-buffer exponentiation and the TDP message types do "
+              "not match");
+
+static_assert(kShortExponentBits == MBEDTLS_MPI_SHORT_EXP_BITS,
+              "The exponentiation cost model does not match mbedTLS");
+
+// Returns nullptr if the multi-buffer exponentiation cannot be used
+static std::shared_ptr<const MultiBufferModExp> make_mb_exp(
+    const mbedtls_mpi& N)
+{
+    if (!MultiBufferModExp::is_available()
+        || mbedtls_mpi_size(&N) != MultiBufferModExp::kModulusSize) {
+        return nullptr;
+    }
+
+    MultiBufferModExp::message_type modulus;
+    if (mbedtls_mpi_write_binary(&N, modulus.data(), modulus.size()) != 0) {
+        throw std::runtime_error(
+            "Unable to write the RSA modulus"); /* LCOV_EXCL_LINE */
+    }
+
+    return std::make_shared<const MultiBufferModExp>(modulus);
+}
+
+namespace {
+
+// Big endian encoding of x, on mbedtls_mpi_size(&x) bytes
+std::vector<uint8_t> mpi_to_bytes(const mbedtls_mpi& x)
+{
+    std::vector<uint8_t> bytes(mbedtls_mpi_size(&x));
+    if (mbedtls_mpi_write_binary(&x, bytes.data(), bytes.size()) != 0) {
+        throw std::runtime_error(
+            "Unable to write the RSA public exponent"); /* LCOV_EXCL_LINE */
+    }
+    return bytes;
+}
+
+// Read the next size bytes of a binary key as a big endian integer
+void read_mpi_field(binary_key::Reader& reader, mbedtls_mpi& x, size_t size)
+{
+    if (mbedtls_mpi_read_binary(&x, reader.next(size), size) != 0) {
+        throw std::runtime_error(
+            "Unable to read a binary key field"); /* LCOV_EXCL_LINE */
+    }
+}
+
+// Write x as the next size bytes of a binary key
+void write_mpi_field(binary_key::Writer& writer,
+                     const mbedtls_mpi&  x,
+                     size_t              size)
+{
+    if (mbedtls_mpi_write_binary(&x, writer.next(size), size) != 0) {
+        throw std::runtime_error("The RSA key does not fit in the binary "
+                                 "key format");
+    }
+}
+
+// Per-thread temporaries of the TDP operations.
+// They are shared by all the TDP objects used by a thread: a TDP object never
+// modifies its own state when evaluating or inverting the permutation, so
+// that it can be used concurrently by several threads (e.g. by the batch
+// functions).
+class ThreadMpiCtx
+{
+public:
+    ThreadMpiCtx()
+    {
+        mbedtls_mpi_init(&x);
+        mbedtls_mpi_init(&y_p);
+        mbedtls_mpi_init(&y_q);
+        mbedtls_mpi_init(&y);
+        mbedtls_mpi_init(&r);
+        mbedtls_mpi_init(&r_inv);
+        mbedtls_mpi_init(&e_p);
+        mbedtls_mpi_init(&e_q);
+        mbedtls_mpi_mont_scratch_init(&scratch);
+    }
+
+    ~ThreadMpiCtx()
+    {
+        mbedtls_mpi_free(&x);
+        mbedtls_mpi_free(&y_p);
+        mbedtls_mpi_free(&y_q);
+        mbedtls_mpi_free(&y);
+        mbedtls_mpi_free(&r);
+        mbedtls_mpi_free(&r_inv);
+        mbedtls_mpi_free(&e_p);
+        mbedtls_mpi_free(&e_q);
+        mbedtls_mpi_mont_scratch_free(&scratch);
+    }
+
+    ThreadMpiCtx(const ThreadMpiCtx&) = delete;
+    ThreadMpiCtx& operator=(const ThreadMpiCtx&) = delete;
+
+    // erase the secret dependent values, but keep the allocated limbs
+    void wipe()
+    {
+        mbedtls_mpi_lset(&x, 0);
+        mbedtls_mpi_lset(&y_p, 0);
+        mbedtls_mpi_lset(&y_q, 0);
+        mbedtls_mpi_lset(&y, 0);
+        mbedtls_mpi_lset(&r, 0);
+        mbedtls_mpi_lset(&r_inv, 0);
+        mbedtls_mpi_lset(&e_p, 0);
+        mbedtls_mpi_lset(&e_q, 0);
+        mbedtls_mpi_mont_scratch_wipe(&scratch);
+    }
+
+    mbedtls_mpi              x, y_p, y_q, y;
+    // blinding values of the inversions
+    mbedtls_mpi              r, r_inv, e_p, e_q;
+    mbedtls_mpi_mont_scratch scratch;
+};
+
+ThreadMpiCtx& thread_mpi_ctx()
+{
+    static thread_local ThreadMpiCtx ctx;
+    return ctx;
+}
+
+// e <- d + k (p_1), for a fresh random 64 bits k (using k as a temporary).
+// With p_1 = P-1, e and d are equivalent exponents modulo P, but the bits of
+// e change at every call: this blinds the non constant time exponentiations.
+int blind_exponent(mbedtls_mpi*       e,
+                   const mbedtls_mpi& d,
+                   const mbedtls_mpi& p_1,
+                   mbedtls_mpi*       k)
+{
+    int ret;
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_fill_random(k, 8, mbedTLS_rng_wrap, nullptr));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(e, k, &p_1));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_add_mpi(e, e, &d));
+
+    // cppcheck does not see the use of goto cleanup in the MBEDTLS_MPI_CHK
+    // macros
+// cppcheck-suppress unusedLabel
+cleanup:
+    return ret;
+}
+
+// Chain of iterated evaluations of the TDP.
+// The current element is kept in Montgomery form between the steps.
+class TdpEvalChain_mbedTLS : public TdpChainImpl
+{
+public:
+    TdpEvalChain_mbedTLS(std::shared_ptr<const mbedtls_mpi_mont_ctx> mont_n,
+                         const mbedtls_mpi&                          E,
+                         const std::array<uint8_t, kMessageSpaceSize>& start)
+        : mont_n_(std::move(mont_n))
+    {
+        mbedtls_mpi_init(&e_);
+        mbedtls_mpi_init(&x_);
+        mbedtls_mpi_init(&y_);
+        mbedtls_mpi_mont_scratch_init(&scratch_);
+
+        int ret = mbedtls_mpi_copy(&e_, &E);
+        if (ret == 0) {
+            ret = mbedtls_mpi_read_binary(&y_, start.data(), start.size());
+        }
+        if (ret == 0) {
+            ret = mbedtls_mpi_mont_to(&x_, &y_, mont_n_.get(), &scratch_);
+        }
+
+        if (ret != 0) {
+            /* LCOV_EXCL_START */
+            clear();
+            throw std::runtime_error("Unable to initialize the TDP chain");
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    ~TdpEvalChain_mbedTLS() override
+    {
+        clear();
+    }
+
+    TdpEvalChain_mbedTLS(const TdpEvalChain_mbedTLS&) = delete;
+    TdpEvalChain_mbedTLS& operator=(const TdpEvalChain_mbedTLS&) = delete;
+
+    void advance(uint32_t steps) override
+    {
+        for (uint32_t i = 0; i < steps; i++) {
+            if (mbedtls_mpi_mont_exp(&x_, &x_, &e_, mont_n_.get(), &scratch_)
+                != 0) {
+                throw std::runtime_error(
+                    "Error during the modular exponentiation"); /* LCOV_EXCL_LINE
+                                                                 */
+            }
+        }
+    }
+
+    void value(std::array<uint8_t, kMessageSpaceSize>& out) const override
+    {
+        int ret = mbedtls_mpi_mont_from(&y_, &x_, mont_n_.get(), &scratch_);
+        if (ret == 0) {
+            ret = mbedtls_mpi_write_binary(&y_, out.data(), out.size());
+        }
+        if (ret != 0) {
+            throw std::runtime_error(
+                "Error while writing the TDP chain element"); /* LCOV_EXCL_LINE
+                                                               */
+        }
+    }
+
+private:
+    void clear()
+    {
+        // mbedtls_mpi_free erases the limbs before freeing them
+        mbedtls_mpi_free(&e_);
+        mbedtls_mpi_free(&x_);
+        mbedtls_mpi_free(&y_);
+        mbedtls_mpi_mont_scratch_free(&scratch_);
+    }
+
+    std::shared_ptr<const mbedtls_mpi_mont_ctx> mont_n_;
+
+    mbedtls_mpi                      e_;
+    mbedtls_mpi                      x_; // current element, Montgomery form
+    mutable mbedtls_mpi              y_;
+    mutable mbedtls_mpi_mont_scratch scratch_;
+};
+
+// Chain of iterated inversions of the TDP.
+// The current element is kept modulo P and modulo Q (in Montgomery form), and
+// the CRT recombination is only done when the element is requested.
+class TdpInvertChain_mbedTLS : public TdpChainImpl
+{
+public:
+    TdpInvertChain_mbedTLS(std::shared_ptr<const mbedtls_mpi_mont_ctx> mont_p,
+                           std::shared_ptr<const mbedtls_mpi_mont_ctx> mont_q,
+                           const mbedtls_rsa_context&                  key,
+                           const std::array<uint8_t, kMessageSpaceSize>& start)
+        : mont_p_(std::move(mont_p)), mont_q_(std::move(mont_q))
+    {
+        mbedtls_mpi_init(&dp_);
+        mbedtls_mpi_init(&dq_);
+        mbedtls_mpi_init(&qp_);
+        mbedtls_mpi_init(&p_1_);
+        mbedtls_mpi_init(&q_1_);
+        mbedtls_mpi_init(&x_p_);
+        mbedtls_mpi_init(&x_q_);
+        mbedtls_mpi_init(&y_);
+        mbedtls_mpi_init(&y_p_);
+        mbedtls_mpi_init(&y_q_);
+        mbedtls_mpi_mont_scratch_init(&scratch_);
+
+        int ret = mbedtls_mpi_copy(&dp_, &key.DP);
+        if (ret == 0) {
+            ret = mbedtls_mpi_copy(&dq_, &key.DQ);
+        }
+        if (ret == 0) {
+            ret = mbedtls_mpi_copy(&qp_, &key.QP);
+        }
+        if (ret == 0) {
+            ret = mbedtls_mpi_sub_int(&p_1_, &key.P, 1);
+        }
+        if (ret == 0) {
+            ret = mbedtls_mpi_sub_int(&q_1_, &key.Q, 1);
+        }
+        if (ret == 0) {
+            ret = mbedtls_mpi_read_binary(&y_, start.data(), start.size());
+        }
+        // mbedtls_mpi_mont_to reduces y_ modulo P (resp. Q)
+        if (ret == 0) {
+            ret = mbedtls_mpi_mont_to(&x_p_, &y_, mont_p_.get(), &scratch_);
+        }
+        if (ret == 0) {
+            ret = mbedtls_mpi_mont_to(&x_q_, &y_, mont_q_.get(), &scratch_);
+        }
+
+        if (ret != 0) {
+            /* LCOV_EXCL_START */
+            clear();
+            throw std::runtime_error("Unable to initialize the TDP chain");
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    ~TdpInvertChain_mbedTLS() override
+    {
+        clear();
+    }
+
+    TdpInvertChain_mbedTLS(const TdpInvertChain_mbedTLS&) = delete;
+    TdpInvertChain_mbedTLS& operator=(const TdpInvertChain_mbedTLS&) = delete;
+
+    void advance(uint32_t steps) override
+    {
+        // as for the single inversions, the secret exponents are blinded
+        // with fresh random values at every step
+        ThreadMpiCtx& t_ctx = thread_mpi_ctx();
+        int           ret   = 0;
+
+        for (uint32_t i = 0; i < steps && ret == 0; i++) {
+            ret = blind_exponent(&t_ctx.e_p, dp_, p_1_, &t_ctx.r);
+            if (ret == 0) {
+                ret = blind_exponent(&t_ctx.e_q, dq_, q_1_, &t_ctx.r);
+            }
+            if (ret == 0) {
+                ret = mbedtls_mpi_mont_exp(
+                    &x_p_, &x_p_, &t_ctx.e_p, mont_p_.get(), &scratch_);
+            }
+            if (ret == 0) {
+                ret = mbedtls_mpi_mont_exp(
+                    &x_q_, &x_q_, &t_ctx.e_q, mont_q_.get(), &scratch_);
+            }
+        }
+
+        // erase the blinded exponents
+        t_ctx.wipe();
+
+        if (ret != 0) {
+            throw std::runtime_error(
+                "Error during the modular exponentiation"); /* LCOV_EXCL_LINE
+                                                             */
+        }
+    }
+
+    void value(std::array<uint8_t, kMessageSpaceSize>& out) const override
+    {
+        int ret;
+
+        MBEDTLS_MPI_CHK(
+            mbedtls_mpi_mont_from(&y_p_, &x_p_, mont_p_.get(), &scratch_));
+        MBEDTLS_MPI_CHK(
+            mbedtls_mpi_mont_from(&y_q_, &x_q_, mont_q_.get(), &scratch_));
+
+        /*
+         * Y = (YP - YQ) * (Q^-1 mod P) mod P
+         */
+        MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&y_, &y_p_, &y_q_));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&y_p_, &y_, &qp_));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&y_, &y_p_, &mont_p_->N));
+
+        /*
+         * Y = YQ + Y * Q
+         */
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&y_p_, &y_, &mont_q_->N));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_add_mpi(&y_, &y_q_, &y_p_));
+
+        MBEDTLS_MPI_CHK(mbedtls_mpi_write_binary(&y_, out.data(), out.size()));
+
+    // cppcheck does not see the use of goto cleanup in the MBEDTLS_MPI_CHK
+    // macros
+    // cppcheck-suppress unusedLabel
+    cleanup:
+        // erase the temporary variables
+        mbedtls_mpi_lset(&y_, 0);
+        mbedtls_mpi_lset(&y_p_, 0);
+        mbedtls_mpi_lset(&y_q_, 0);
+
+        if (ret != 0) {
+            throw std::runtime_error(
+                "Error while writing the TDP chain element"); /* LCOV_EXCL_LINE
+                                                               */
+        }
+    }
+
+private:
+    void clear()
+    {
+        // mbedtls_mpi_free erases the limbs before freeing them
+        mbedtls_mpi_free(&dp_);
+        mbedtls_mpi_free(&dq_);
+        mbedtls_mpi_free(&qp_);
+        mbedtls_mpi_free(&p_1_);
+        mbedtls_mpi_free(&q_1_);
+        mbedtls_mpi_free(&x_p_);
+        mbedtls_mpi_free(&x_q_);
+        mbedtls_mpi_free(&y_);
+        mbedtls_mpi_free(&y_p_);
+        mbedtls_mpi_free(&y_q_);
+        mbedtls_mpi_mont_scratch_free(&scratch_);
+    }
+
+    std::shared_ptr<const mbedtls_mpi_mont_ctx> mont_p_, mont_q_;
+
+    mbedtls_mpi dp_, dq_, qp_;
+    // P-1 and Q-1, to blind the exponents
+    mbedtls_mpi p_1_, q_1_;
+    // current element, modulo P and Q, in Montgomery form
+    mbedtls_mpi x_p_, x_q_;
+
+    mutable mbedtls_mpi              y_, y_p_, y_q_;
+    mutable mbedtls_mpi_mont_scratch scratch_;
+};
+
+} // namespace
+
 // mbedTLS implementation of the trapdoor permutation
 
 TdpImpl_mbedTLS::TdpImpl_mbedTLS()
@@ -72,24 +514,35 @@ TdpImpl_mbedTLS::TdpImpl_mbedTLS(const std::string& pk)
 {
     mbedtls_rsa_init(&rsa_key_, 0, 0);
 
-    // parse the public key
-    if (mbedtls_rsa_parse_public_key(
-            &rsa_key_,
-            reinterpret_cast<const unsigned char*>(pk.c_str()),
-            pk.length() + 1)
-        != 0) {
-        throw std::runtime_error("Invalid RSA public key");
-    }
+    if (binary_key::has_header(pk, binary_key::kPublicKeyType)) {
+        binary_key::Reader reader(pk, binary_key::kPublicKeyType);
+        read_public_key(reader);
+    } else {
+        // parse the public key
+        if (mbedtls_rsa_parse_public_key(
+                &rsa_key_,
+                reinterpret_cast<const unsigned char*>(pk.c_str()),
+                pk.length() + 1)
+            != 0) {
+            throw std::runtime_error("Invalid RSA public key");
+        }
 
-    if (mbedtls_rsa_check_pubkey(&rsa_key_) != 0) {
-        /* LCOV_EXCL_START */
-        throw std::runtime_error("Invalid public key generated during the TDP "
-                                 "initialization");
-        /* LCOV_EXCL_STOP */
+        if (mbedtls_rsa_check_pubkey(&rsa_key_) != 0) {
+            /* LCOV_EXCL_START */
+            throw std::runtime_error("Invalid public key generated during the "
+                                     "TDP initialization");
+            /* LCOV_EXCL_STOP */
+        }
+
+        mont_n_ = make_mont_ctx(rsa_key_.N);
     }
+
+    mb_exp_ = make_mb_exp(rsa_key_.N);
 }
 
 TdpImpl_mbedTLS::TdpImpl_mbedTLS(const TdpImpl_mbedTLS& tdp)
+    : mont_n_(tdp.mont_n_), mb_exp_(tdp.mb_exp_),
+      public_key_pem_(tdp.public_key_pem_)
 {
     mbedtls_rsa_init(&rsa_key_, 0, 0); /* LCOV_EXCL_LINE */
     if (mbedtls_rsa_copy(&rsa_key_, &tdp.rsa_key_) != 0) {
@@ -120,6 +573,9 @@ TdpImpl_mbedTLS& TdpImpl_mbedTLS::operator=(const TdpImpl_mbedTLS& t)
 {
     if (this != &t) {
         mbedtls_rsa_copy(&rsa_key_, &(t.rsa_key_));
+        mont_n_         = t.mont_n_;
+        mb_exp_         = t.mb_exp_;
+        public_key_pem_ = t.public_key_pem_;
     }
 
     return *this;
@@ -127,43 +583,76 @@ TdpImpl_mbedTLS& TdpImpl_mbedTLS::operator=(const TdpImpl_mbedTLS& t)
 
 std::string TdpImpl_mbedTLS::public_key() const
 {
-    int           ret;
-    unsigned char buf[5000];
+    return public_key_pem_.get([this]() {
+        int           ret;
+        unsigned char buf[5000];
 
-    ret = mbedtls_rsa_write_pubkey_pem(
-        const_cast<mbedtls_rsa_context*>(&rsa_key_), buf, sizeof(buf));
+        ret = mbedtls_rsa_write_pubkey_pem(
+            const_cast<mbedtls_rsa_context*>(&rsa_key_), buf, sizeof(buf));
 
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Error when serializing the RSA public key. Error code: "
-            + std::to_string(ret)); /* LCOV_EXCL_LINE */
-    }
-    std::string v(reinterpret_cast<const char*>(buf));
+        if (ret != 0) {
+            throw std::runtime_error(
+                "Error when serializing the RSA public key. Error code: "
+                + std::to_string(ret)); /* LCOV_EXCL_LINE */
+        }
+        std::string v(reinterpret_cast<const char*>(buf));
 
-    sodium_memzero(buf, sizeof(buf));
+        sodium_memzero(buf, sizeof(buf));
 
-    return v;
+        return v;
+    });
 }
 
-void TdpImpl_mbedTLS::eval(const std::string& in, std::string& out) const
+std::string TdpImpl_mbedTLS::public_key_binary() const
 {
-    if (in.size() != rsa_size()) {
-        throw std::invalid_argument("Invalid TDP input size. Input size should "
-                                    "be kMessageSpaceSize bytes long.");
-    }
+    binary_key::Writer writer(binary_key::kPublicKeyType);
+
+    write_public_key(writer);
 
-    std::array<uint8_t, kMessageSpaceSize> in_array;
+    return writer.release();
+}
 
+void TdpImpl_mbedTLS::read_public_key(binary_key::Reader& reader)
+{
+    mbedtls_mpi RR;
+    mbedtls_mpi_init(&RR);
 
-    memcpy(in_array.data(), in.data(), kMessageSpaceSize);
+    try {
+        read_mpi_field(reader, rsa_key_.N, binary_key::kModulusSize);
+        read_mpi_field(reader, rsa_key_.E, binary_key::kModulusSize);
+        read_mpi_field(reader, RR, binary_key::kModulusSize);
+        rsa_key_.len = mbedtls_mpi_size(&rsa_key_.N);
 
-    auto out_array = eval(in_array);
+        if (mbedtls_rsa_check_pubkey(&rsa_key_) != 0) {
+            throw std::runtime_error("Invalid RSA public key");
+        }
+
+        mont_n_ = make_mont_ctx(rsa_key_.N, RR);
+    } catch (...) {
+        mbedtls_mpi_free(&RR);
+        throw;
+    }
+    mbedtls_mpi_free(&RR);
+}
 
-    out = std::string(out_array.begin(), out_array.end());
+void TdpImpl_mbedTLS::write_public_key(binary_key::Writer& writer) const
+{
+    write_mpi_field(writer, rsa_key_.N, binary_key::kModulusSize);
+    write_mpi_field(writer, rsa_key_.E, binary_key::kModulusSize);
+    write_mpi_field(writer, mont_n_->RR, binary_key::kModulusSize);
+}
 
+void TdpImpl_mbedTLS::eval(const std::string& in, std::string& out) const
+{
+    if (in.size() != rsa_size()) {
+        throw std::invalid_argument("Invalid TDP input size. Input size should "
+                                    "be kMessageSpaceSize bytes long.");
+    }
 
-    sodium_memzero(in_array.data(), in_array.size());
-    sodium_memzero(out_array.data(), out_array.size());
+    // in and out might be the same string: do not reallocate out
+    out.resize(kMessageSpaceSize);
+    eval_buffer(reinterpret_cast<const uint8_t*>(in.data()),
+                reinterpret_cast<uint8_t*>(&out[0]));
 }
 
 std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> TdpImpl_mbedTLS::eval(
@@ -171,62 +660,84 @@ std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> TdpImpl_mbedTLS::eval(
 {
     std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> out;
 
+    eval(in, out);
 
+    return out;
+}
+
+void TdpImpl_mbedTLS::eval(const std::array<uint8_t, kMessageSpaceSize>& in,
+                           std::array<uint8_t, kMessageSpaceSize>& out) const
+{
     if (in.size() != rsa_size()) {
         throw std::runtime_error(
             "Invalid TDP input size. Input size should be kMessageSpaceSize "
             "bytes long."); /* LCOV_EXCL_LINE */
     }
 
-    int         ret;
-    mbedtls_mpi x;
-    mbedtls_mpi_init(&x);
-
-    // deserialize the integer
-    ret = mbedtls_mpi_read_binary(&x, in.data(), in.size());
-
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Unable to read the TDP input"); /* LCOV_EXCL_LINE */
-    }
-
-    // in case we were given an input larger than the RSA modulus
-    ret = mbedtls_mpi_mod_mpi(&x, &x, &rsa_key_.N);
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Error when reducing the RSA input mod N"); /* LCOV_EXCL_LINE */
-    }
+    eval_buffer(in.data(), out.data());
+}
 
-    // calling mbedtls_rsa_public is not ideal here as it would require us to
-    // re-serialize the input
+void TdpImpl_mbedTLS::eval_buffer(const uint8_t* in, uint8_t* out) const
+{
+    eval_buffer(in, out, rsa_key_.E, 1);
+}
 
-#if defined(MBEDTLS_THREADING_C)
-    if (mbedtls_mutex_lock(&rsa_key_->mutex) != 0)
-        throw std::runtime_error(
-            "Unable to lock the RSA context"); /* LCOV_EXCL_LINE */
-#endif
+void TdpImpl_mbedTLS::eval_buffer(const uint8_t*     in,
+                                  uint8_t*           out,
+                                  const mbedtls_mpi& e,
+                                  uint32_t           iterations) const
+{
+    int           ret;
+    ThreadMpiCtx& t_ctx = thread_mpi_ctx();
 
-    ret = mbedtls_mpi_exp_mod(&x, &x, &rsa_key_.E, &rsa_key_.N, &rsa_key_.RN);
+    // deserialize the integer
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t_ctx.x, in, kMessageSpaceSize));
 
+    // the conversion to the Montgomery form reduces the input mod N, in case
+    // we were given an input larger than the RSA modulus
+    MBEDTLS_MPI_CHK(
+        mbedtls_mpi_mont_to(&t_ctx.y, &t_ctx.x, mont_n_.get(), &t_ctx.scratch));
+    // the public exponent is short: mbedtls_mpi_mont_exp uses
+    // square-and-multiply, and the value stays in Montgomery form between the
+    // iterations
+    for (uint32_t i = 0; i < iterations; i++) {
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mont_exp(
+            &t_ctx.y, &t_ctx.y, &e, mont_n_.get(), &t_ctx.scratch));
+    }
+    MBEDTLS_MPI_CHK(
+        mbedtls_mpi_mont_from(&t_ctx.y, &t_ctx.y, mont_n_.get(), &t_ctx.scratch));
 
-#if defined(MBEDTLS_THREADING_C)
-    if (mbedtls_mutex_unlock(&rsa_key_->mutex) != 0)
-        throw std::runtime_error(
-            "Unable to unlock the RSA context"); /* LCOV_EXCL_LINE */
-#endif
+    MBEDTLS_MPI_CHK(mbedtls_mpi_write_binary(&t_ctx.y, out, kMessageSpaceSize));
 
+    // cppcheck does not see the use of goto cleanup in the MBEDTLS_MPI_CHK
+    // macros
+// cppcheck-suppress unusedLabel
+cleanup:
     if (ret != 0) {
         throw std::runtime_error(
             "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
     }
+}
 
-    mbedtls_mpi_write_binary(&x, out.data(), out.size());
-    mbedtls_mpi_lset(&x, 0); // erase the temporary variable
-    mbedtls_mpi_free(&x);
 
-    return out;
+void TdpImpl_mbedTLS::eval_range(
+    const std::array<uint8_t, kMessageSpaceSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*       out,
+    size_t                                        count) const
+{
+    if (!mb_exp_ || count < MultiBufferModExp::kMinMessages) {
+        TdpImpl::eval_range(in, out, count);
+        return;
+    }
+
+    mb_exp_->mod_exp(in, out, count, mpi_to_bytes(rsa_key_.E));
 }
 
+TdpChainImpl* TdpImpl_mbedTLS::eval_chain(
+    const std::array<uint8_t, kMessageSpaceSize>& start) const
+{
+    return new TdpEvalChain_mbedTLS(mont_n_, rsa_key_.E, start);
+}
 
 std::string TdpImpl_mbedTLS::sample() const
 {
@@ -290,35 +801,46 @@ std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> TdpImpl_mbedTLS::
                    const std::string&           seed) const
 {
     std::array<uint8_t, Tdp::kRSAPrfSize> rnd = prg.prf(seed);
-
-    mbedtls_mpi x;
-    mbedtls_mpi_init(&x);
     std::array<uint8_t, kMessageSpaceSize> out;
-    std::fill(out.begin(), out.end(), 0);
 
-    int ret = 0;
+    reduce_range(&rnd, &out, 1);
+    sodium_memzero(rnd.data(), rnd.size());
 
-    ret = mbedtls_mpi_read_binary(&x, rnd.data(), rnd.size());
+    return out;
+}
 
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Unable to read the randomness input"); /* LCOV_EXCL_LINE */
+void TdpImpl_mbedTLS::reduce_range(
+    const std::array<uint8_t, Tdp::kRSAPrfSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*      out,
+    size_t                                       count) const
+{
+    int           ret   = 0;
+    ThreadMpiCtx& t_ctx = thread_mpi_ctx();
+
+    for (size_t i = 0; i < count; i++) {
+        MBEDTLS_MPI_CHK(
+            mbedtls_mpi_read_binary(&t_ctx.x, in[i].data(), in[i].size()));
+
+        // take the randomness mod N
+        // it is ok to do that as we took randomness large enough
+        // so that the bias of the obtained x is negligible
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_ctx.x, &t_ctx.x, &rsa_key_.N));
+
+        MBEDTLS_MPI_CHK(mbedtls_mpi_write_binary(
+            &t_ctx.x, out[i].data(), out[i].size()));
     }
 
-    // take the randomness mod N
-    // it is ok to do that as we took randomness large enough
-    // so that the bias of the obtained x is negligible
-    ret = mbedtls_mpi_mod_mpi(&x, &x, &rsa_key_.N);
+    // cppcheck does not see the use of goto cleanup in the MBEDTLS_MPI_CHK
+    // macros
+// cppcheck-suppress unusedLabel
+cleanup:
+    // the generated messages can be secret
+    t_ctx.wipe();
+
     if (ret != 0) {
         throw std::runtime_error(
             "Error when reducing the RSA input mod N"); /* LCOV_EXCL_LINE */
     }
-
-    mbedtls_mpi_write_binary(&x, out.data(), out.size());
-    mbedtls_mpi_lset(&x, 0);
-    mbedtls_mpi_free(&x);
-
-    return out;
 }
 
 std::string TdpImpl_mbedTLS::generate(
@@ -383,6 +905,11 @@ TdpInverseImpl_mbedTLS::TdpInverseImpl_mbedTLS()
         throw std::runtime_error(
             "Failed MPI multiplication"); /* LCOV_EXCL_LINE */
     }
+
+    mont_n_ = make_mont_ctx(rsa_key_.N);
+    mb_exp_ = make_mb_exp(rsa_key_.N);
+    mont_p_ = make_mont_ctx(rsa_key_.P);
+    mont_q_ = make_mont_ctx(rsa_key_.Q);
 }
 
 TdpInverseImpl_mbedTLS::TdpInverseImpl_mbedTLS(const std::string& sk)
@@ -395,24 +922,33 @@ TdpInverseImpl_mbedTLS::TdpInverseImpl_mbedTLS(const std::string& sk)
     mbedtls_mpi_init(&p_1_);
     mbedtls_mpi_init(&q_1_);
 
-    // do not forget the '\0' character
-    ret = mbedtls_rsa_parse_key(
-        &rsa_key_,
-        reinterpret_cast<const unsigned char*>(sk.c_str()),
-        sk.length() + 1,
-        nullptr,
-        0);
+    if (binary_key::has_header(sk, binary_key::kPrivateKeyType)) {
+        read_private_key(sk);
+    } else {
+        // do not forget the '\0' character
+        ret = mbedtls_rsa_parse_key(
+            &rsa_key_,
+            reinterpret_cast<const unsigned char*>(sk.c_str()),
+            sk.length() + 1,
+            nullptr,
+            0);
 
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Error when reading the RSA private key. Error code: "
-            + std::to_string(ret)); /* LCOV_EXCL_LINE */
-    }
+        if (ret != 0) {
+            throw std::runtime_error(
+                "Error when reading the RSA private key. Error code: "
+                + std::to_string(ret)); /* LCOV_EXCL_LINE */
+        }
 
-    if (mbedtls_rsa_check_pubkey(&rsa_key_) != 0) {
-        throw std::runtime_error(
-            "Invalid private key generated during the Inverse TDP "
-            "initialization from existing secret key"); /* LCOV_EXCL_LINE */
+        if (mbedtls_rsa_check_pubkey(&rsa_key_) != 0) {
+            throw std::runtime_error(
+                "Invalid private key generated during the Inverse TDP "
+                "initialization from existing secret key"); /* LCOV_EXCL_LINE
+                                                             */
+        }
+
+        mont_n_ = make_mont_ctx(rsa_key_.N);
+        mont_p_ = make_mont_ctx(rsa_key_.P);
+        mont_q_ = make_mont_ctx(rsa_key_.Q);
     }
 
     if (mbedtls_mpi_sub_int(&p_1_, &rsa_key_.P, 1) != 0) {
@@ -427,6 +963,8 @@ TdpInverseImpl_mbedTLS::TdpInverseImpl_mbedTLS(const std::string& sk)
         throw std::runtime_error(
             "Failed MPI multiplication"); /* LCOV_EXCL_LINE */
     }
+
+    mb_exp_ = make_mb_exp(rsa_key_.N);
 }
 
 TdpInverseImpl_mbedTLS::~TdpInverseImpl_mbedTLS()
@@ -442,50 +980,93 @@ TdpInverseImpl_mbedTLS::~TdpInverseImpl_mbedTLS()
 
 std::string TdpInverseImpl_mbedTLS::private_key() const
 {
-    int           ret;
-    unsigned char buf[5000];
+    return private_key_pem_.get([this]() {
+        int           ret;
+        unsigned char buf[5000];
 
-    ret = mbedtls_rsa_write_key_pem(&rsa_key_, buf, sizeof(buf));
+        ret = mbedtls_rsa_write_key_pem(&rsa_key_, buf, sizeof(buf));
 
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Error when serializing the RSA private key. Error code: "
-            + std::to_string(ret)); /* LCOV_EXCL_LINE */
-    }
-    std::string v(reinterpret_cast<const char*>(buf));
+        if (ret != 0) {
+            throw std::runtime_error(
+                "Error when serializing the RSA private key. Error code: "
+                + std::to_string(ret)); /* LCOV_EXCL_LINE */
+        }
+        std::string v(reinterpret_cast<const char*>(buf));
 
-    sodium_memzero(buf, sizeof(buf));
+        sodium_memzero(buf, sizeof(buf));
 
-    return v;
+        return v;
+    });
+}
+
+std::string TdpInverseImpl_mbedTLS::private_key_binary() const
+{
+    binary_key::Writer writer(binary_key::kPrivateKeyType);
+
+    write_public_key(writer);
+    write_mpi_field(writer, rsa_key_.D, binary_key::kModulusSize);
+    write_mpi_field(writer, rsa_key_.P, binary_key::kPrimeSize);
+    write_mpi_field(writer, rsa_key_.Q, binary_key::kPrimeSize);
+    write_mpi_field(writer, rsa_key_.DP, binary_key::kPrimeSize);
+    write_mpi_field(writer, rsa_key_.DQ, binary_key::kPrimeSize);
+    write_mpi_field(writer, rsa_key_.QP, binary_key::kPrimeSize);
+    write_mpi_field(writer, mont_p_->RR, binary_key::kPrimeSize);
+    write_mpi_field(writer, mont_q_->RR, binary_key::kPrimeSize);
+
+    return writer.release();
+}
+
+void TdpInverseImpl_mbedTLS::read_private_key(const std::string& sk)
+{
+    binary_key::Reader reader(sk, binary_key::kPrivateKeyType);
+
+    read_public_key(reader);
+
+    mbedtls_mpi RR_P, RR_Q;
+    mbedtls_mpi_init(&RR_P);
+    mbedtls_mpi_init(&RR_Q);
+
+    try {
+        read_mpi_field(reader, rsa_key_.D, binary_key::kModulusSize);
+        read_mpi_field(reader, rsa_key_.P, binary_key::kPrimeSize);
+        read_mpi_field(reader, rsa_key_.Q, binary_key::kPrimeSize);
+        read_mpi_field(reader, rsa_key_.DP, binary_key::kPrimeSize);
+        read_mpi_field(reader, rsa_key_.DQ, binary_key::kPrimeSize);
+        read_mpi_field(reader, rsa_key_.QP, binary_key::kPrimeSize);
+        read_mpi_field(reader, RR_P, binary_key::kPrimeSize);
+        read_mpi_field(reader, RR_Q, binary_key::kPrimeSize);
+
+        // check that N = P*Q, D*E = 1 mod lambda(N) and the CRT values (the
+        // primality of P and Q is not tested)
+        if (mbedtls_rsa_check_privkey(&rsa_key_) != 0) {
+            throw std::runtime_error("Invalid RSA private key");
+        }
+
+        mont_p_ = make_mont_ctx(rsa_key_.P, RR_P);
+        mont_q_ = make_mont_ctx(rsa_key_.Q, RR_Q);
+    } catch (...) {
+        mbedtls_mpi_free(&RR_P);
+        mbedtls_mpi_free(&RR_Q);
+        throw;
+    }
+
+    mbedtls_mpi_free(&RR_P);
+    mbedtls_mpi_free(&RR_Q);
 }
 
 
 void TdpInverseImpl_mbedTLS::invert(const std::string& in,
                                     std::string&       out) const
 {
-    int           ret;
-    unsigned char rsa_out[rsa_size()];
-
     if (in.size() != rsa_size()) {
         throw std::invalid_argument("Invalid TDP input size. Input size should "
                                     "be kMessageSpaceSize bytes long.");
     }
 
-    ret = mbedtls_rsa_private(&rsa_key_,
-                              mbedTLS_rng_wrap,
-                              nullptr,
-                              reinterpret_cast<const unsigned char*>(in.data()),
-                              rsa_out);
-
-    if (ret != 0) {
-        throw std::invalid_argument(
-            "Error during the RSA private key operation. Code: "
-            + std::to_string(ret)); /* LCOV_EXCL_LINE */
-    }
-
-    out = std::string(reinterpret_cast<char*>(rsa_out), rsa_size());
-
-    sodium_memzero(rsa_out, rsa_size());
+    // in and out might be the same string: do not reallocate out
+    out.resize(kMessageSpaceSize);
+    invert_buffer(reinterpret_cast<const uint8_t*>(in.data()),
+                  reinterpret_cast<uint8_t*>(&out[0]));
 }
 
 std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> TdpInverseImpl_mbedTLS::
@@ -493,18 +1074,27 @@ std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> TdpInverseImpl_mbedTLS::
 {
     std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> out;
 
-    int ret = mbedtls_rsa_private(
-        &rsa_key_, mbedTLS_rng_wrap, nullptr, in.data(), out.data());
-
-    if (ret != 0) {
-        throw std::invalid_argument(
-            "Error during the RSA private key operation. Code: "
-            + std::to_string(ret)); /* LCOV_EXCL_LINE */
-    }
+    invert(in, out);
 
     return out;
 }
 
+void TdpInverseImpl_mbedTLS::invert(
+    const std::array<uint8_t, kMessageSpaceSize>& in,
+    std::array<uint8_t, kMessageSpaceSize>&       out) const
+{
+    invert_buffer(in.data(), out.data());
+}
+
+void TdpInverseImpl_mbedTLS::invert_buffer(const uint8_t* in,
+                                           uint8_t*       out) const
+{
+    // do not use mbedtls_rsa_private: it updates the blinding values stored
+    // in rsa_key_, and the inversion would not be thread safe. crt_buffer
+    // draws its blinding values on every call instead.
+    crt_buffer(in, out, rsa_key_.DP, rsa_key_.DQ, true);
+}
+
 // returns X = A^E mod N, even when N is even
 // CAUTION!!!!: be aware that a timing attack would reveal E,
 // contrary to mbedtls_mpi_exp_mod
@@ -542,259 +1132,309 @@ TdpInverseImpl_mbedTLS::invert_mult(
     const std::array<uint8_t, kMessageSpaceSize>& in,
     uint32_t                                      order) const
 {
-    // we have to reimplement everything by hand here
-    // for the moment, this is not a very secure implementation:
-    // it does not use blinding when available
-#warning Potentially insecure RSA implementation
-    if (order == 0) {
-        return in;
-    }
-
     std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> out;
 
+    invert_mult(in, out, order);
+
+    return out;
+}
 
+void TdpInverseImpl_mbedTLS::invert_mult(
+    const std::array<uint8_t, kMessageSpaceSize>& in,
+    std::array<uint8_t, kMessageSpaceSize>&       out,
+    uint32_t                                      order) const
+{
     if (in.size() != rsa_size()) {
         throw std::invalid_argument(
             "Invalid TDP input size. Input size should be kMessageSpaceSize "
             "bytes long."); /* LCOV_EXCL_LINE */
     }
 
-    int         ret;
-    mbedtls_mpi x, mpi_order, d_p, d_q;
-    mbedtls_mpi y_p, y_q;
-    mbedtls_mpi y;
-    mbedtls_mpi_init(&x);
-    mbedtls_mpi_init(&mpi_order);
-    mbedtls_mpi_init(&d_p);
-    mbedtls_mpi_init(&d_q);
-    mbedtls_mpi_init(&y_p);
-    mbedtls_mpi_init(&y_q);
-    mbedtls_mpi_init(&y);
+    invert_mult_buffer(in.data(), out.data(), order);
+}
 
-    // deserialize the integer
-    ret = mbedtls_mpi_read_binary(&x, in.data(), in.size());
+void TdpInverseImpl_mbedTLS::invert_mult(const std::string& in,
+                                         std::string&       out,
+                                         uint32_t           order) const
+{
+    if (in.size() != rsa_size()) {
+        throw std::invalid_argument("Invalid TDP input size. Input size should "
+                                    "be kMessageSpaceSize bytes long.");
+    }
 
-    // in case we were given an input larger than the RSA modulus
-    //    ret = mbedtls_mpi_mod_mpi(&x,&x,&rsa_key_.N);
-    //    if (ret != 0) {
-    //        throw std::runtime_error("Error when reducing the RSA input mod
-    //        N"); /* LCOV_EXCL_LINE */
-    //    }
+    // in and out might be the same string: do not reallocate out
+    out.resize(kMessageSpaceSize);
+    invert_mult_buffer(reinterpret_cast<const uint8_t*>(in.data()),
+                       reinterpret_cast<uint8_t*>(&out[0]),
+                       order);
+}
 
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Unable to read the TDP input"); /* LCOV_EXCL_LINE */
+void TdpInverseImpl_mbedTLS::invert_mult_buffer(const uint8_t* in,
+                                                uint8_t*       out,
+                                                uint32_t       order) const
+{
+    if (order == 0) {
+        if (in != out) {
+            memcpy(out, in, kMessageSpaceSize);
+        }
+        return;
     }
 
-    // load the order
-    mbedtls_mpi_lset(&mpi_order, order);
+    std::shared_ptr<const CrtExponents> exps = crt_exponents(order);
 
-#if defined(MBEDTLS_THREADING_C)
-    if (mbedtls_mutex_lock(&rsa_key_->mutex) != 0)
-        throw std::runtime_error(
-            "Unable to lock the RSA context"); /* LCOV_EXCL_LINE */
-#endif
+    // the input cannot be blinded cheaply: it would take r^(E^order)
+    crt_buffer(in, out, exps->d_p, exps->d_q, false);
+}
 
-    // there is an issue with the following code:
-    // mbedTLS mpi library does not allow for a modular exponentiation
-    // where the module is even. And we were actually relying on that
-    // to compute the adjusted exponent
-    //    mbedtls_mpi_exp_mod(&d_p, &rsa_key_.DP, &mpi_order, &p_1_, nullptr);
-    //    mbedtls_mpi_exp_mod(&d_q, &rsa_key_.DQ, &mpi_order, &q_1_, nullptr);
+void TdpInverseImpl_mbedTLS::crt_buffer(const uint8_t*     in,
+                                        uint8_t*           out,
+                                        const mbedtls_mpi& d_p,
+                                        const mbedtls_mpi& d_q,
+                                        bool               blind_input) const
+{
+    // we have to reimplement everything by hand here: mbedtls_rsa_private
+    // stores its blinding values in the RSA context.
+    // mbedtls_mpi_mont_exp is not constant time, so the secret exponents are
+    // always blinded with fresh random values.
+    int           ret;
+    ThreadMpiCtx& t_ctx = thread_mpi_ctx();
 
-    // instead, we implemented the insecure_mod_exp function
-    // it is definitely less secure than mbedtls_mpi_exp_mod
-    // but it works with even modulis
-    MBEDTLS_MPI_CHK(insecure_mod_exp(&d_p, &rsa_key_.DP, order, &p_1_));
-    MBEDTLS_MPI_CHK(insecure_mod_exp(&d_q, &rsa_key_.DQ, order, &q_1_));
+    // deserialize the integer
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t_ctx.x, in, kMessageSpaceSize));
+
+    if (blind_input) {
+        // x <- x * r^E mod N, for a random r invertible mod N. The result is
+        // unblinded by a multiplication by r^-1.
+        do {
+            MBEDTLS_MPI_CHK(mbedtls_mpi_fill_random(
+                &t_ctx.r, kMessageSpaceSize - 1, mbedTLS_rng_wrap, nullptr));
+            ret = mbedtls_mpi_inv_mod(&t_ctx.r_inv, &t_ctx.r, &rsa_key_.N);
+        } while (ret == MBEDTLS_ERR_MPI_NOT_ACCEPTABLE);
+        MBEDTLS_MPI_CHK(ret);
+
+        // E is public: the exponentiation does not need to be blinded
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mont_to(
+            &t_ctx.y, &t_ctx.r, mont_n_.get(), &t_ctx.scratch));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mont_exp(
+            &t_ctx.y, &t_ctx.y, &rsa_key_.E, mont_n_.get(), &t_ctx.scratch));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mont_from(
+            &t_ctx.y, &t_ctx.y, mont_n_.get(), &t_ctx.scratch));
+
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&t_ctx.y_p, &t_ctx.x, &t_ctx.y));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_ctx.x, &t_ctx.y_p, &rsa_key_.N));
+    }
 
-    MBEDTLS_MPI_CHK(
-        mbedtls_mpi_exp_mod(&y_p, &x, &d_p, &rsa_key_.P, &rsa_key_.RP));
-    MBEDTLS_MPI_CHK(
-        mbedtls_mpi_exp_mod(&y_q, &x, &d_q, &rsa_key_.Q, &rsa_key_.RQ));
+    // e_p = d_p + k_p (P-1) and e_q = d_q + k_q (Q-1), for random 64 bits
+    // k_p and k_q
+    MBEDTLS_MPI_CHK(blind_exponent(&t_ctx.e_p, d_p, p_1_, &t_ctx.r));
+    MBEDTLS_MPI_CHK(blind_exponent(&t_ctx.e_q, d_q, q_1_, &t_ctx.r));
+
+    // the conversions to the Montgomery form reduce x mod P (resp. Q)
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mont_to(
+        &t_ctx.y_p, &t_ctx.x, mont_p_.get(), &t_ctx.scratch));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mont_exp(
+        &t_ctx.y_p, &t_ctx.y_p, &t_ctx.e_p, mont_p_.get(), &t_ctx.scratch));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mont_from(
+        &t_ctx.y_p, &t_ctx.y_p, mont_p_.get(), &t_ctx.scratch));
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mont_to(
+        &t_ctx.y_q, &t_ctx.x, mont_q_.get(), &t_ctx.scratch));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mont_exp(
+        &t_ctx.y_q, &t_ctx.y_q, &t_ctx.e_q, mont_q_.get(), &t_ctx.scratch));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mont_from(
+        &t_ctx.y_q, &t_ctx.y_q, mont_q_.get(), &t_ctx.scratch));
 
     /*
      * Y = (YP - YQ) * (Q^-1 mod P) mod P
      */
-
-    MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&y, &y_p, &y_q));
-    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&y_p, &y, &rsa_key_.QP));
-    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&y, &y_p, &rsa_key_.P));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&t_ctx.y, &t_ctx.y_p, &t_ctx.y_q));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&t_ctx.y_p, &t_ctx.y, &rsa_key_.QP));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_ctx.y, &t_ctx.y_p, &rsa_key_.P));
 
     /*
      * Y = YQ + Y * Q
      */
-    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&y_p, &y, &rsa_key_.Q));
-    MBEDTLS_MPI_CHK(mbedtls_mpi_add_mpi(&y, &y_q, &y_p));
-
-    ////    BN_mod_sub(h, y_p, y_q, get_rsa_key()->p, ctx);
-    //    mbedtls_mpi_sub_mpi(&h, &y_p, &y_q);
-    //    mbedtls_mpi_mod_mpi(&h, &h, &rsa_key_.P);
-    //
-    ////    BN_mod_mul(h, h, get_rsa_key()->iqmp, get_rsa_key()->p, ctx);
-    //    mbedtls_mpi_mul_mpi(&h, &h, &rsa_key_.QP);
-    //    mbedtls_mpi_mod_mpi(&h, &h, &rsa_key_.P);
-    //
-    //
-    //    mbedtls_mpi_mul_mpi(&y, &h, &rsa_key_.Q);
-    //    mbedtls_mpi_add_mpi(&y, &y, &y_q);
-
-
-    // calling mbedtls_rsa_public is not ideal here as it would require us to
-    // re-serialize the input
-
-#if defined(MBEDTLS_THREADING_C)
-    if (mbedtls_mutex_unlock(&rsa_key_->mutex) != 0)
-        throw std::runtime_error(
-            "Unable to unlock the RSA context"); /* LCOV_EXCL_LINE */
-#endif
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&t_ctx.y_p, &t_ctx.y, &rsa_key_.Q));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_add_mpi(&t_ctx.y, &t_ctx.y_q, &t_ctx.y_p));
 
-    if (mbedtls_mpi_write_binary(&y, out.data(), out.size()) != 0) {
-        throw std::runtime_error("Error while writing RSA result to the out "
-                                 "buffer"); /* LCOV_EXCL_LINE
-                                             */
+    if (blind_input) {
+        MBEDTLS_MPI_CHK(
+            mbedtls_mpi_mul_mpi(&t_ctx.y_p, &t_ctx.y, &t_ctx.r_inv));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_ctx.y, &t_ctx.y_p, &rsa_key_.N));
     }
 
+    MBEDTLS_MPI_CHK(mbedtls_mpi_write_binary(&t_ctx.y, out, kMessageSpaceSize));
+
     // cppcheck does not see the use of goto cleanup in the MBEDTLS_MPI_CHK
     // macros
 // cppcheck-suppress unusedLabel
 cleanup:
     // erase the temporary variables
-    mbedtls_mpi_lset(&x, 0);
-    mbedtls_mpi_lset(&d_p, 0);
-    mbedtls_mpi_lset(&d_q, 0);
-    mbedtls_mpi_lset(&y_p, 0);
-    mbedtls_mpi_lset(&y_q, 0);
-    mbedtls_mpi_lset(&mpi_order, 0);
-
-    mbedtls_mpi_free(&x);
-    mbedtls_mpi_free(&d_p);
-    mbedtls_mpi_free(&d_q);
-    mbedtls_mpi_free(&y_p);
-    mbedtls_mpi_free(&y_q);
-    mbedtls_mpi_free(&mpi_order);
+    t_ctx.wipe();
 
     if (ret != 0) {
         throw std::runtime_error(
             "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
     }
+}
 
-    mbedtls_mpi_lset(&y, 0); // erase the temporary variable
-    mbedtls_mpi_free(&y);
+TdpInverseImpl_mbedTLS::CrtExponents::CrtExponents()
+{
+    mbedtls_mpi_init(&d_p);
+    mbedtls_mpi_init(&d_q);
+}
 
-    return out;
+TdpInverseImpl_mbedTLS::CrtExponents::~CrtExponents()
+{
+    mbedtls_mpi_lset(&d_p, 0);
+    mbedtls_mpi_lset(&d_q, 0);
+
+    mbedtls_mpi_free(&d_p);
+    mbedtls_mpi_free(&d_q);
 }
 
-void TdpInverseImpl_mbedTLS::invert_mult(const std::string& in,
-                                         std::string&       out,
-                                         uint32_t           order) const
+std::shared_ptr<const TdpInverseImpl_mbedTLS::CrtExponents>
+TdpInverseImpl_mbedTLS::crt_exponents(uint32_t order) const
 {
-    std::array<uint8_t, kMessageSpaceSize> in_array;
+    std::shared_ptr<const CrtExponents> cached = crt_cache_.get(order);
+    if (cached) {
+        return cached;
+    }
 
-    memcpy(in_array.data(), in.data(), kMessageSpaceSize);
+    // compute the exponents outside of the cache lock: two threads might
+    // compute the same exponents concurrently, but only one copy is kept
+    std::shared_ptr<CrtExponents> exps = std::make_shared<CrtExponents>();
 
-    auto out_array = invert_mult(in_array, order);
+    // there is an issue with the following code:
+    // mbedTLS mpi library does not allow for a modular exponentiation
+    // where the module is even. And we were actually relying on that
+    // to compute the adjusted exponent
+    //    mbedtls_mpi_exp_mod(&d_p, &rsa_key_.DP, &mpi_order, &p_1_, nullptr);
+    //    mbedtls_mpi_exp_mod(&d_q, &rsa_key_.DQ, &mpi_order, &q_1_, nullptr);
 
-    out = std::string(out_array.begin(), out_array.end());
+    // instead, we implemented the insecure_mod_exp function
+    // it is definitely less secure than mbedtls_mpi_exp_mod
+    // but it works with even modulis
+    int ret = insecure_mod_exp(&exps->d_p, &rsa_key_.DP, order, &p_1_);
+    if (ret == 0) {
+        ret = insecure_mod_exp(&exps->d_q, &rsa_key_.DQ, order, &q_1_);
+    }
 
-    sodium_memzero(out_array.data(), out_array.size());
-}
+    if (ret != 0) {
+        throw std::runtime_error("Error during the computation of the CRT "
+                                 "exponents"); /* LCOV_EXCL_LINE */
+    }
 
+    crt_cache_.insert(order, exps);
 
-TdpMultPoolImpl_mbedTLS::TdpMultPoolImpl_mbedTLS(const std::string& sk,
-                                                 const uint8_t      size)
-    : TdpImpl_mbedTLS(sk), keys_count_(size - 1)
+    return exps;
+}
+
+void TdpInverseImpl_mbedTLS::prewarm_invert_mult(uint32_t first_order,
+                                                 uint32_t last_order) const
 {
-    if (size == 0) {
+    if (first_order > last_order) {
         throw std::invalid_argument(
-            "Invalid Multiple TDP pool input size. Pool size should be > 0.");
+            "Invalid order range: first_order > last_order");
     }
 
-    keys_ = new mbedtls_rsa_context[keys_count_];
+    // only the last kInvertMultCacheSize orders would stay in the cache
+    if (last_order - first_order >= crt_cache_.capacity()) {
+        first_order = last_order
+                      - static_cast<uint32_t>(crt_cache_.capacity() - 1);
+    }
 
-    mbedtls_rsa_init(keys_, 0, 0);
-    mbedtls_rsa_copy(keys_, &rsa_key_);
+    // use a 64 bits counter to avoid an overflow when last_order is
+    // UINT32_MAX
+    for (uint64_t order = first_order; order <= last_order; order++) {
+        if (order != 0) {
+            crt_exponents(static_cast<uint32_t>(order));
+        }
+    }
+}
+
+TdpChainImpl* TdpInverseImpl_mbedTLS::invert_chain(
+    const std::array<uint8_t, kMessageSpaceSize>& start) const
+{
+    return new TdpInvertChain_mbedTLS(mont_p_, mont_q_, rsa_key_, start);
+}
 
-    mbedtls_mpi_mul_int(&keys_[0].E, &keys_[0].E, RSA_PK);
 
-    if (mbedtls_rsa_check_pubkey(&keys_[0]) != 0) {
-        throw std::runtime_error("Invalid public key generated during the TDP "
-                                 "pool initialization"); /* LCOV_EXCL_LINE */
+TdpMultPoolImpl_mbedTLS::PoolExponents::PoolExponents(const mbedtls_mpi& e,
+                                                      const uint8_t      size)
+    : e_orders(size - 1), chained(size_t(size) + 1, false)
+{
+    for (mbedtls_mpi& e_order : e_orders) {
+        mbedtls_mpi_init(&e_order);
     }
 
-    for (uint8_t i = 1; i < keys_count_; i++) {
-        mbedtls_rsa_init(&keys_[i], 0, 0);
-        mbedtls_rsa_copy(&keys_[i], &keys_[i - 1]);
+    try {
+        for (size_t i = 0; i < e_orders.size(); i++) {
+            const mbedtls_mpi& previous = (i == 0) ? e : e_orders[i - 1];
 
-        mbedtls_mpi_mul_int(&keys_[i].E, &keys_[i - 1].E, RSA_PK);
+            if (mbedtls_mpi_mul_mpi(&e_orders[i], &previous, &e) != 0) {
+                throw std::runtime_error(
+                    "Unable to compute the exponents of the TDP "
+                    "pool"); /* LCOV_EXCL_LINE */
+            }
+        }
 
-        if (mbedtls_rsa_check_pubkey(&keys_[i]) != 0) {
-            throw std::runtime_error(
-                "Invalid public key generated during the TDP pool "
-                "initialization"); /* LCOV_EXCL_LINE */
+        const std::vector<uint8_t> e_bytes = mpi_to_bytes(e);
+
+        for (size_t i = 0; i < e_orders.size(); i++) {
+            chained[i + 2]
+                = chained_eval_is_faster(e_bytes,
+                                         mpi_to_bytes(e_orders[i]),
+                                         static_cast<unsigned>(i) + 2);
         }
+    } catch (...) {
+        /* LCOV_EXCL_START */
+        for (mbedtls_mpi& e_order : e_orders) {
+            mbedtls_mpi_free(&e_order);
+        }
+        throw;
+        /* LCOV_EXCL_STOP */
     }
 }
 
-TdpMultPoolImpl_mbedTLS::TdpMultPoolImpl_mbedTLS(
-    const TdpMultPoolImpl_mbedTLS& pool_impl)
-    : TdpImpl_mbedTLS(pool_impl), keys_count_(pool_impl.keys_count_)
+TdpMultPoolImpl_mbedTLS::PoolExponents::~PoolExponents()
 {
-    keys_ = new mbedtls_rsa_context[keys_count_];
-
-    for (uint8_t i = 0; i < keys_count_; i++) {
-        mbedtls_rsa_init(&keys_[i], 0, 0);
+    for (mbedtls_mpi& e_order : e_orders) {
+        mbedtls_mpi_free(&e_order);
+    }
+}
 
-        mbedtls_rsa_copy(&keys_[i], &pool_impl.keys_[i]);
+TdpMultPoolImpl_mbedTLS::TdpMultPoolImpl_mbedTLS(const std::string& sk,
+                                                 const uint8_t      size)
+    : TdpImpl_mbedTLS(sk)
+{
+    if (size == 0) {
+        throw std::invalid_argument(
+            "Invalid Multiple TDP pool input size. Pool size should be > 0.");
+    }
 
+    // As all the keys of the pool share the same modulus, only the public
+    // exponents are stored. They are not bounded by the modulus.
+    exponents_ = std::make_shared<const PoolExponents>(rsa_key_.E, size);
+}
 
-        if (mbedtls_rsa_check_pubkey(&keys_[i]) != 0) {
-            throw std::runtime_error(
-                "Invalid public key generated by the TDP pool copy "
-                "constructor"); /* LCOV_EXCL_LINE */
-        }
-    }
+TdpMultPoolImpl_mbedTLS::TdpMultPoolImpl_mbedTLS(
+    const TdpMultPoolImpl_mbedTLS& pool_impl)
+    : TdpImpl_mbedTLS(pool_impl), exponents_(pool_impl.exponents_)
+{
 }
 
 TdpMultPoolImpl_mbedTLS& TdpMultPoolImpl_mbedTLS::operator=(
     const TdpMultPoolImpl_mbedTLS& t)
 {
     if (this != &t) {
-        for (uint8_t i = 0; i < keys_count_; i++) {
-            zeroize_rsa(&keys_[i]);
-            mbedtls_rsa_free(&keys_[i]);
-        }
-
-        if (keys_count_ != t.keys_count_) {
-            // realloc the key array
-            delete[] keys_;
-            keys_count_ = t.keys_count_;
-            keys_       = new mbedtls_rsa_context[keys_count_];
-        }
-
-        for (uint8_t i = 0; i < keys_count_; i++) {
-            mbedtls_rsa_init(&keys_[i], 0, 0);
-
-            mbedtls_rsa_copy(&keys_[i], &t.keys_[i]);
-
-            if (mbedtls_rsa_check_pubkey(&keys_[i]) != 0) {
-                throw std::runtime_error(
-                    "Invalid public key generated by the TDP pool assignment "
-                    "operator"); /* LCOV_EXCL_LINE */
-            }
-        }
+        TdpImpl_mbedTLS::operator=(t);
+        exponents_ = t.exponents_;
     }
     return *this;
 }
 
-TdpMultPoolImpl_mbedTLS::~TdpMultPoolImpl_mbedTLS()
-{
-    for (uint8_t i = 0; i < keys_count_; i++) {
-        zeroize_rsa(&keys_[i]);
-        mbedtls_rsa_free(&keys_[i]);
-    }
-    delete[] keys_;
-}
+TdpMultPoolImpl_mbedTLS::~TdpMultPoolImpl_mbedTLS() = default;
 
 std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize>
 TdpMultPoolImpl_mbedTLS::eval_pool(
@@ -802,75 +1442,27 @@ TdpMultPoolImpl_mbedTLS::eval_pool(
     const uint8_t                                 order) const
 {
     std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> out;
-    mbedtls_rsa_context*                                    key;
-    if (order == 1) {
-        // regular eval
-        key = &rsa_key_;
-
-    } else if (order <= maximum_order()) {
-        // get the right RSA context, i.e. the one in keys_[order-1]
-        key = &keys_[order - 2];
-    } else {
+
+    if (order == 0 || order > maximum_order()) {
         throw std::invalid_argument(
             "Invalid order for this TDP pool. The input order must be less "
             "than the maximum order supported by the pool, and strictly "
             "positive.");
     }
 
-
     if (in.size() != rsa_size()) {
         throw std::runtime_error(
             "Invalid TDP input size. Input size should be kMessageSpaceSize "
             "bytes long."); /* LCOV_EXCL_LINE */
     }
 
-    int         ret;
-    mbedtls_mpi x;
-    mbedtls_mpi_init(&x);
-
-    // deserialize the integer
-    ret = mbedtls_mpi_read_binary(&x, in.data(), in.size());
-
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Unable to read the TDP input"); /* LCOV_EXCL_LINE */
-    }
-
-    // in case we were given an input larger than the RSA modulus
-    //    ret = mbedtls_mpi_mod_mpi(&x,&x,&key->N);
-    //    if (ret != 0) {
-    //        throw std::runtime_error("Error when reducing the RSA input mod
-    //        N"); /* LCOV_EXCL_LINE */
-    //    }
-
-    // calling mbedtls_rsa_public is not ideal here as it would require us to
-    // re-serialize the input
-
-#if defined(MBEDTLS_THREADING_C)
-    if (mbedtls_mutex_lock(key->mutex) != 0)
-        throw std::runtime_error(
-            "Unable to lock the RSA context"); /* LCOV_EXCL_LINE */
-#endif
-
-    ret = mbedtls_mpi_exp_mod(&x, &x, &key->E, &key->N, &key->RN);
-
-
-#if defined(MBEDTLS_THREADING_C)
-    if (mbedtls_mutex_unlock(key->mutex) != 0)
-        throw std::runtime_error(
-            "Unable to unlock the RSA context"); /* LCOV_EXCL_LINE */
-#endif
-
-    if (ret != 0) {
-        throw std::runtime_error(
-            "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+    // all the exponents of the pool share the same modulus
+    if (order == 1 || exponents_->chained[order]) {
+        eval_buffer(in.data(), out.data(), rsa_key_.E, order);
+    } else {
+        eval_buffer(in.data(), out.data(), exponents_->e_orders[order - 2], 1);
     }
 
-    mbedtls_mpi_write_binary(&x, out.data(), out.size());
-
-    mbedtls_mpi_lset(&x, 0);
-    mbedtls_mpi_free(&x);
-
     return out;
 }
 
@@ -896,7 +1488,7 @@ void TdpMultPoolImpl_mbedTLS::eval_pool(const std::string& in,
 
 uint8_t TdpMultPoolImpl_mbedTLS::maximum_order() const
 {
-    return keys_count_ + 1;
+    return static_cast<uint8_t>(exponents_->e_orders.size() + 1);
 }
 
 } // namespace crypto
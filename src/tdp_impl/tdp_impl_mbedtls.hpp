@@ -23,6 +23,9 @@
 
 #include "mbedtls/bignum.h"
 #include "mbedtls/rsa.h"
+#include "exponent_cache.hpp"
+#include "key_encoding.hpp"
+#include "multi_buffer_mod_exp.hpp"
 #include "tdp_impl.hpp"
 
 #include <sse/crypto/key.hpp>
@@ -31,7 +34,9 @@
 #include <cstdint>
 
 #include <array>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace sse {
 namespace crypto {
@@ -52,10 +57,16 @@ public:
     size_t rsa_size() const override;
 
     std::string public_key() const override;
+    std::string public_key_binary() const override;
 
     void eval(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> eval(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void eval(const std::array<uint8_t, kMessageSpaceSize>& in,
+              std::array<uint8_t, kMessageSpaceSize>&       out) const override;
+
+    TdpChainImpl* eval_chain(
+        const std::array<uint8_t, kMessageSpaceSize>& start) const override;
 
     std::string                            sample() const override;
     std::array<uint8_t, kMessageSpaceSize> sample_array() const override;
@@ -74,7 +85,42 @@ public:
 protected:
     TdpImpl_mbedTLS();
 
+    // Evaluate the TDP on the kMessageSpaceSize bytes pointed by in and write
+    // the result to out. in and out may alias.
+    void eval_buffer(const uint8_t* in, uint8_t* out) const;
+    // Same as above, with the public exponent e, applied iterations times
+    // (used by the TDP pool, whose keys share the same modulus)
+    void eval_buffer(const uint8_t*     in,
+                     uint8_t*           out,
+                     const mbedtls_mpi& e,
+                     uint32_t           iterations) const;
+
+    void eval_range(const std::array<uint8_t, kMessageSpaceSize>* in,
+                    std::array<uint8_t, kMessageSpaceSize>*       out,
+                    size_t count) const override;
+
+    void reduce_range(const std::array<uint8_t, Tdp::kRSAPrfSize>* in,
+                      std::array<uint8_t, kMessageSpaceSize>*      out,
+                      size_t count) const override;
+
+    // Read (resp. write) the public fields of a binary key: N, E and
+    // R^2 mod N. read_public_key also sets up mont_n_.
+    void read_public_key(binary_key::Reader& reader);
+    void write_public_key(binary_key::Writer& writer) const;
+
     mutable mbedtls_rsa_context rsa_key_;
+
+    // Montgomery context for the modulus N. It is immutable, and shared
+    // between the copies of the TDP and the evaluation chains.
+    std::shared_ptr<const mbedtls_mpi_mont_ctx> mont_n_;
+
+    // Vectorized exponentiation engine used by eval_range (nullptr if the
+    // CPU does not support it)
+    std::shared_ptr<const MultiBufferModExp> mb_exp_;
+
+    // PEM encoding of the public key, computed on the first call to
+    // public_key()
+    SerializedKeyCache public_key_pem_;
 };
 
 class TdpInverseImpl_mbedTLS : public TdpImpl_mbedTLS,
@@ -90,9 +136,12 @@ public:
     TdpInverseImpl_mbedTLS& operator=(const TdpInverseImpl_mbedTLS& t) = delete;
 
     std::string private_key() const override;
+    std::string private_key_binary() const override;
     void        invert(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> invert(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void invert(const std::array<uint8_t, kMessageSpaceSize>& in,
+                std::array<uint8_t, kMessageSpaceSize>& out) const override;
 
     std::array<uint8_t, kMessageSpaceSize> invert_mult(
         const std::array<uint8_t, kMessageSpaceSize>& in,
@@ -100,9 +149,65 @@ public:
     void invert_mult(const std::string& in,
                      std::string&       out,
                      uint32_t           order) const override;
+    void invert_mult(const std::array<uint8_t, kMessageSpaceSize>& in,
+                     std::array<uint8_t, kMessageSpaceSize>&       out,
+                     uint32_t order) const override;
+
+    void prewarm_invert_mult(uint32_t first_order,
+                             uint32_t last_order) const override;
+
+    TdpChainImpl* invert_chain(
+        const std::array<uint8_t, kMessageSpaceSize>& start) const override;
 
 private:
+    // CRT exponents used by invert_mult: d_p^order mod (p-1) and
+    // d_q^order mod (q-1). They are erased on destruction.
+    struct CrtExponents
+    {
+        CrtExponents();
+        ~CrtExponents();
+
+        CrtExponents(const CrtExponents&) = delete;
+        CrtExponents& operator=(const CrtExponents&) = delete;
+
+        mbedtls_mpi d_p;
+        mbedtls_mpi d_q;
+    };
+
+    // Get the CRT exponents for order from the cache, or compute them (and
+    // cache them) if needed
+    std::shared_ptr<const CrtExponents> crt_exponents(uint32_t order) const;
+
+    // Raw buffer versions of the inversion functions. in and out must point
+    // to kMessageSpaceSize bytes and may alias.
+    void invert_buffer(const uint8_t* in, uint8_t* out) const;
+    void invert_mult_buffer(const uint8_t* in,
+                            uint8_t*       out,
+                            uint32_t       order) const;
+
+    // CRT exponentiation with the exponents d_p and d_q. The exponents are
+    // always blinded. The input is also blinded if blind_input is true: d_p
+    // and d_q must then be the CRT exponents of E^-1.
+    void crt_buffer(const uint8_t*     in,
+                    uint8_t*           out,
+                    const mbedtls_mpi& d_p,
+                    const mbedtls_mpi& d_q,
+                    bool               blind_input) const;
+
+    // Set rsa_key_ and the Montgomery contexts from a binary private key
+    void read_private_key(const std::string& sk);
+
     mbedtls_mpi phi_, p_1_, q_1_;
+
+    // Montgomery contexts for the primes P and Q
+    std::shared_ptr<const mbedtls_mpi_mont_ctx> mont_p_, mont_q_;
+
+    // PEM encoding of the private key, computed on the first call to
+    // private_key()
+    SerializedKeyCache private_key_pem_;
+
+    ExponentCache<CrtExponents> crt_cache_{
+        TdpInverse::kInvertMultCacheSize};
 };
 
 class TdpMultPoolImpl_mbedTLS : public TdpImpl_mbedTLS,
@@ -126,9 +231,25 @@ public:
     uint8_t maximum_order() const override;
 
 private:
-    mbedtls_rsa_context* keys_;
+    // Precomputations of the pool. They are immutable, and shared between
+    // the copies of the pool.
+    struct PoolExponents
+    {
+        PoolExponents(const mbedtls_mpi& e, uint8_t size);
+        ~PoolExponents();
+
+        PoolExponents(const PoolExponents&) = delete;
+        PoolExponents& operator=(const PoolExponents&) = delete;
+
+        // e_orders[i] = e^(i+2)
+        std::vector<mbedtls_mpi> e_orders;
+
+        // chained[order] is true if the evaluation at this order is faster
+        // as order successive evaluations than with e^order
+        std::vector<bool> chained;
+    };
 
-    uint8_t keys_count_;
+    std::shared_ptr<const PoolExponents> exponents_;
 };
 
 
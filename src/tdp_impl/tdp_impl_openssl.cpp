@@ -23,6 +23,7 @@
 
 #include "tdp_impl_openssl.hpp"
 
+#include "exponent_cost.hpp"
 #include "prf.hpp"
 #include "random.hpp"
 
@@ -31,6 +32,10 @@
 #include <exception>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <openssl/bio.h>
 #include <openssl/evp.h>
@@ -50,12 +55,460 @@ static_assert(Tdp::kMessageSize == TdpInverse::kMessageSize,
 
 #define RSA_PK 0x10001L // RSA_F4 for OpenSSL
 
+namespace {
+
+// Per-thread BN_CTX, shared by all the TDP objects used by a thread.
+// A BN_CTX keeps the BIGNUMs it hands out with BN_CTX_get in an internal pool.
+// Reusing the same context between calls avoids allocating and freeing the
+// temporary variables (and their limbs) for every TDP operation.
+class ThreadBnCtx
+{
+public:
+    ThreadBnCtx() : ctx_(BN_CTX_new())
+    {
+    }
+
+    ~ThreadBnCtx()
+    {
+        // BN_CTX_free clears the pooled BIGNUMs before freeing them
+        BN_CTX_free(ctx_);
+    }
+
+    ThreadBnCtx(const ThreadBnCtx&) = delete;
+    ThreadBnCtx& operator=(const ThreadBnCtx&) = delete;
+
+    BN_CTX* get() const
+    {
+        if (ctx_ == nullptr) {
+            throw std::runtime_error(
+                "Unable to allocate a BN_CTX"); /* LCOV_EXCL_LINE */
+        }
+        return ctx_;
+    }
+
+private:
+    BN_CTX* ctx_;
+};
+
+BN_CTX* thread_bn_ctx()
+{
+    static thread_local ThreadBnCtx ctx;
+    return ctx.get();
+}
+
+// Scoped BN_CTX_start/BN_CTX_end frame on the thread's BN_CTX.
+// The BIGNUMs returned by get() are only valid during the lifetime of the
+// frame.
+class BnCtxFrame
+{
+public:
+    BnCtxFrame() : ctx_(thread_bn_ctx())
+    {
+        BN_CTX_start(ctx_);
+    }
+
+    ~BnCtxFrame()
+    {
+        BN_CTX_end(ctx_);
+    }
+
+    BnCtxFrame(const BnCtxFrame&) = delete;
+    BnCtxFrame& operator=(const BnCtxFrame&) = delete;
+
+    BIGNUM* get()
+    {
+        BIGNUM* bn = BN_CTX_get(ctx_);
+        if (bn == nullptr) {
+            throw std::runtime_error(
+                "Unable to get a BIGNUM from the BN_CTX"); /* LCOV_EXCL_LINE */
+        }
+        return bn;
+    }
+
+    BN_CTX* ctx() const
+    {
+        return ctx_;
+    }
+
+private:
+    BN_CTX* ctx_;
+};
+
+// Write bn as a big endian, zero-padded, kMessageSpaceSize bytes integer
+void bn_to_buffer(const BIGNUM* bn, uint8_t* out)
+{
+    // bn2bin returns a BIG endian array, so be careful ...
+    size_t pos = TdpImpl::kMessageSpaceSize
+                 - static_cast<size_t>(BN_num_bytes(bn));
+    // set the leading bytes to 0
+    std::fill(out, out + pos, 0);
+    BN_bn2bin(bn, out + pos);
+}
+
+std::shared_ptr<BN_MONT_CTX> make_mont_ctx(const BIGNUM* m)
+{
+    BN_MONT_CTX* mont = BN_MONT_CTX_new();
+
+    if (mont == nullptr || BN_MONT_CTX_set(mont, m, thread_bn_ctx()) != 1) {
+        /* LCOV_EXCL_START */
+        BN_MONT_CTX_free(mont);
+        throw std::runtime_error("Unable to setup a Montgomery context");
+        /* LCOV_EXCL_STOP */
+    }
+
+    return std::shared_ptr<BN_MONT_CTX>(mont, BN_MONT_CTX_free);
+}
+
+// Big endian encoding of bn, on BN_num_bytes(bn) bytes
+std::vector<uint8_t> bn_to_bytes(const BIGNUM* bn)
+{
+    std::vector<uint8_t> bytes(static_cast<size_t>(BN_num_bytes(bn)));
+    BN_bn2bin(bn, bytes.data());
+    return bytes;
+}
+
+// Read the next size bytes of a binary key as a big endian integer
+BIGNUM* read_bn_field(binary_key::Reader& reader, size_t size)
+{
+    BIGNUM* bn = BN_bin2bn(reader.next(size), static_cast<int>(size), nullptr);
+    if (bn == nullptr) {
+        throw std::runtime_error(
+            "Unable to read a binary key field"); /* LCOV_EXCL_LINE */
+    }
+    return bn;
+}
+
+// Write bn as the next size bytes of a binary key
+void write_bn_field(binary_key::Writer& writer, const BIGNUM* bn, size_t size)
+{
+    size_t len = static_cast<size_t>(BN_num_bytes(bn));
+    if (len > size) {
+        throw std::runtime_error("The RSA key does not fit in the binary "
+                                 "key format");
+    }
+    uint8_t* field = writer.next(size);
+    std::fill(field, field + (size - len), 0);
+    BN_bn2bin(bn, field + (size - len));
+}
+
+// Write R^2 mod m, R being the Montgomery radix of mont, as the next size
+// bytes of a binary key
+void write_rr_field(binary_key::Writer& writer, BN_MONT_CTX* mont, size_t size)
+{
+    BnCtxFrame frame;
+    BIGNUM*    rr = frame.get();
+
+    // R mod m, then R^2 mod m
+    if (BN_to_montgomery(rr, BN_value_one(), mont, frame.ctx()) != 1
+        || BN_to_montgomery(rr, rr, mont, frame.ctx()) != 1) {
+        throw std::runtime_error(
+            "Unable to compute the Montgomery constants"); /* LCOV_EXCL_LINE */
+    }
+    write_bn_field(writer, rr, size);
+}
+
+// RSA key owned until it is handed over to the TDP, so that it does not leak
+// when the parsing fails
+using RsaKeyPtr = std::unique_ptr<RSA, decltype(&RSA_free)>;
+
+RsaKeyPtr new_rsa_key()
+{
+    RsaKeyPtr key(RSA_new(), RSA_free);
+    if (!key) {
+        throw std::runtime_error(
+            "Unable to allocate an RSA key"); /* LCOV_EXCL_LINE */
+    }
+    return key;
+}
+
+// Check the consistency of the private fields of key: n = p*q,
+// d*e = 1 mod lambda(n), dmp1 = d mod (p-1), dmq1 = d mod (q-1) and
+// iqmp*q = 1 mod p. Contrary to RSA_check_key, the primality of p and q is not
+// tested.
+bool check_private_key(const RSA* key)
+{
+    BnCtxFrame frame;
+    BN_CTX*    ctx    = frame.ctx();
+    BIGNUM*    p_1    = frame.get();
+    BIGNUM*    q_1    = frame.get();
+    BIGNUM*    g      = frame.get();
+    BIGNUM*    lambda = frame.get();
+    BIGNUM*    t      = frame.get();
+
+    if (BN_mul(t, key->p, key->q, ctx) != 1 || BN_cmp(t, key->n) != 0) {
+        return false;
+    }
+
+    if (BN_sub(p_1, key->p, BN_value_one()) != 1
+        || BN_sub(q_1, key->q, BN_value_one()) != 1 || BN_is_zero(p_1)
+        || BN_is_zero(q_1)) {
+        return false;
+    }
+
+    // lambda(n) = lcm(p-1, q-1)
+    if (BN_gcd(g, p_1, q_1, ctx) != 1 || BN_mul(t, p_1, q_1, ctx) != 1
+        || BN_div(lambda, nullptr, t, g, ctx) != 1
+        || BN_mod_mul(t, key->d, key->e, lambda, ctx) != 1 || !BN_is_one(t)) {
+        return false;
+    }
+
+    if (BN_mod(t, key->d, p_1, ctx) != 1 || BN_cmp(t, key->dmp1) != 0
+        || BN_mod(t, key->d, q_1, ctx) != 1 || BN_cmp(t, key->dmq1) != 0) {
+        return false;
+    }
+
+    return BN_mod_mul(t, key->iqmp, key->q, key->p, ctx) == 1 && BN_is_one(t);
+}
+
+// x = x^e, where x is in Montgomery form and e is a short exponent
+// (left-to-right square-and-multiply: no window table, and no conversion
+// to and from the Montgomery form)
+void mont_exp_short(BIGNUM*      x,
+                    const BIGNUM* e,
+                    BN_MONT_CTX*  mont,
+                    BnCtxFrame&   frame)
+{
+    BIGNUM* acc = frame.get();
+
+    if (BN_copy(acc, x) == nullptr) {
+        throw std::runtime_error(
+            "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+    }
+    for (int b = BN_num_bits(e) - 2; b >= 0; b--) {
+        int ret = BN_mod_mul_montgomery(acc, acc, acc, mont, frame.ctx());
+        if (ret == 1 && BN_is_bit_set(e, b)) {
+            ret = BN_mod_mul_montgomery(acc, acc, x, mont, frame.ctx());
+        }
+        if (ret != 1) {
+            throw std::runtime_error(
+                "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+        }
+    }
+    BN_swap(acc, x);
+}
+
+static_assert(std::is_same<MultiBufferModExp::message_type,
+                           std::array<uint8_t, TdpImpl::kMessageSpaceSize>>::value,
+              "The multi-buffer exponentiation and the TDP message types do "
+              "not match");
+
+// Returns nullptr if the multi-buffer exponentiation cannot be used
+std::shared_ptr<const MultiBufferModExp> make_mb_exp(const BIGNUM* n)
+{
+    if (!MultiBufferModExp::is_available()
+        || static_cast<size_t>(BN_num_bytes(n))
+               != MultiBufferModExp::kModulusSize) {
+        return nullptr;
+    }
+
+    MultiBufferModExp::message_type modulus;
+    BN_bn2bin(n, modulus.data());
+
+    return std::make_shared<const MultiBufferModExp>(modulus);
+}
+
+// Chain of iterated evaluations of the TDP.
+// The current element is kept in Montgomery form between the steps.
+class TdpEvalChain_OpenSSL : public TdpChainImpl
+{
+public:
+    TdpEvalChain_OpenSSL(std::shared_ptr<BN_MONT_CTX>                  mont_n,
+                         const BIGNUM*                                 e,
+                         const std::array<uint8_t, kMessageSpaceSize>& start)
+        : mont_n_(std::move(mont_n)), e_(BN_dup(e)), x_(BN_new())
+    {
+        if (e_ == nullptr || x_ == nullptr
+            || BN_bin2bn(start.data(), static_cast<int>(start.size()), x_)
+                   == nullptr
+            || BN_to_montgomery(x_, x_, mont_n_.get(), thread_bn_ctx())
+                   != 1) {
+            /* LCOV_EXCL_START */
+            BN_free(e_);
+            BN_free(x_);
+            throw std::runtime_error("Unable to initialize the TDP chain");
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    ~TdpEvalChain_OpenSSL() override
+    {
+        BN_free(e_);
+        BN_free(x_);
+    }
+
+    TdpEvalChain_OpenSSL(const TdpEvalChain_OpenSSL&) = delete;
+    TdpEvalChain_OpenSSL& operator=(const TdpEvalChain_OpenSSL&) = delete;
+
+    void advance(uint32_t steps) override
+    {
+        // the public exponent is short and the element is never converted
+        // back to the normal form
+        for (uint32_t i = 0; i < steps; i++) {
+            BnCtxFrame frame;
+            mont_exp_short(x_, e_, mont_n_.get(), frame);
+        }
+    }
+
+    void value(std::array<uint8_t, kMessageSpaceSize>& out) const override
+    {
+        BnCtxFrame frame;
+        BIGNUM*    y = frame.get();
+
+        if (BN_from_montgomery(y, x_, mont_n_.get(), frame.ctx()) != 1) {
+            throw std::runtime_error(
+                "Error while writing the TDP chain element"); /* LCOV_EXCL_LINE
+                                                               */
+        }
+        bn_to_buffer(y, out.data());
+    }
+
+private:
+    std::shared_ptr<BN_MONT_CTX> mont_n_;
+
+    BIGNUM* e_;
+    BIGNUM* x_; // current element, Montgomery form
+};
+
+// Chain of iterated inversions of the TDP.
+// The current element is kept modulo p and modulo q, and the CRT
+// recombination is only done when the element is requested.
+class TdpInvertChain_OpenSSL : public TdpChainImpl
+{
+public:
+    TdpInvertChain_OpenSSL(std::shared_ptr<BN_MONT_CTX> mont_p,
+                           std::shared_ptr<BN_MONT_CTX> mont_q,
+                           const RSA*                   key,
+                           const std::array<uint8_t, kMessageSpaceSize>& start)
+        : mont_p_(std::move(mont_p)), mont_q_(std::move(mont_q)),
+          p_(BN_dup(key->p)), q_(BN_dup(key->q)), dmp1_(BN_dup(key->dmp1)),
+          dmq1_(BN_dup(key->dmq1)), iqmp_(BN_dup(key->iqmp)), y_p_(BN_new()),
+          y_q_(BN_new())
+    {
+        bool success = p_ != nullptr && q_ != nullptr && dmp1_ != nullptr
+                       && dmq1_ != nullptr && iqmp_ != nullptr
+                       && y_p_ != nullptr && y_q_ != nullptr;
+
+        if (success) {
+            BN_set_flags(dmp1_, BN_FLG_CONSTTIME);
+            BN_set_flags(dmq1_, BN_FLG_CONSTTIME);
+
+            BnCtxFrame frame;
+            BIGNUM*    x = frame.get();
+
+            success = BN_bin2bn(start.data(), static_cast<int>(start.size()), x)
+                          != nullptr
+                      && BN_nnmod(y_p_, x, p_, frame.ctx()) == 1
+                      && BN_nnmod(y_q_, x, q_, frame.ctx()) == 1;
+        }
+
+        if (!success) {
+            /* LCOV_EXCL_START */
+            clear();
+            throw std::runtime_error("Unable to initialize the TDP chain");
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    ~TdpInvertChain_OpenSSL() override
+    {
+        clear();
+    }
+
+    TdpInvertChain_OpenSSL(const TdpInvertChain_OpenSSL&) = delete;
+    TdpInvertChain_OpenSSL& operator=(const TdpInvertChain_OpenSSL&) = delete;
+
+    void advance(uint32_t steps) override
+    {
+        BnCtxFrame frame;
+        BIGNUM*    tmp = frame.get();
+
+        for (uint32_t i = 0; i < steps; i++) {
+            int ret = BN_mod_exp_mont_consttime(
+                tmp, y_p_, dmp1_, p_, frame.ctx(), mont_p_.get());
+            BN_swap(tmp, y_p_);
+            if (ret == 1) {
+                ret = BN_mod_exp_mont_consttime(
+                    tmp, y_q_, dmq1_, q_, frame.ctx(), mont_q_.get());
+                BN_swap(tmp, y_q_);
+            }
+            if (ret != 1) {
+                BN_clear(tmp);
+                throw std::runtime_error(
+                    "Error during the modular exponentiation"); /* LCOV_EXCL_LINE
+                                                                 */
+            }
+        }
+        BN_clear(tmp);
+    }
+
+    void value(std::array<uint8_t, kMessageSpaceSize>& out) const override
+    {
+        BnCtxFrame frame;
+        BIGNUM*    h = frame.get();
+        BIGNUM*    y = frame.get();
+
+        int ret = BN_mod_sub(h, y_p_, y_q_, p_, frame.ctx());
+        if (ret == 1) {
+            ret = BN_mod_mul(h, h, iqmp_, p_, frame.ctx());
+        }
+        if (ret == 1) {
+            ret = BN_mul(y, h, q_, frame.ctx());
+        }
+        if (ret == 1) {
+            ret = BN_add(y, y, y_q_);
+        }
+        if (ret == 1) {
+            bn_to_buffer(y, out.data());
+        }
+
+        // the BIGNUMs go back to the thread's BN_CTX pool: erase them
+        BN_clear(h);
+        BN_clear(y);
+
+        if (ret != 1) {
+            throw std::runtime_error(
+                "Error while writing the TDP chain element"); /* LCOV_EXCL_LINE
+                                                               */
+        }
+    }
+
+private:
+    void clear()
+    {
+        BN_free(p_);
+        BN_free(q_);
+        BN_clear_free(dmp1_);
+        BN_clear_free(dmq1_);
+        BN_clear_free(iqmp_);
+        BN_clear_free(y_p_);
+        BN_clear_free(y_q_);
+    }
+
+    std::shared_ptr<BN_MONT_CTX> mont_p_, mont_q_;
+
+    BIGNUM *p_, *q_, *dmp1_, *dmq1_, *iqmp_;
+    BIGNUM *y_p_, *y_q_; // current element, modulo p and q
+};
+
+} // namespace
+
 // OpenSSL implementation of the trapdoor permutation
 
 TdpImpl_OpenSSL::TdpImpl_OpenSSL() = default;
 
 TdpImpl_OpenSSL::TdpImpl_OpenSSL(const std::string& pk) : rsa_key_(nullptr)
 {
+    if (binary_key::has_header(pk, binary_key::kPublicKeyType)) {
+        binary_key::Reader reader(pk, binary_key::kPublicKeyType);
+        RsaKeyPtr          key = new_rsa_key();
+
+        read_public_key(reader, key.get());
+        mont_n_ = make_mont_ctx(key->n);
+        mb_exp_ = make_mb_exp(key->n);
+        set_rsa_key(key.release());
+        return;
+    }
+
     // create a BIO from the std::string
     BIO* mem;
 
@@ -70,9 +523,10 @@ TdpImpl_OpenSSL::TdpImpl_OpenSSL(const std::string& pk) : rsa_key_(nullptr)
 #pragma GCC diagnostic pop
 
     // read the key from the BIO
-    rsa_key_ = PEM_read_bio_RSA_PUBKEY(mem, nullptr, nullptr, nullptr);
+    RsaKeyPtr key(PEM_read_bio_RSA_PUBKEY(mem, nullptr, nullptr, nullptr),
+                  RSA_free);
 
-    if (rsa_key_ == nullptr) {
+    if (!key) {
         BIO_free(mem);
         throw std::runtime_error(
             "Error when initializing the RSA key from public key.");
@@ -85,9 +539,15 @@ TdpImpl_OpenSSL::TdpImpl_OpenSSL(const std::string& pk) : rsa_key_(nullptr)
         // always returns 1 ...
     }
     BIO_free(mem);
+
+    mont_n_ = make_mont_ctx(key->n);
+    mb_exp_ = make_mb_exp(key->n);
+    set_rsa_key(key.release());
 }
 
 TdpImpl_OpenSSL::TdpImpl_OpenSSL(const TdpImpl_OpenSSL& tdp)
+    : mont_n_(tdp.mont_n_), mb_exp_(tdp.mb_exp_),
+      public_key_pem_(tdp.public_key_pem_)
 {
     set_rsa_key(RSAPublicKey_dup(tdp.rsa_key_)); /* LCOV_EXCL_LINE */
 }
@@ -96,6 +556,9 @@ TdpImpl_OpenSSL& TdpImpl_OpenSSL::operator=(const TdpImpl_OpenSSL& t)
 {
     if (this != &t) {
         set_rsa_key(RSAPublicKey_dup(t.rsa_key_)); /* LCOV_EXCL_LINE */
+        mont_n_         = t.mont_n_;
+        mb_exp_         = t.mb_exp_;
+        public_key_pem_ = t.public_key_pem_;
     }
 
     return *this;
@@ -132,42 +595,75 @@ TdpImpl_OpenSSL::~TdpImpl_OpenSSL()
 
 std::string TdpImpl_OpenSSL::public_key() const
 {
-    int ret;
+    return public_key_pem_.get([this]() {
+        int ret;
 
-    // initialize a buffer
-    BIO* bio = BIO_new(BIO_s_mem());
+        // initialize a buffer
+        BIO* bio = BIO_new(BIO_s_mem());
 
-    // write the key to the buffer
-    ret = PEM_write_bio_RSA_PUBKEY(bio, rsa_key_);
+        // write the key to the buffer
+        ret = PEM_write_bio_RSA_PUBKEY(bio, rsa_key_);
 
-    if (ret != 1) {
-        /* LCOV_EXCL_START */
-        BIO_free(bio);
-        throw std::runtime_error("Error when serializing the RSA public key.");
-        /* LCOV_EXCL_START */
-    }
+        if (ret != 1) {
+            /* LCOV_EXCL_START */
+            BIO_free(bio);
+            throw std::runtime_error(
+                "Error when serializing the RSA public key.");
+            /* LCOV_EXCL_START */
+        }
 
 
-    // put the buffer in a std::string
-    size_t len = BIO_ctrl_pending(bio);
-    void*  buf = malloc(len);
+        // put the buffer in a std::string
+        size_t len = BIO_ctrl_pending(bio);
+        void*  buf = malloc(len);
 
-    int read_bytes = BIO_read(bio, buf, static_cast<int>(len));
+        int read_bytes = BIO_read(bio, buf, static_cast<int>(len));
+
+        if (read_bytes == 0) {
+            /* LCOV_EXCL_START */
+            BIO_free(bio);
+            free(buf);
+            throw std::runtime_error("Error when reading BIO.");
+            /* LCOV_EXCL_STOP */
+        }
+
+        std::string v(reinterpret_cast<const char*>(buf), len);
 
-    if (read_bytes == 0) {
-        /* LCOV_EXCL_START */
         BIO_free(bio);
         free(buf);
-        throw std::runtime_error("Error when reading BIO.");
-        /* LCOV_EXCL_STOP */
-    }
 
-    std::string v(reinterpret_cast<const char*>(buf), len);
+        return v;
+    });
+}
+
+std::string TdpImpl_OpenSSL::public_key_binary() const
+{
+    binary_key::Writer writer(binary_key::kPublicKeyType);
 
-    BIO_free(bio);
-    free(buf);
+    write_public_key(writer);
 
-    return v;
+    return writer.release();
+}
+
+void TdpImpl_OpenSSL::read_public_key(binary_key::Reader& reader, RSA* key)
+{
+    key->n = read_bn_field(reader, binary_key::kModulusSize);
+    key->e = read_bn_field(reader, binary_key::kModulusSize);
+    // BN_MONT_CTX_set always computes R^2 mod n by itself
+    reader.next(binary_key::kModulusSize);
+
+    if (BN_is_odd(key->n) == 0 || BN_num_bits(key->n) < 128
+        || BN_is_odd(key->e) == 0 || BN_num_bits(key->e) < 2
+        || BN_cmp(key->e, key->n) >= 0) {
+        throw std::runtime_error("Invalid RSA public key");
+    }
+}
+
+void TdpImpl_OpenSSL::write_public_key(binary_key::Writer& writer) const
+{
+    write_bn_field(writer, rsa_key_->n, binary_key::kModulusSize);
+    write_bn_field(writer, rsa_key_->e, binary_key::kModulusSize);
+    write_rr_field(writer, mont_n_.get(), binary_key::kModulusSize);
 }
 
 void TdpImpl_OpenSSL::eval(const std::string& in, std::string& out) const
@@ -177,14 +673,10 @@ void TdpImpl_OpenSSL::eval(const std::string& in, std::string& out) const
                                     "be kMessageSpaceSize bytes long.");
     }
 
-    std::array<uint8_t, kMessageSpaceSize> in_array;
-
-
-    memcpy(in_array.data(), in.data(), kMessageSpaceSize);
-
-    auto out_array = eval(in_array);
-
-    out = std::string(out_array.begin(), out_array.end());
+    // in and out might be the same string: do not reallocate out
+    out.resize(kMessageSpaceSize);
+    eval_buffer(reinterpret_cast<const uint8_t*>(in.data()),
+                reinterpret_cast<uint8_t*>(&out[0]));
 }
 
 
@@ -193,36 +685,89 @@ std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> TdpImpl_OpenSSL::eval(
 {
     std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> out;
 
+    eval(in, out);
+
+    return out;
+}
 
+void TdpImpl_OpenSSL::eval(const std::array<uint8_t, kMessageSpaceSize>& in,
+                           std::array<uint8_t, kMessageSpaceSize>& out) const
+{
     if (in.size() != rsa_size()) {
         throw std::runtime_error(
             "Invalid TDP input size. Input size should be kMessageSpaceSize "
             "bytes long."); /* LCOV_EXCL_LINE */
     }
 
-    BN_CTX* ctx = BN_CTX_new();
+    eval_buffer(in.data(), out.data());
+}
 
-    BIGNUM* x = BN_new();
-    BN_bin2bn(in.data(), static_cast<unsigned int>(in.size()), x);
+void TdpImpl_OpenSSL::eval_buffer(const uint8_t* in, uint8_t* out) const
+{
+    eval_buffer(in, out, get_rsa_key()->e, 1);
+}
 
-    BIGNUM* y = BN_new();
+void TdpImpl_OpenSSL::eval_buffer(const uint8_t* in,
+                                  uint8_t*       out,
+                                  const BIGNUM*  e,
+                                  uint32_t       iterations) const
+{
+    BnCtxFrame frame;
 
-    BN_mod_exp(y, x, get_rsa_key()->e, get_rsa_key()->n, ctx);
+    BIGNUM* x = frame.get();
 
+    BN_bin2bn(in, static_cast<int>(kMessageSpaceSize), x);
 
-    // bn2bin returns a BIG endian array, so be careful ...
-    size_t pos = kMessageSpaceSize - BN_num_bytes(y);
-    // set the leading bytes to 0
-    std::fill(out.begin(), out.begin() + pos, 0);
-    BN_bn2bin(y, out.data() + pos);
+    if (static_cast<size_t>(BN_num_bits(e)) <= kShortExponentBits) {
+        // the conversion to the Montgomery form reduces the input mod n, in
+        // case we were given an input larger than the RSA modulus
+        if (BN_to_montgomery(x, x, mont_n_.get(), frame.ctx()) != 1) {
+            throw std::runtime_error(
+                "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+        }
+        for (uint32_t i = 0; i < iterations; i++) {
+            mont_exp_short(x, e, mont_n_.get(), frame);
+        }
+        if (BN_from_montgomery(x, x, mont_n_.get(), frame.ctx()) != 1) {
+            throw std::runtime_error(
+                "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+        }
+    } else {
+        // use the precomputed Montgomery context: BN_mod_exp would compute a
+        // new one for every call
+        for (uint32_t i = 0; i < iterations; i++) {
+            if (BN_mod_exp_mont(
+                    x, x, e, get_rsa_key()->n, frame.ctx(), mont_n_.get())
+                != 1) {
+                throw std::runtime_error(
+                    "Error during the modular exponentiation"); /* LCOV_EXCL_LINE
+                                                                 */
+            }
+        }
+    }
 
-    BN_free(y);
-    BN_free(x);
-    BN_CTX_free(ctx);
+    bn_to_buffer(x, out);
+}
 
-    return out;
+
+void TdpImpl_OpenSSL::eval_range(
+    const std::array<uint8_t, kMessageSpaceSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*       out,
+    size_t                                        count) const
+{
+    if (!mb_exp_ || count < MultiBufferModExp::kMinMessages) {
+        TdpImpl::eval_range(in, out, count);
+        return;
+    }
+
+    mb_exp_->mod_exp(in, out, count, bn_to_bytes(get_rsa_key()->e));
 }
 
+TdpChainImpl* TdpImpl_OpenSSL::eval_chain(
+    const std::array<uint8_t, kMessageSpaceSize>& start) const
+{
+    return new TdpEvalChain_OpenSSL(mont_n_, get_rsa_key()->e, start);
+}
 
 std::string TdpImpl_OpenSSL::sample() const
 {
@@ -273,29 +818,41 @@ std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> TdpImpl_OpenSSL::
                    const std::string&           seed) const
 {
     std::array<uint8_t, Tdp::kRSAPrfSize> rnd = prg.prf(seed);
+    std::array<uint8_t, kMessageSpaceSize> out;
 
-    BIGNUM *rnd_bn, *rnd_mod;
-    BN_CTX* ctx = BN_CTX_new();
-
-    rnd_bn = BN_bin2bn(rnd.data(), Tdp::kRSAPrfSize, nullptr);
-
-    // now, take rnd_bn mod N
-    rnd_mod = BN_new();
-
-    BN_mod(rnd_mod, rnd_bn, rsa_key_->n, ctx);
-
+    reduce_range(&rnd, &out, 1);
+    sodium_memzero(rnd.data(), rnd.size());
 
-    std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> out;
-    std::fill(out.begin(), out.end(), 0);
-    size_t offset = kMessageSpaceSize - BN_num_bytes(rnd_mod);
+    return out;
+}
 
-    BN_bn2bin(rnd_mod, out.data() + offset);
+void TdpImpl_OpenSSL::reduce_range(
+    const std::array<uint8_t, Tdp::kRSAPrfSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*      out,
+    size_t                                       count) const
+{
+    BnCtxFrame frame;
+
+    BIGNUM* rnd_bn  = frame.get();
+    BIGNUM* rnd_mod = frame.get();
+
+    for (size_t i = 0; i < count; i++) {
+        // take rnd_bn mod N: the bias is negligible, as rnd_bn is
+        // kStatisticalSecurity bits longer than N
+        if (BN_bin2bn(in[i].data(), Tdp::kRSAPrfSize, rnd_bn) == nullptr
+            || BN_mod(rnd_mod, rnd_bn, rsa_key_->n, frame.ctx()) != 1) {
+            /* LCOV_EXCL_START */
+            BN_clear(rnd_bn);
+            throw std::runtime_error(
+                "Error when reducing the RSA input mod N");
+            /* LCOV_EXCL_STOP */
+        }
 
-    BN_free(rnd_bn);
-    BN_free(rnd_mod);
-    BN_CTX_free(ctx);
+        bn_to_buffer(rnd_mod, out[i].data());
+    }
 
-    return out;
+    BN_clear(rnd_bn);
+    BN_clear(rnd_mod);
 }
 
 std::string TdpImpl_OpenSSL::generate(
@@ -357,45 +914,59 @@ TdpInverseImpl_OpenSSL::TdpInverseImpl_OpenSSL()
 
     BN_CTX_free(ctx);
     BN_free(bne);
+
+    mont_n_ = make_mont_ctx(get_rsa_key()->n);
+    mb_exp_ = make_mb_exp(get_rsa_key()->n);
+    mont_p_ = make_mont_ctx(get_rsa_key()->p);
+    mont_q_ = make_mont_ctx(get_rsa_key()->q);
 }
 
 TdpInverseImpl_OpenSSL::TdpInverseImpl_OpenSSL(const std::string& sk)
 {
-    // create a BIO from the std::string
-    BIO* mem;
+    if (binary_key::has_header(sk, binary_key::kPrivateKeyType)) {
+        read_private_key(sk);
+    } else {
+        // create a BIO from the std::string
+        BIO* mem;
 
-    // Some old implementation OpenSSL declares BIO_new_mem_buf( void *, int)
-    // instead BIO_new_mem_buf( const void *, int)
-    // silence the warning
+        // Some old implementation OpenSSL declares BIO_new_mem_buf( void *,
+        // int) instead BIO_new_mem_buf( const void *, int)
+        // silence the warning
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-qual"
-    mem = BIO_new_mem_buf(
-        const_cast<void*>(reinterpret_cast<const void*>(sk.data())),
-        static_cast<int>(sk.length()));
+        mem = BIO_new_mem_buf(
+            const_cast<void*>(reinterpret_cast<const void*>(sk.data())),
+            static_cast<int>(sk.length()));
 #pragma GCC diagnostic pop
 
 
-    EVP_PKEY* evpkey;
-    evpkey = PEM_read_bio_PrivateKey(mem, nullptr, nullptr, nullptr);
+        EVP_PKEY* evpkey;
+        evpkey = PEM_read_bio_PrivateKey(mem, nullptr, nullptr, nullptr);
 
-    if (evpkey == nullptr) {
-        BIO_free(mem);
-        throw std::runtime_error("Error when reading the RSA private key.");
-    }
+        if (evpkey == nullptr) {
+            BIO_free(mem);
+            throw std::runtime_error(
+                "Error when reading the RSA private key.");
+        }
 
-    // read the key from the BIO
-    set_rsa_key(EVP_PKEY_get1_RSA(evpkey));
-    EVP_PKEY_free(evpkey);
+        // read the key from the BIO
+        set_rsa_key(EVP_PKEY_get1_RSA(evpkey));
+        EVP_PKEY_free(evpkey);
 
 
-    // close and destroy the BIO
-    if (BIO_set_close(mem, BIO_CLOSE)
-        != 1) // So BIO_free() leaves BUF_MEM alone
-    {
-        // always returns 1 ...
-    }
+        // close and destroy the BIO
+        if (BIO_set_close(mem, BIO_CLOSE)
+            != 1) // So BIO_free() leaves BUF_MEM alone
+        {
+            // always returns 1 ...
+        }
 
-    BIO_free(mem);
+        BIO_free(mem);
+
+        mont_n_ = make_mont_ctx(get_rsa_key()->n);
+        mont_p_ = make_mont_ctx(get_rsa_key()->p);
+        mont_q_ = make_mont_ctx(get_rsa_key()->q);
+    }
 
     // initialize the useful variables
     phi_ = BN_new();
@@ -407,6 +978,8 @@ TdpInverseImpl_OpenSSL::TdpInverseImpl_OpenSSL(const std::string& sk)
     BN_CTX* ctx = BN_CTX_new();
     BN_mul(phi_, p_1_, q_1_, ctx);
     BN_CTX_free(ctx);
+
+    mb_exp_ = make_mb_exp(get_rsa_key()->n);
 }
 
 // NOLINTNEXTLINE(modernize-use-equals-default)
@@ -419,77 +992,115 @@ TdpInverseImpl_OpenSSL::~TdpInverseImpl_OpenSSL()
 
 std::string TdpInverseImpl_OpenSSL::private_key() const
 {
-    int ret;
+    return private_key_pem_.get([this]() {
+        int ret;
+
+        // create an EVP encapsulation
+        EVP_PKEY* evpkey = EVP_PKEY_new();
+        ret              = EVP_PKEY_set1_RSA(evpkey, get_rsa_key());
+        if (ret != 1) {
+            /* LCOV_EXCL_START */
+            EVP_PKEY_free(evpkey);
+            throw std::runtime_error("Invalid EVP initialization.");
+            /* LCOV_EXCL_STOP */
+        }
 
-    // create an EVP encapsulation
-    EVP_PKEY* evpkey = EVP_PKEY_new();
-    ret              = EVP_PKEY_set1_RSA(evpkey, get_rsa_key());
-    if (ret != 1) {
-        /* LCOV_EXCL_START */
-        EVP_PKEY_free(evpkey);
-        throw std::runtime_error("Invalid EVP initialization.");
-        /* LCOV_EXCL_STOP */
-    }
+        // initialize a buffer
+        BIO* bio = BIO_new(BIO_s_mem());
+
+        // write the key to the buffer
+        ret = PEM_write_bio_PKCS8PrivateKey(
+            bio, evpkey, nullptr, nullptr, 0, nullptr, nullptr);
+        if (ret != 1) {
+            /* LCOV_EXCL_START */
+            EVP_PKEY_free(evpkey);
+            BIO_free(bio);
+            throw std::runtime_error("Failure when writing private KEY.");
+            /* LCOV_EXCL_STOP */
+        }
 
-    // initialize a buffer
-    BIO* bio = BIO_new(BIO_s_mem());
+        // put the buffer in a std::string
+        size_t len = BIO_ctrl_pending(bio);
+        void*  buf = malloc(len);
 
-    // write the key to the buffer
-    ret = PEM_write_bio_PKCS8PrivateKey(
-        bio, evpkey, nullptr, nullptr, 0, nullptr, nullptr);
-    if (ret != 1) {
-        /* LCOV_EXCL_START */
-        EVP_PKEY_free(evpkey);
-        BIO_free(bio);
-        throw std::runtime_error("Failure when writing private KEY.");
-        /* LCOV_EXCL_STOP */
-    }
+        int read_bytes = BIO_read(bio, buf, static_cast<int>(len));
+        if (read_bytes == 0) {
+            /* LCOV_EXCL_START */
+            EVP_PKEY_free(evpkey);
+            BIO_free(bio);
+            free(buf);
 
-    // put the buffer in a std::string
-    size_t len = BIO_ctrl_pending(bio);
-    void*  buf = malloc(len);
+            throw std::runtime_error("Error when reading BIO.");
+            /* LCOV_EXCL_STOP */
+        }
+
+
+        std::string v(reinterpret_cast<const char*>(buf), len);
 
-    int read_bytes = BIO_read(bio, buf, static_cast<int>(len));
-    if (read_bytes == 0) {
-        /* LCOV_EXCL_START */
         EVP_PKEY_free(evpkey);
-        BIO_free(bio);
+        BIO_free_all(bio);
         free(buf);
 
-        throw std::runtime_error("Error when reading BIO.");
-        /* LCOV_EXCL_STOP */
-    }
+        return v;
+    });
+}
 
+std::string TdpInverseImpl_OpenSSL::private_key_binary() const
+{
+    binary_key::Writer writer(binary_key::kPrivateKeyType);
+    const RSA*         key = get_rsa_key();
+
+    write_public_key(writer);
+    write_bn_field(writer, key->d, binary_key::kModulusSize);
+    write_bn_field(writer, key->p, binary_key::kPrimeSize);
+    write_bn_field(writer, key->q, binary_key::kPrimeSize);
+    write_bn_field(writer, key->dmp1, binary_key::kPrimeSize);
+    write_bn_field(writer, key->dmq1, binary_key::kPrimeSize);
+    write_bn_field(writer, key->iqmp, binary_key::kPrimeSize);
+    write_rr_field(writer, mont_p_.get(), binary_key::kPrimeSize);
+    write_rr_field(writer, mont_q_.get(), binary_key::kPrimeSize);
+
+    return writer.release();
+}
 
-    std::string v(reinterpret_cast<const char*>(buf), len);
+void TdpInverseImpl_OpenSSL::read_private_key(const std::string& sk)
+{
+    binary_key::Reader reader(sk, binary_key::kPrivateKeyType);
+    RsaKeyPtr          key = new_rsa_key();
 
-    EVP_PKEY_free(evpkey);
-    BIO_free_all(bio);
-    free(buf);
+    read_public_key(reader, key.get());
 
-    return v;
+    key->d    = read_bn_field(reader, binary_key::kModulusSize);
+    key->p    = read_bn_field(reader, binary_key::kPrimeSize);
+    key->q    = read_bn_field(reader, binary_key::kPrimeSize);
+    key->dmp1 = read_bn_field(reader, binary_key::kPrimeSize);
+    key->dmq1 = read_bn_field(reader, binary_key::kPrimeSize);
+    key->iqmp = read_bn_field(reader, binary_key::kPrimeSize);
+    // the Montgomery constants of p and q are recomputed by BN_MONT_CTX_set
+
+    if (!check_private_key(key.get())) {
+        throw std::runtime_error("Invalid RSA private key");
+    }
+
+    mont_n_ = make_mont_ctx(key->n);
+    mont_p_ = make_mont_ctx(key->p);
+    mont_q_ = make_mont_ctx(key->q);
+    set_rsa_key(key.release());
 }
 
 
 void TdpInverseImpl_OpenSSL::invert(const std::string& in,
                                     std::string&       out) const
 {
-    int           ret;
-    unsigned char rsa_out[rsa_size()];
-
     if (in.size() != rsa_size()) {
         throw std::invalid_argument("Invalid TDP input size. Input size should "
                                     "be kMessageSpaceSize bytes long.");
     }
 
-    ret = RSA_private_decrypt(static_cast<int>(in.size()),
-                              reinterpret_cast<const unsigned char*>(in.data()),
-                              rsa_out,
-                              get_rsa_key(),
-                              RSA_NO_PADDING);
-
-
-    out = std::string(reinterpret_cast<char*>(rsa_out), ret);
+    // in and out might be the same string: do not reallocate out
+    out.resize(kMessageSpaceSize);
+    invert_buffer(reinterpret_cast<const uint8_t*>(in.data()),
+                  reinterpret_cast<uint8_t*>(&out[0]));
 }
 
 std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> TdpInverseImpl_OpenSSL::
@@ -497,154 +1108,287 @@ std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> TdpInverseImpl_OpenSSL::
 {
     std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> out;
 
-    RSA_private_decrypt(static_cast<int>(in.size()),
-                        static_cast<const unsigned char*>(in.data()),
-                        out.data(),
-                        get_rsa_key(),
-                        RSA_NO_PADDING);
+    invert(in, out);
 
     return out;
 }
 
+void TdpInverseImpl_OpenSSL::invert(
+    const std::array<uint8_t, kMessageSpaceSize>& in,
+    std::array<uint8_t, kMessageSpaceSize>&       out) const
+{
+    invert_buffer(in.data(), out.data());
+}
+
+void TdpInverseImpl_OpenSSL::invert_buffer(const uint8_t* in,
+                                           uint8_t*       out) const
+{
+    // do not use RSA_private_decrypt: it locks the RSA structure to set up
+    // its cached Montgomery contexts, and the concurrent inversions would
+    // contend on that lock
+    crt_buffer(in, out, get_rsa_key()->dmp1, get_rsa_key()->dmq1);
+}
+
 std::array<uint8_t, TdpInverseImpl_OpenSSL::kMessageSpaceSize>
 TdpInverseImpl_OpenSSL::invert_mult(
     const std::array<uint8_t, kMessageSpaceSize>& in,
     uint32_t                                      order) const
 {
-    if (order == 0) {
-        return in;
-    }
-
     std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> out;
 
+    invert_mult(in, out, order);
+
+    return out;
+}
 
+void TdpInverseImpl_OpenSSL::invert_mult(
+    const std::array<uint8_t, kMessageSpaceSize>& in,
+    std::array<uint8_t, kMessageSpaceSize>&       out,
+    uint32_t                                      order) const
+{
     if (in.size() != rsa_size()) {
         throw std::invalid_argument(
             "Invalid TDP input size. Input size should be kMessageSpaceSize "
             "bytes long."); /* LCOV_EXCL_LINE */
     }
 
-    BN_CTX* ctx      = BN_CTX_new();
-    BIGNUM* bn_order = BN_new();
-    BIGNUM* d_p      = BN_new();
-    BIGNUM* d_q      = BN_new();
-    BN_set_word(bn_order, order);
+    invert_mult_buffer(in.data(), out.data(), order);
+}
 
-    BN_mod_exp(d_p, get_rsa_key()->d, bn_order, p_1_, ctx);
-    BN_mod_exp(d_q, get_rsa_key()->d, bn_order, q_1_, ctx);
+void TdpInverseImpl_OpenSSL::invert_mult(const std::string& in,
+                                         std::string&       out,
+                                         uint32_t           order) const
+{
+    if (in.size() != rsa_size()) {
+        throw std::invalid_argument("Invalid TDP input size. Input size should "
+                                    "be kMessageSpaceSize bytes long.");
+    }
 
-    BIGNUM* x = BN_new();
-    BN_bin2bn(in.data(), static_cast<unsigned int>(in.size()), x);
+    // in and out might be the same string: do not reallocate out
+    out.resize(kMessageSpaceSize);
+    invert_mult_buffer(reinterpret_cast<const uint8_t*>(in.data()),
+                       reinterpret_cast<uint8_t*>(&out[0]),
+                       order);
+}
 
-    BIGNUM* y_p = BN_new();
-    BIGNUM* y_q = BN_new();
-    BIGNUM* h   = BN_new();
-    BIGNUM* y   = BN_new();
+void TdpInverseImpl_OpenSSL::invert_mult_buffer(const uint8_t* in,
+                                                uint8_t*       out,
+                                                uint32_t       order) const
+{
+    if (order == 0) {
+        if (in != out) {
+            memcpy(out, in, kMessageSpaceSize);
+        }
+        return;
+    }
 
-    BN_mod_exp(y_p, x, d_p, get_rsa_key()->p, ctx);
-    BN_mod_exp(y_q, x, d_q, get_rsa_key()->q, ctx);
+    std::shared_ptr<const CrtExponents> exps = crt_exponents(order);
 
-    BN_mod_sub(h, y_p, y_q, get_rsa_key()->p, ctx);
-    BN_mod_mul(h, h, get_rsa_key()->iqmp, get_rsa_key()->p, ctx);
+    crt_buffer(in, out, exps->d_p, exps->d_q);
+}
 
-    BN_mul(y, h, get_rsa_key()->q, ctx);
-    BN_add(y, y, y_q);
+void TdpInverseImpl_OpenSSL::crt_buffer(const uint8_t* in,
+                                        uint8_t*       out,
+                                        const BIGNUM*  d_p,
+                                        const BIGNUM*  d_q) const
+{
+    BnCtxFrame frame;
 
+    BIGNUM* x   = frame.get();
+    BIGNUM* x_p = frame.get();
+    BIGNUM* y_p = frame.get();
+    BIGNUM* y_q = frame.get();
+    BIGNUM* h   = frame.get();
+    BIGNUM* y   = frame.get();
 
-    // bn2bin returns a BIG endian array, so be careful ...
-    size_t pos = kMessageSpaceSize - BN_num_bytes(y);
-    // set the leading bytes to 0
-    std::fill(out.begin(), out.begin() + pos, 0);
-    BN_bn2bin(y, out.data() + pos);
-
-    BN_free(bn_order);
-    BN_free(d_p);
-    BN_free(d_q);
-    BN_free(y_p);
-    BN_free(y_q);
-    BN_free(h);
-    BN_free(y);
-    BN_free(x);
-    BN_CTX_free(ctx);
+    BN_CTX* ctx = frame.ctx();
 
-    return out;
+    BN_bin2bn(in, static_cast<int>(kMessageSpaceSize), x);
+
+    int ret = BN_nnmod(x_p, x, get_rsa_key()->p, ctx);
+    if (ret == 1) {
+        ret = BN_mod_exp_mont_consttime(
+            y_p, x_p, d_p, get_rsa_key()->p, ctx, mont_p_.get());
+    }
+    if (ret == 1) {
+        ret = BN_nnmod(x_p, x, get_rsa_key()->q, ctx);
+    }
+    if (ret == 1) {
+        ret = BN_mod_exp_mont_consttime(
+            y_q, x_p, d_q, get_rsa_key()->q, ctx, mont_q_.get());
+    }
+
+    if (ret == 1) {
+        BN_mod_sub(h, y_p, y_q, get_rsa_key()->p, ctx);
+        BN_mod_mul(h, h, get_rsa_key()->iqmp, get_rsa_key()->p, ctx);
+
+        BN_mul(y, h, get_rsa_key()->q, ctx);
+        BN_add(y, y, y_q);
+
+        bn_to_buffer(y, out);
+    }
+
+    // the BIGNUMs go back to the thread's BN_CTX pool: erase the secret
+    // dependent values
+    BN_clear(x_p);
+    BN_clear(y_p);
+    BN_clear(y_q);
+    BN_clear(h);
+
+    if (ret != 1) {
+        throw std::runtime_error(
+            "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+    }
 }
 
-void TdpInverseImpl_OpenSSL::invert_mult(const std::string& in,
-                                         std::string&       out,
-                                         uint32_t           order) const
+TdpInverseImpl_OpenSSL::CrtExponents::CrtExponents()
+    : d_p(BN_new()), d_q(BN_new())
 {
-    std::array<uint8_t, kMessageSpaceSize> in_array;
+    if (d_p == nullptr || d_q == nullptr) {
+        /* LCOV_EXCL_START */
+        BN_free(d_p);
+        BN_free(d_q);
+        throw std::runtime_error("Unable to allocate BIGNUMs");
+        /* LCOV_EXCL_STOP */
+    }
+}
+
+TdpInverseImpl_OpenSSL::CrtExponents::~CrtExponents()
+{
+    BN_clear_free(d_p);
+    BN_clear_free(d_q);
+}
+
+std::shared_ptr<const TdpInverseImpl_OpenSSL::CrtExponents>
+TdpInverseImpl_OpenSSL::crt_exponents(uint32_t order) const
+{
+    std::shared_ptr<const CrtExponents> cached = crt_cache_.get(order);
+    if (cached) {
+        return cached;
+    }
+
+    // compute the exponents outside of the cache lock: two threads might
+    // compute the same exponents concurrently, but only one copy is kept
+    std::shared_ptr<CrtExponents> exps = std::make_shared<CrtExponents>();
+
+    BnCtxFrame frame;
+    BIGNUM*    bn_order = frame.get();
 
-    memcpy(in_array.data(), in.data(), kMessageSpaceSize);
+    BN_set_word(bn_order, order);
+
+    BN_mod_exp(exps->d_p, get_rsa_key()->d, bn_order, p_1_, frame.ctx());
+    BN_mod_exp(exps->d_q, get_rsa_key()->d, bn_order, q_1_, frame.ctx());
 
-    auto out_array = invert_mult(in_array, order);
+    crt_cache_.insert(order, exps);
 
-    out = std::string(out_array.begin(), out_array.end());
+    return exps;
 }
 
+void TdpInverseImpl_OpenSSL::prewarm_invert_mult(uint32_t first_order,
+                                                 uint32_t last_order) const
+{
+    if (first_order > last_order) {
+        throw std::invalid_argument(
+            "Invalid order range: first_order > last_order");
+    }
+
+    // only the last kInvertMultCacheSize orders would stay in the cache
+    if (last_order - first_order >= crt_cache_.capacity()) {
+        first_order = last_order
+                      - static_cast<uint32_t>(crt_cache_.capacity() - 1);
+    }
+
+    // use a 64 bits counter to avoid an overflow when last_order is
+    // UINT32_MAX
+    for (uint64_t order = first_order; order <= last_order; order++) {
+        if (order != 0) {
+            crt_exponents(static_cast<uint32_t>(order));
+        }
+    }
+}
+
+TdpChainImpl* TdpInverseImpl_OpenSSL::invert_chain(
+    const std::array<uint8_t, kMessageSpaceSize>& start) const
+{
+    return new TdpInvertChain_OpenSSL(mont_p_, mont_q_, get_rsa_key(), start);
+}
+
+
+TdpMultPoolImpl_OpenSSL::PoolExponents::PoolExponents(const BIGNUM* e,
+                                                      const uint8_t size)
+    : e_orders(size - 1, nullptr), chained(size_t(size) + 1, false)
+{
+    try {
+        BnCtxFrame frame;
+
+        for (size_t i = 0; i < e_orders.size(); i++) {
+            const BIGNUM* previous = (i == 0) ? e : e_orders[i - 1];
+
+            e_orders[i] = BN_new();
+            if (e_orders[i] == nullptr
+                || BN_mul(e_orders[i], previous, e, frame.ctx()) != 1) {
+                throw std::runtime_error(
+                    "Unable to compute the exponents of the TDP "
+                    "pool"); /* LCOV_EXCL_LINE */
+            }
+        }
+
+        const std::vector<uint8_t> e_bytes = bn_to_bytes(e);
+
+        for (size_t i = 0; i < e_orders.size(); i++) {
+            chained[i + 2]
+                = chained_eval_is_faster(e_bytes,
+                                         bn_to_bytes(e_orders[i]),
+                                         static_cast<unsigned>(i) + 2);
+        }
+    } catch (...) {
+        /* LCOV_EXCL_START */
+        for (BIGNUM* e_order : e_orders) {
+            BN_free(e_order);
+        }
+        throw;
+        /* LCOV_EXCL_STOP */
+    }
+}
+
+TdpMultPoolImpl_OpenSSL::PoolExponents::~PoolExponents()
+{
+    for (BIGNUM* e_order : e_orders) {
+        BN_free(e_order);
+    }
+}
 
 TdpMultPoolImpl_OpenSSL::TdpMultPoolImpl_OpenSSL(const std::string& sk,
                                                  const uint8_t      size)
-    : TdpImpl_OpenSSL(sk), keys_count_(size - 1)
+    : TdpImpl_OpenSSL(sk)
 {
     if (size == 0) {
         throw std::invalid_argument(
             "Invalid Multiple TDP pool input size. Pool size should be > 0.");
     }
 
-    keys_ = new RSA*[keys_count_];
-
-    keys_[0] = RSAPublicKey_dup(get_rsa_key());
-    BN_mul_word(keys_[0]->e, RSA_PK);
-
-    for (uint8_t i = 1; i < keys_count_; i++) {
-        keys_[i] = RSAPublicKey_dup(keys_[i - 1]);
-        BN_mul_word(keys_[i]->e, RSA_PK);
-    }
+    // As all the keys of the pool share the same modulus, only the public
+    // exponents are stored. They are not bounded by the modulus.
+    exponents_ = std::make_shared<const PoolExponents>(get_rsa_key()->e, size);
 }
 
 TdpMultPoolImpl_OpenSSL::TdpMultPoolImpl_OpenSSL(
     const TdpMultPoolImpl_OpenSSL& pool_impl)
-    : TdpImpl_OpenSSL(pool_impl), keys_count_(pool_impl.keys_count_)
+    : TdpImpl_OpenSSL(pool_impl), exponents_(pool_impl.exponents_)
 {
-    keys_ = new RSA*[keys_count_];
-
-    for (uint8_t i = 0; i < keys_count_; i++) {
-        keys_[i] = RSAPublicKey_dup(pool_impl.keys_[i]);
-    }
 }
 
 TdpMultPoolImpl_OpenSSL& TdpMultPoolImpl_OpenSSL::operator=(
     const TdpMultPoolImpl_OpenSSL& t)
 {
     if (this != &t) {
-        for (uint8_t i = 0; i < keys_count_; i++) {
-            RSA_free(keys_[i]);
-        }
-
-        if (keys_count_ != t.keys_count_) {
-            // realloc the key array
-            delete[] keys_;
-            keys_count_ = t.keys_count_;
-            keys_       = new RSA*[keys_count_];
-        }
-
-        for (uint8_t i = 0; i < keys_count_; i++) {
-            keys_[i] = RSAPublicKey_dup(t.keys_[i]);
-        }
+        TdpImpl_OpenSSL::operator=(t);
+        exponents_ = t.exponents_;
     }
     return *this;
 }
 
-
-TdpMultPoolImpl_OpenSSL::~TdpMultPoolImpl_OpenSSL()
-{
-    for (uint8_t i = 0; i < keys_count_; i++) {
-        RSA_free(keys_[i]);
-    }
-    delete[] keys_;
-}
+TdpMultPoolImpl_OpenSSL::~TdpMultPoolImpl_OpenSSL() = default;
 
 std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize>
 TdpMultPoolImpl_OpenSSL::eval_pool(
@@ -653,28 +1397,23 @@ TdpMultPoolImpl_OpenSSL::eval_pool(
 {
     std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> out;
 
-    if (order == 1) {
-        // regular eval
-        RSA_public_encrypt(static_cast<int>(in.size()),
-                           static_cast<const unsigned char*>(in.data()),
-                           out.data(),
-                           get_rsa_key(),
-                           RSA_NO_PADDING);
-
-    } else if (order <= maximum_order()) {
-        // get the right RSA context, i.e. the one in keys_[order-1]
-        RSA_public_encrypt(static_cast<int>(in.size()),
-                           static_cast<const unsigned char*>(in.data()),
-                           out.data(),
-                           keys_[order - 2],
-                           RSA_NO_PADDING);
-    } else {
+    if (order == 0 || order > maximum_order()) {
         throw std::invalid_argument(
             "Invalid order for this TDP pool. The input order must be less "
             "than the maximum order supported by the pool, and strictly "
             "positive.");
     }
 
+    // all the exponents of the pool share the same modulus
+    if (order == 1) {
+        // regular eval
+        eval_buffer(in.data(), out.data());
+    } else if (exponents_->chained[order]) {
+        eval_buffer(in.data(), out.data(), get_rsa_key()->e, order);
+    } else {
+        eval_buffer(in.data(), out.data(), exponents_->e_orders[order - 2], 1);
+    }
+
     return out;
 }
 
@@ -698,7 +1437,7 @@ void TdpMultPoolImpl_OpenSSL::eval_pool(const std::string& in,
 
 uint8_t TdpMultPoolImpl_OpenSSL::maximum_order() const
 {
-    return keys_count_ + 1;
+    return static_cast<uint8_t>(exponents_->e_orders.size() + 1);
 }
 
 } // namespace crypto
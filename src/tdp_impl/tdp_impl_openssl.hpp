@@ -23,6 +23,9 @@
 
 #ifdef WITH_OPENSSL
 
+#include "exponent_cache.hpp"
+#include "key_encoding.hpp"
+#include "multi_buffer_mod_exp.hpp"
 #include "tdp_impl.hpp"
 
 #include <sse/crypto/key.hpp>
@@ -31,8 +34,11 @@
 #include <cstdint>
 
 #include <array>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include <openssl/bn.h>
 #include <openssl/rsa.h>
 
 namespace sse {
@@ -53,10 +59,16 @@ public:
     size_t rsa_size() const override;
 
     std::string public_key() const override;
+    std::string public_key_binary() const override;
 
     void eval(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> eval(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void eval(const std::array<uint8_t, kMessageSpaceSize>& in,
+              std::array<uint8_t, kMessageSpaceSize>&       out) const override;
+
+    TdpChainImpl* eval_chain(
+        const std::array<uint8_t, kMessageSpaceSize>& start) const override;
 
     std::string                            sample() const override;
     std::array<uint8_t, kMessageSpaceSize> sample_array() const override;
@@ -75,8 +87,44 @@ public:
 protected:
     TdpImpl_OpenSSL();
 
+    // Evaluate the TDP on the kMessageSpaceSize bytes pointed by in and write
+    // the result to out. in and out may alias.
+    void eval_buffer(const uint8_t* in, uint8_t* out) const;
+    // Same as above, with the public exponent e, applied iterations times
+    // (used by the TDP pool, whose keys share the same modulus)
+    void eval_buffer(const uint8_t* in,
+                     uint8_t*       out,
+                     const BIGNUM*  e,
+                     uint32_t       iterations) const;
+
+    void eval_range(const std::array<uint8_t, kMessageSpaceSize>* in,
+                    std::array<uint8_t, kMessageSpaceSize>*       out,
+                    size_t count) const override;
+
+    void reduce_range(const std::array<uint8_t, Tdp::kRSAPrfSize>* in,
+                      std::array<uint8_t, kMessageSpaceSize>*      out,
+                      size_t count) const override;
+
+    // Read (resp. write) the public fields of a binary key: n, e and
+    // R^2 mod n. read_public_key sets the fields of key, and skips R^2 mod n.
+    static void read_public_key(binary_key::Reader& reader, RSA* key);
+    void write_public_key(binary_key::Writer& writer) const;
+
     // cppcheck-suppress constStatement
     RSA* rsa_key_{nullptr};
+
+    // Montgomery context for the modulus n. It is never modified after its
+    // initialization, and is shared between the copies of the TDP and the
+    // evaluation chains.
+    std::shared_ptr<BN_MONT_CTX> mont_n_;
+
+    // Vectorized exponentiation engine used by eval_range (nullptr if the
+    // CPU does not support it)
+    std::shared_ptr<const MultiBufferModExp> mb_exp_;
+
+    // PEM encoding of the public key, computed on the first call to
+    // public_key()
+    SerializedKeyCache public_key_pem_;
 };
 
 class TdpInverseImpl_OpenSSL : public TdpImpl_OpenSSL,
@@ -92,9 +140,12 @@ public:
     TdpInverseImpl_OpenSSL& operator=(const TdpInverseImpl_OpenSSL& t) = delete;
 
     std::string private_key() const override;
+    std::string private_key_binary() const override;
     void        invert(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> invert(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void invert(const std::array<uint8_t, kMessageSpaceSize>& in,
+                std::array<uint8_t, kMessageSpaceSize>& out) const override;
 
     std::array<uint8_t, kMessageSpaceSize> invert_mult(
         const std::array<uint8_t, kMessageSpaceSize>& in,
@@ -102,9 +153,64 @@ public:
     void invert_mult(const std::string& in,
                      std::string&       out,
                      uint32_t           order) const override;
+    void invert_mult(const std::array<uint8_t, kMessageSpaceSize>& in,
+                     std::array<uint8_t, kMessageSpaceSize>&       out,
+                     uint32_t order) const override;
+
+    void prewarm_invert_mult(uint32_t first_order,
+                             uint32_t last_order) const override;
+
+    TdpChainImpl* invert_chain(
+        const std::array<uint8_t, kMessageSpaceSize>& start) const override;
 
 private:
+    // CRT exponents used by invert_mult: d_p^order mod (p-1) and
+    // d_q^order mod (q-1). They are erased on destruction.
+    struct CrtExponents
+    {
+        CrtExponents();
+        ~CrtExponents();
+
+        CrtExponents(const CrtExponents&) = delete;
+        CrtExponents& operator=(const CrtExponents&) = delete;
+
+        BIGNUM* d_p;
+        BIGNUM* d_q;
+    };
+
+    // Get the CRT exponents for order from the cache, or compute them (and
+    // cache them) if needed
+    std::shared_ptr<const CrtExponents> crt_exponents(uint32_t order) const;
+
+    // Raw buffer versions of the inversion functions. in and out must point
+    // to kMessageSpaceSize bytes and may alias.
+    void invert_buffer(const uint8_t* in, uint8_t* out) const;
+    void invert_mult_buffer(const uint8_t* in,
+                            uint8_t*       out,
+                            uint32_t       order) const;
+
+    // CRT exponentiation with the exponents d_p and d_q
+    void crt_buffer(const uint8_t* in,
+                    uint8_t*       out,
+                    const BIGNUM*  d_p,
+                    const BIGNUM*  d_q) const;
+
+    // Set rsa_key_ and the Montgomery contexts from a binary private key.
+    // The consistency of the private fields is checked, but not the
+    // primality of p and q.
+    void read_private_key(const std::string& sk);
+
     BIGNUM *phi_, *p_1_, *q_1_;
+
+    // Montgomery contexts for the primes p and q
+    std::shared_ptr<BN_MONT_CTX> mont_p_, mont_q_;
+
+    // PEM encoding of the private key, computed on the first call to
+    // private_key()
+    SerializedKeyCache private_key_pem_;
+
+    ExponentCache<CrtExponents> crt_cache_{
+        TdpInverse::kInvertMultCacheSize};
 };
 
 class TdpMultPoolImpl_OpenSSL : public TdpImpl_OpenSSL,
@@ -128,9 +234,25 @@ public:
     uint8_t maximum_order() const override;
 
 private:
-    RSA** keys_;
+    // Precomputations of the pool. They are immutable, and shared between
+    // the copies of the pool.
+    struct PoolExponents
+    {
+        PoolExponents(const BIGNUM* e, uint8_t size);
+        ~PoolExponents();
+
+        PoolExponents(const PoolExponents&) = delete;
+        PoolExponents& operator=(const PoolExponents&) = delete;
+
+        // e_orders[i] = e^(i+2)
+        std::vector<BIGNUM*> e_orders;
+
+        // chained[order] is true if the evaluation at this order is faster
+        // as order successive evaluations than with e^order
+        std::vector<bool> chained;
+    };
 
-    uint8_t keys_count_;
+    std::shared_ptr<const PoolExponents> exponents_;
 };
 
 
@@ -0,0 +1,176 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace sse {
+namespace crypto {
+
+namespace {
+thread_local bool is_pool_worker = false;
+} // namespace
+
+ThreadPool::ThreadPool(size_t n_threads)
+{
+    workers_.reserve(n_threads);
+    for (size_t i = 0; i < n_threads; i++) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& w : workers_) {
+        w.join();
+    }
+}
+
+size_t ThreadPool::size() const
+{
+    return workers_.size();
+}
+
+std::future<void> ThreadPool::enqueue(std::function<void()> task)
+{
+    std::packaged_task<void()> p_task(std::move(task));
+    std::future<void>          res = p_task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        tasks_.push(std::move(p_task));
+    }
+    cv_.notify_one();
+
+    return res;
+}
+
+bool ThreadPool::in_worker()
+{
+    return is_pool_worker;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    // the calling thread of parallel_for also does its share of the work
+    static ThreadPool pool(std::max(hardware_thread_count(), 2U) - 1);
+    return pool;
+}
+
+void ThreadPool::worker_loop()
+{
+    is_pool_worker = true;
+
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+
+            if (stop_ && tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        // exceptions are stored in the task's future
+        task();
+    }
+}
+
+unsigned int hardware_thread_count()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return (n == 0) ? 1 : n;
+}
+
+void parallel_for(size_t                                    count,
+                  unsigned int                              n_threads,
+                  const std::function<void(size_t, size_t)>& fn)
+{
+    if (n_threads == 0) {
+        n_threads = hardware_thread_count();
+    }
+    size_t n_ranges = std::min(static_cast<size_t>(n_threads), count);
+
+    if (n_ranges <= 1 || ThreadPool::in_worker()) {
+        if (count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(n_ranges - 1);
+
+    // the first count % n_ranges ranges get one more element
+    const size_t range_size = count / n_ranges;
+    const size_t remainder  = count % n_ranges;
+
+    size_t begin = 0;
+    for (size_t i = 0; i < n_ranges; i++) {
+        size_t end = begin + range_size + ((i < remainder) ? 1 : 0);
+
+        if (i + 1 < n_ranges) {
+            futures.push_back(pool.enqueue([&fn, begin, end]() { fn(begin, end); }));
+        } else {
+            // the last range is processed by the calling thread
+            std::exception_ptr local_exception;
+            try {
+                fn(begin, end);
+            } catch (...) {
+                local_exception = std::current_exception();
+            }
+
+            // wait for all the ranges before rethrowing: fn's captures must
+            // outlive the tasks
+            std::exception_ptr first_exception;
+            for (auto& f : futures) {
+                try {
+                    f.get();
+                } catch (...) {
+                    if (!first_exception) {
+                        first_exception = std::current_exception();
+                    }
+                }
+            }
+            if (!first_exception) {
+                first_exception = local_exception;
+            }
+            if (first_exception) {
+                std::rethrow_exception(first_exception);
+            }
+        }
+        begin = end;
+    }
+}
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,93 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace sse {
+namespace crypto {
+
+/// @class ThreadPool
+/// @brief Fixed size pool of worker threads, used internally to parallelize
+/// the batch operations.
+///
+/// The workers are long lived, so that the per-thread contexts of the
+/// cryptographic backends (thread_local BN_CTX, mbedTLS scratch spaces, ...)
+/// are reused from one batch to the next.
+///
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t n_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// @brief Number of worker threads
+    size_t size() const;
+
+    /// @brief Schedule a task. The returned future holds the exception
+    /// thrown by the task, if any.
+    std::future<void> enqueue(std::function<void()> task);
+
+    /// @brief Returns true if the calling thread is a worker of a ThreadPool
+    static bool in_worker();
+
+    /// @brief Process-wide pool, used by parallel_for
+    static ThreadPool& shared();
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread>               workers_;
+    std::queue<std::packaged_task<void()>> tasks_;
+    std::mutex                             mtx_;
+    std::condition_variable                cv_;
+    bool                                   stop_{false};
+};
+
+/// @brief Number of hardware threads (at least 1)
+unsigned int hardware_thread_count();
+
+/// @brief Split [0, count) in n_threads contiguous ranges and call
+/// fn(begin, end) on each of them concurrently.
+///
+/// One of the ranges is processed by the calling thread, the others by the
+/// shared ThreadPool. If n_threads is 0, hardware_thread_count() is used. When
+/// called from a worker of a pool, everything runs on the calling thread (to
+/// avoid deadlocks). If several calls to fn throw, the first exception is
+/// rethrown once all the ranges are done.
+///
+void parallel_for(size_t                                    count,
+                  unsigned int                              n_threads,
+                  const std::function<void(size_t, size_t)>& fn);
+
+} // namespace crypto
+} // namespace sse
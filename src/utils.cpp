@@ -28,14 +28,39 @@
 #include <sodium/core.h>
 
 #ifdef WITH_OPENSSL
-
 #include <openssl/crypto.h>
+
+// OpenSSL 1.1.0 and later versions do their own locking: the locking
+// callbacks are only needed (and only installed) with older versions.
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define SSE_CRYPTO_OPENSSL_LOCKING_CALLBACKS
+#endif
+#endif
+
+#ifdef SSE_CRYPTO_OPENSSL_LOCKING_CALLBACKS
+
+// OpenSSL tells whether it needs a lock for reading or for writing: use
+// read/write locks so that the readers of a same shared structure (e.g. the
+// error strings or the engine tables) do not contend with each other.
+// Note that the TDP implementation does not take any OpenSSL lock when
+// evaluating or inverting the permutation.
 struct CRYPTO_dynlock_value
 {
-    pthread_mutex_t mutex;
+    pthread_rwlock_t lock;
 };
 
-static pthread_mutex_t* mutex_buf = nullptr;
+static pthread_rwlock_t* lock_buf = nullptr;
+
+static void rwlock_lock(pthread_rwlock_t* lock, int mode)
+{
+    if ((mode & CRYPTO_LOCK) == 0) {
+        pthread_rwlock_unlock(lock);
+    } else if ((mode & CRYPTO_READ) != 0) {
+        pthread_rwlock_rdlock(lock);
+    } else {
+        pthread_rwlock_wrlock(lock);
+    }
+}
 
 /**
  * OpenSSL locking function.
@@ -51,11 +76,7 @@ static void locking_function(int                                 mode,
                              __attribute__((unused)) const char* file,
                              __attribute__((unused)) int         line)
 {
-    if ((mode & CRYPTO_LOCK) != 0) {
-        pthread_mutex_lock(&mutex_buf[n]);
-    } else {
-        pthread_mutex_unlock(&mutex_buf[n]);
-    }
+    rwlock_lock(&lock_buf[n], mode);
 }
 
 /**
@@ -87,7 +108,7 @@ static struct CRYPTO_dynlock_value* dyn_create_function(
     if (value == nullptr) {
         goto err;
     }
-    pthread_mutex_init(&value->mutex, nullptr);
+    pthread_rwlock_init(&value->lock, nullptr);
 
     return value;
 
@@ -109,11 +130,7 @@ static void dyn_lock_function(int                                 mode,
                               __attribute__((unused)) const char* file,
                               __attribute__((unused)) int         line)
 {
-    if ((mode & CRYPTO_LOCK) != 0) {
-        pthread_mutex_lock(&l->mutex);
-    } else {
-        pthread_mutex_unlock(&l->mutex);
-    }
+    rwlock_lock(&l->lock, mode);
 }
 
 /**
@@ -129,7 +146,7 @@ static void dyn_destroy_function(struct CRYPTO_dynlock_value*        l,
                                  __attribute__((unused)) const char* file,
                                  __attribute__((unused)) int         line)
 {
-    pthread_mutex_destroy(&l->mutex);
+    pthread_rwlock_destroy(&l->lock);
     free(l);
 }
 
@@ -144,17 +161,17 @@ static relicxx::relicResourceHandle* __relic_handle;
 
 static int init_locks()
 {
-#ifdef WITH_OPENSSL
+#ifdef SSE_CRYPTO_OPENSSL_LOCKING_CALLBACKS
     int i;
 
     /* static locks area */
-    mutex_buf = static_cast<pthread_mutex_t*>(
-        malloc(CRYPTO_num_locks() * sizeof(pthread_mutex_t)));
-    if (mutex_buf == nullptr) {
+    lock_buf = static_cast<pthread_rwlock_t*>(
+        malloc(CRYPTO_num_locks() * sizeof(pthread_rwlock_t)));
+    if (lock_buf == nullptr) {
         return (-1);
     }
     for (i = 0; i < CRYPTO_num_locks(); i++) {
-        pthread_mutex_init(&mutex_buf[i], nullptr);
+        pthread_rwlock_init(&lock_buf[i], nullptr);
     }
     /* static locks callbacks */
     CRYPTO_set_locking_callback(locking_function);
@@ -169,11 +186,11 @@ static int init_locks()
 
 static int kill_locks()
 {
-#ifdef WITH_OPENSSL
+#ifdef SSE_CRYPTO_OPENSSL_LOCKING_CALLBACKS
 
     int i;
 
-    if (mutex_buf == nullptr) {
+    if (lock_buf == nullptr) {
         return (0);
     }
 
@@ -185,10 +202,10 @@ static int kill_locks()
     CRYPTO_set_id_callback(nullptr);
 
     for (i = 0; i < CRYPTO_num_locks(); i++) {
-        pthread_mutex_destroy(&mutex_buf[i]);
+        pthread_rwlock_destroy(&lock_buf[i]);
     }
-    free(mutex_buf);
-    mutex_buf = nullptr;
+    free(lock_buf);
+    lock_buf = nullptr;
 #endif
     return 0;
 }
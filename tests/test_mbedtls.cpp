@@ -28,6 +28,11 @@
 
 #include <sse/crypto/random.hpp>
 
+#include <cstring>
+
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #ifdef WITH_OPENSSL
@@ -280,6 +285,196 @@ cleanup:
     ASSERT_EQ(ret, 0);
 }
 
+TEST(mbedTLS, montgomery)
+{
+    int                      ret = 0;
+    mbedtls_mpi              N, E, a, b, c, a_mont;
+    mbedtls_mpi_mont_ctx     ctx, ctx_copy;
+    mbedtls_mpi_mont_scratch scratch;
+
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&E);
+    mbedtls_mpi_init(&a);
+    mbedtls_mpi_init(&b);
+    mbedtls_mpi_init(&c);
+    mbedtls_mpi_init(&a_mont);
+    mbedtls_mpi_mont_init(&ctx);
+    mbedtls_mpi_mont_init(&ctx_copy);
+    mbedtls_mpi_mont_scratch_init(&scratch);
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_string(&N, 16, RSA_N));
+
+    // even moduli are not supported
+    ASSERT_EQ(mbedtls_mpi_mont_setup(&ctx, &E), MBEDTLS_ERR_MPI_BAD_INPUT_DATA);
+
+    ASSERT_MPI(mbedtls_mpi_mont_setup(&ctx, &N));
+    ASSERT_MPI(mbedtls_mpi_mont_copy(&ctx_copy, &ctx));
+
+    for (size_t t_count = 0; t_count < MBED_RSA_TEST_COUNT; t_count++) {
+        ASSERT_MPI(
+            mbedtls_mpi_fill_random(&a, KEY_LEN, mbedTLS_rng_wrap, NULL));
+        ASSERT_MPI(
+            mbedtls_mpi_fill_random(&E, KEY_LEN / 2, mbedTLS_rng_wrap, NULL));
+
+        // conversions: the input does not need to be reduced
+        ASSERT_MPI(mbedtls_mpi_mont_to(&a_mont, &a, &ctx, &scratch));
+        ASSERT_MPI(mbedtls_mpi_mont_from(&b, &a_mont, &ctx_copy, &scratch));
+        ASSERT_MPI(mbedtls_mpi_mod_mpi(&c, &a, &N));
+        ASSERT_EQ(mbedtls_mpi_cmp_mpi(&b, &c), 0);
+
+        // exponentiation, compared to mbedtls_mpi_exp_mod
+        ASSERT_MPI(mbedtls_mpi_mont_exp(&b, &a_mont, &E, &ctx, &scratch));
+        ASSERT_MPI(mbedtls_mpi_mont_from(&b, &b, &ctx, &scratch));
+        ASSERT_MPI(mbedtls_mpi_exp_mod(&c, &a, &E, &N, NULL));
+        ASSERT_EQ(mbedtls_mpi_cmp_mpi(&b, &c), 0);
+
+        // in place exponentiation
+        ASSERT_MPI(
+            mbedtls_mpi_mont_exp(&a_mont, &a_mont, &E, &ctx_copy, &scratch));
+        ASSERT_MPI(mbedtls_mpi_mont_from(&b, &a_mont, &ctx, &scratch));
+        ASSERT_EQ(mbedtls_mpi_cmp_mpi(&b, &c), 0);
+    }
+
+    // short exponents (square-and-multiply)
+    for (mbedtls_mpi_sint e : {1, 2, 3, 0x10001, (1 << 23) - 1, 1 << 23}) {
+        ASSERT_MPI(mbedtls_mpi_lset(&E, e));
+        ASSERT_MPI(mbedtls_mpi_mont_exp(&b, &a_mont, &E, &ctx, &scratch));
+        ASSERT_MPI(mbedtls_mpi_mont_from(&b, &b, &ctx, &scratch));
+        ASSERT_MPI(mbedtls_mpi_mont_from(&a, &a_mont, &ctx, &scratch));
+        ASSERT_MPI(mbedtls_mpi_exp_mod(&c, &a, &E, &N, NULL));
+        ASSERT_EQ(mbedtls_mpi_cmp_mpi(&b, &c), 0);
+    }
+
+    // x^0 = 1
+    ASSERT_MPI(mbedtls_mpi_lset(&E, 0));
+    ASSERT_MPI(mbedtls_mpi_mont_exp(&b, &a_mont, &E, &ctx, &scratch));
+    ASSERT_MPI(mbedtls_mpi_mont_from(&b, &b, &ctx, &scratch));
+    ASSERT_EQ(mbedtls_mpi_cmp_int(&b, 1), 0);
+
+    // negative exponents are not supported
+    ASSERT_MPI(mbedtls_mpi_lset(&E, -1));
+    ASSERT_EQ(mbedtls_mpi_mont_exp(&b, &a_mont, &E, &ctx, &scratch),
+              MBEDTLS_ERR_MPI_BAD_INPUT_DATA);
+
+cleanup:
+    mbedtls_mpi_free(&N);
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&a);
+    mbedtls_mpi_free(&b);
+    mbedtls_mpi_free(&c);
+    mbedtls_mpi_free(&a_mont);
+    mbedtls_mpi_mont_free(&ctx);
+    mbedtls_mpi_mont_free(&ctx_copy);
+    mbedtls_mpi_mont_scratch_free(&scratch);
+    ASSERT_EQ(ret, 0);
+}
+
+// Compare mbedtls_mpi_exp_mod to a naive square-and-multiply, for moduli of
+// every size up to 40 limbs (this covers the unrolled and the remainder loops
+// of the multiplication helpers, and the squaring code)
+TEST(mbedTLS, exp_mod_sizes)
+{
+    mbedtls_mpi N, E, a, b, c, tmp;
+
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&E);
+    mbedtls_mpi_init(&a);
+    mbedtls_mpi_init(&b);
+    mbedtls_mpi_init(&c);
+    mbedtls_mpi_init(&tmp);
+
+    for (size_t limbs = 1; limbs <= 40; limbs++) {
+        const size_t len = limbs * sizeof(mbedtls_mpi_uint);
+
+        ASSERT_MPI(mbedtls_mpi_fill_random(&N, len, mbedTLS_rng_wrap, NULL));
+        ASSERT_MPI(mbedtls_mpi_set_bit(&N, 0, 1));
+        ASSERT_MPI(mbedtls_mpi_set_bit(&N, 8 * len - 1, 1));
+        ASSERT_MPI(mbedtls_mpi_fill_random(&E, 16, mbedTLS_rng_wrap, NULL));
+
+        for (int i = 0; i < 3; i++) {
+            if (i == 0) {
+                ASSERT_MPI(
+                    mbedtls_mpi_fill_random(&a, len, mbedTLS_rng_wrap, NULL));
+                ASSERT_MPI(mbedtls_mpi_mod_mpi(&a, &a, &N));
+            } else if (i == 1) {
+                // all the limbs of N - 1 are (almost) saturated
+                ASSERT_MPI(mbedtls_mpi_sub_int(&a, &N, 1));
+            } else {
+                ASSERT_MPI(mbedtls_mpi_lset(&a, 0));
+            }
+
+            ASSERT_MPI(mbedtls_mpi_exp_mod(&b, &a, &E, &N, NULL));
+
+            ASSERT_MPI(mbedtls_mpi_lset(&c, 1));
+            for (size_t j = mbedtls_mpi_bitlen(&E); j > 0; j--) {
+                ASSERT_MPI(mbedtls_mpi_mul_mpi(&tmp, &c, &c));
+                ASSERT_MPI(mbedtls_mpi_mod_mpi(&c, &tmp, &N));
+                if (mbedtls_mpi_get_bit(&E, j - 1) == 1) {
+                    ASSERT_MPI(mbedtls_mpi_mul_mpi(&tmp, &c, &a));
+                    ASSERT_MPI(mbedtls_mpi_mod_mpi(&c, &tmp, &N));
+                }
+            }
+            ASSERT_EQ(mbedtls_mpi_cmp_mpi(&b, &c), 0);
+        }
+    }
+
+    mbedtls_mpi_free(&N);
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&a);
+    mbedtls_mpi_free(&b);
+    mbedtls_mpi_free(&c);
+    mbedtls_mpi_free(&tmp);
+}
+
+// The limb arrays are recycled (see MBEDTLS_MPI_LIMB_POOL): check that the
+// grown MPIs are always zero, including when their arrays were allocated by
+// another thread
+TEST(mbedTLS, limb_pool)
+{
+    const size_t kSizes[] = {1, 3, 16, 17, 32, 33, 130, 256, 257, 1000};
+    const size_t kCount   = 2 * MBEDTLS_MPI_POOL_DEPTH;
+
+    std::vector<mbedtls_mpi> mpis(kCount);
+
+    for (size_t n : kSizes) {
+        // allocate and fill the MPIs in another thread
+        std::thread t([&mpis, n]() {
+            for (mbedtls_mpi& x : mpis) {
+                mbedtls_mpi_init(&x);
+                ASSERT_MPI(mbedtls_mpi_grow(&x, n));
+                memset(x.p, 0xFF, n * sizeof(mbedtls_mpi_uint));
+            }
+        });
+        t.join();
+
+        // release them in this thread, and allocate them again
+        for (mbedtls_mpi& x : mpis) {
+            mbedtls_mpi_free(&x);
+        }
+        for (mbedtls_mpi& x : mpis) {
+            ASSERT_MPI(mbedtls_mpi_grow(&x, n));
+            for (size_t i = 0; i < n; i++) {
+                ASSERT_EQ(x.p[i], 0);
+            }
+            memset(x.p, 0xFF, n * sizeof(mbedtls_mpi_uint));
+        }
+
+        // shrinking and growing keep the value
+        ASSERT_MPI(mbedtls_mpi_shrink(&mpis[0], 1));
+        ASSERT_EQ(mpis[0].n, n);
+        ASSERT_MPI(mbedtls_mpi_grow(&mpis[0], 2 * n));
+        ASSERT_EQ(mbedtls_mpi_bitlen(&mpis[0]),
+                  8 * n * sizeof(mbedtls_mpi_uint));
+        for (size_t i = n; i < 2 * n; i++) {
+            ASSERT_EQ(mpis[0].p[i], 0);
+        }
+
+        for (mbedtls_mpi& x : mpis) {
+            mbedtls_mpi_free(&x);
+        }
+    }
+}
+
 TEST(mbedTLS, key_serialization)
 {
     int                 ret = 0;
@@ -26,6 +26,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -124,6 +125,39 @@ static sse::crypto::tag_type test_encryption_tag(uint64_t i)
     return tag;
 }
 
+// Encryptor built from the test master key, and a key punctured on
+// test_punctured_tag(0), ..., test_punctured_tag(p_count - 1), with a share
+// per call to inc_puncture
+struct PuncturedTestKey
+{
+    std::unique_ptr<sse::crypto::PuncturableEncryption> encryptor;
+    sse::crypto::punct::punctured_key_type               punctured_key;
+};
+
+static PuncturedTestKey punctured_test_key(
+    const size_t                                p_count,
+    const sse::crypto::punct::ScalarDerivation derivation
+    = sse::crypto::punct::ScalarDerivation::kLabeledPrf)
+{
+    std::array<uint8_t, 32> master_key;
+    for (size_t i = 0; i < master_key.size(); i++) {
+        master_key[i] = 1 << i;
+    }
+
+    PuncturedTestKey test_key;
+    test_key.encryptor.reset(new sse::crypto::PuncturableEncryption(
+        sse::crypto::punct::master_key_type(master_key.data()), derivation));
+
+    test_key.punctured_key.push_back(
+        test_key.encryptor->initial_keyshare(p_count));
+    for (size_t i = 0; i < p_count; i++) {
+        test_key.punctured_key.push_back(
+            test_key.encryptor->inc_puncture(i + 1, test_punctured_tag(i)));
+    }
+
+    return test_key;
+}
+
 TEST(relic, serialization_ZR)
 {
     for (size_t i = 0; i < SERIALIZATION_TEST_COUNT; i++) {
@@ -430,6 +464,185 @@ TEST(relic, pairing)
     }
 }
 
+TEST(relic, pairing_product)
+{
+    relicxx::PairingGroup group;
+
+    ASSERT_EQ(group.pairProd({}, {}), relicxx::GT());
+    ASSERT_THROW(group.pairProd({group.randomG1()}, {}),
+                 std::invalid_argument);
+
+    for (size_t i = 0; i < ARITHMETIC_TEST_COUNT; i++) {
+        const size_t n = 1 + i % 8;
+
+        std::vector<relicxx::G1> g1(n);
+        std::vector<relicxx::G2> g2(n);
+        relicxx::GT              prod;
+
+        for (size_t j = 0; j < n; j++) {
+            g1[j] = group.randomG1();
+            g2[j] = group.randomG2();
+            prod  = group.mul(prod, group.pair(g1[j], g2[j]));
+        }
+        // the point at infinity must be supported
+        g1.push_back(relicxx::G1());
+        g2.push_back(group.randomG2());
+
+        ASSERT_EQ(group.pairProd(g1, g2), prod);
+
+        // inverted pairs
+        g1.push_back(-g1[0]);
+        g2.push_back(g2[0]);
+
+        ASSERT_EQ(group.pairProd(g1, g2),
+                  group.div(prod, group.pair(g1[0], g2[0])));
+    }
+}
+
+TEST(relic, fixed_base_exp)
+{
+    relicxx::PairingGroup group;
+
+    const relicxx::G1 g1 = group.randomG1();
+    const relicxx::G2 g2 = group.randomG2();
+
+    const relicxx::GT gt = group.pair(g1, g2);
+
+    const relicxx::G1FixedBase g1_table(g1);
+    const relicxx::G2FixedBase g2_table(g2);
+    const relicxx::GTFixedBase gt_table(gt);
+
+    for (size_t i = 0; i < ARITHMETIC_TEST_COUNT; i++) {
+        const relicxx::ZR r = group.randomZR();
+
+        // the generators are routed through the group's own tables
+        ASSERT_EQ(group.exp(group.generatorG1(), r),
+                  power(group.generatorG1(), r));
+        ASSERT_EQ(group.exp(group.generatorG2(), r),
+                  power(group.generatorG2(), r));
+
+        ASSERT_EQ(group.exp(g1_table, r), power(g1, r));
+        ASSERT_EQ(group.exp(g2_table, r), power(g2, r));
+        ASSERT_EQ(group.exp(gt_table, r), power(gt, r));
+    }
+
+    ASSERT_EQ(group.exp(g1_table, relicxx::ZR(0)), relicxx::G1());
+    ASSERT_EQ(group.exp(g2_table, relicxx::ZR(0)), relicxx::G2());
+    ASSERT_EQ(group.exp(gt_table, relicxx::ZR(0)), relicxx::GT());
+    ASSERT_EQ(group.exp(gt_table, relicxx::ZR(1)), gt);
+}
+
+TEST(relic, mul_exp2)
+{
+    relicxx::PairingGroup group;
+
+    for (size_t i = 0; i < ARITHMETIC_TEST_COUNT; i++) {
+        const relicxx::G1 a1 = group.randomG1();
+        const relicxx::G1 b1 = group.randomG1();
+        const relicxx::G2 a2 = group.randomG2();
+        const relicxx::G2 b2 = group.randomG2();
+        const relicxx::ZR x  = group.randomZR();
+        const relicxx::ZR y  = group.randomZR();
+
+        ASSERT_EQ(group.mul_exp2(a1, x, b1, y),
+                  group.mul(group.exp(a1, x), group.exp(b1, y)));
+        ASSERT_EQ(group.mul_exp2(a2, x, b2, y),
+                  group.mul(group.exp(a2, x), group.exp(b2, y)));
+    }
+}
+
+TEST(relic, operation_counts)
+{
+    relicxx::PairingGroup group;
+
+    const relicxx::G1 g1 = group.randomG1();
+    const relicxx::G2 g2 = group.randomG2();
+    const relicxx::ZR r  = group.randomZR();
+
+    const relicxx::OperationCounts start = relicxx::OperationCounts::current();
+
+    group.exp(g1, r);
+    group.exp(g2, r);
+    group.exp(g2, r);
+    group.mul_exp2(g1, r, g1, r);
+    group.pair(g1, g2);
+    group.pairProd({g1, g1, g1}, {g2, g2, g2});
+
+    const relicxx::OperationCounts ops
+        = relicxx::OperationCounts::current() - start;
+
+#ifdef RELICXX_COUNT_OPERATIONS
+    // the other tests may run concurrently: the counts are lower bounds
+    ASSERT_GE(ops.g1_exps, 2U);
+    ASSERT_GE(ops.g2_exps, 2U);
+    ASSERT_GE(ops.miller_loops, 4U);
+    ASSERT_GE(ops.final_exps, 2U);
+#else
+    // the counters are compiled out
+    ASSERT_EQ(ops.g1_exps, 0U);
+    ASSERT_EQ(ops.g2_exps, 0U);
+    ASSERT_EQ(ops.miller_loops, 0U);
+    ASSERT_EQ(ops.final_exps, 0U);
+#endif
+}
+
+TEST(relic, move)
+{
+    relicxx::PairingGroup group;
+
+    const relicxx::ZR zr = group.randomZR();
+    const relicxx::G1 g1 = group.randomG1();
+    const relicxx::G2 g2 = group.randomG2();
+    const relicxx::GT gt = group.pair(g1, g2);
+
+    relicxx::ZR zr_copy(zr);
+    relicxx::G1 g1_copy(g1);
+    relicxx::G2 g2_copy(g2);
+    relicxx::GT gt_copy(gt);
+
+    relicxx::ZR zr_moved(std::move(zr_copy));
+    relicxx::G1 g1_moved(std::move(g1_copy));
+    relicxx::G2 g2_moved(std::move(g2_copy));
+    relicxx::GT gt_moved(std::move(gt_copy));
+
+    ASSERT_EQ(zr_moved, zr);
+    ASSERT_EQ(g1_moved, g1);
+    ASSERT_EQ(g2_moved, g2);
+    ASSERT_EQ(gt_moved, gt);
+
+    // the moved-from objects can be assigned to again
+    zr_copy = zr;
+    g1_copy = g1;
+    g2_copy = g2;
+    gt_copy = gt;
+
+    ASSERT_EQ(zr_copy, zr);
+    ASSERT_EQ(g1_copy, g1);
+    ASSERT_EQ(g2_copy, g2);
+    ASSERT_EQ(gt_copy, gt);
+
+    // move assignment
+    zr_copy = group.randomZR();
+    g1_copy = group.randomG1();
+    g1_copy = std::move(g1_moved);
+    gt_copy = std::move(gt_moved);
+
+    gt_moved = group.pair(g1, g2);
+
+    ASSERT_EQ(g1_copy, g1);
+    ASSERT_EQ(gt_copy, gt);
+    ASSERT_EQ(gt_moved, gt);
+
+    // elements of a vector are moved when it grows
+    std::vector<relicxx::G2> g2s;
+    for (size_t i = 0; i < 10; i++) {
+        g2s.push_back(group.exp(g2, relicxx::ZR(static_cast<int>(i))));
+    }
+    for (size_t i = 0; i < g2s.size(); i++) {
+        ASSERT_EQ(g2s[i], group.exp(g2, relicxx::ZR(static_cast<int>(i))));
+    }
+}
+
 TEST(ppke, serialization)
 {
     //    std::array<uint8_t, sse::crypto::Gmppke::kPRFKeySize> master_key;
@@ -467,6 +680,16 @@ TEST(ppke, serialization)
 
         ASSERT_EQ(share, serialized_share);
 
+        std::array<uint8_t,
+                   sse::crypto::GmppkePrivateKeyShare::kUncompressedByteSize>
+            uncompressed_share_data;
+        share.writeBytes(uncompressed_share_data.data(), false);
+
+        sse::crypto::GmppkePrivateKeyShare uncompressed_share(
+            uncompressed_share_data.data(), false);
+
+        ASSERT_EQ(share, uncompressed_share);
+
         keyshares.push_back(share);
     }
 
@@ -497,6 +720,15 @@ TEST(ppke, serialization)
         sse::crypto::GmmppkeCT<M_type> serialized_ct(ct_data.data());
 
         ASSERT_EQ(ct, serialized_ct);
+
+        std::array<uint8_t,
+                   sse::crypto::GmmppkeCT<M_type>::kUncompressedCTByteSize>
+            uncompressed_ct_data;
+        ct.writeBytes(uncompressed_ct_data.data(), false);
+        sse::crypto::GmmppkeCT<M_type> uncompressed_ct(
+            uncompressed_ct_data.data(), false);
+
+        ASSERT_EQ(ct, uncompressed_ct);
     }
 }
 
@@ -528,6 +760,9 @@ TEST(ppke, probabilitic_correctness)
             }
         }
 
+        const sse::crypto::GmppkePreparedPrivateKey prepared_sk
+            = ppke.prepare(sk);
+
         for (size_t i = 0; i < ENCRYPTION_TEST_COUNT; i++) {
             M_type M;
 
@@ -539,10 +774,24 @@ TEST(ppke, probabilitic_correctness)
             auto   ct2    = ppke.encrypt<M_type>(sp, M, tag);
             M_type dec_M  = ppke.decrypt(sk, ct2);
             M_type dec_M2 = ppke.decrypt(sk, ct2);
+            M_type dec_M3 = 0;
 
             ASSERT_EQ(M, dec_M);
             ASSERT_EQ(M, dec_M2);
+            ASSERT_TRUE(ppke.decrypt(prepared_sk, ct, dec_M3));
+            ASSERT_EQ(M, dec_M3);
+        }
+
+        for (size_t i = 0; i < current_p_count; i++) {
+            auto ct = ppke.encrypt<M_type>(pk, 0, test_punctured_tag(i));
+
+            M_type dec_M = 0;
+            ASSERT_TRUE(prepared_sk.isPuncturedOnTag(test_punctured_tag(i)));
+            ASSERT_FALSE(ppke.decrypt(prepared_sk, ct, dec_M));
         }
+        ASSERT_FALSE(prepared_sk.isPuncturedOnTag(
+            test_punctured_tag(current_p_count)));
+        ASSERT_TRUE(prepared_sk.isPuncturedOnTag(sse::crypto::Gmppke::NULLTAG));
     }
 }
 
@@ -679,3 +928,248 @@ TEST(puncturable, correctness)
         }
     }
 }
+
+TEST(puncturable, batch_decryption)
+{
+    const size_t p_count = 5;
+
+    PuncturedTestKey test_key = punctured_test_key(p_count);
+
+    sse::crypto::PuncturableEncryption&     encryptor = *test_key.encryptor;
+    sse::crypto::punct::punctured_key_type& punctured_key
+        = test_key.punctured_key;
+
+    sse::crypto::PuncturableDecryption decryptor(punctured_key);
+
+    // mix ciphertexts for punctured and unpunctured tags
+    std::vector<sse::crypto::punct::ciphertext_type> cts;
+    std::vector<bool>                                expected_ok;
+    for (size_t i = 0; i < ENCRYPTION_TEST_COUNT; i++) {
+        sse::crypto::tag_type tag = test_encryption_tag(i);
+        tag[8]                    = 0xCC;
+        if (i % 4 == 3) {
+            tag = test_punctured_tag(i % p_count);
+        }
+
+        cts.push_back(encryptor.encrypt(i, tag));
+        expected_ok.push_back(i % 4 != 3);
+    }
+
+    std::vector<uint64_t> ms;
+    std::vector<bool>     ok;
+    decryptor.decrypt_batch(cts, ms, ok);
+
+    ASSERT_EQ(ms.size(), cts.size());
+    ASSERT_EQ(ok, expected_ok);
+
+    for (size_t i = 0; i < cts.size(); i++) {
+        uint64_t m;
+        ASSERT_EQ(decryptor.decrypt(cts[i], m), ok[i]);
+        if (ok[i]) {
+            ASSERT_EQ(ms[i], i);
+            ASSERT_EQ(m, i);
+        }
+    }
+
+    // empty batches are valid
+    decryptor.decrypt_batch(
+        std::vector<sse::crypto::punct::ciphertext_type>(), ms, ok);
+    ASSERT_TRUE(ms.empty());
+    ASSERT_TRUE(ok.empty());
+}
+
+TEST(puncturable, batch_decryption_many_punctures)
+{
+    // a short batch against a long key splits the shares between the threads
+    const size_t p_count = 40;
+
+    PuncturedTestKey test_key = punctured_test_key(p_count);
+
+    sse::crypto::PuncturableEncryption&     encryptor = *test_key.encryptor;
+    sse::crypto::punct::punctured_key_type& punctured_key
+        = test_key.punctured_key;
+
+    sse::crypto::PuncturableDecryption decryptor(punctured_key);
+
+    sse::crypto::tag_type tag = test_encryption_tag(0);
+    tag[8]                    = 0xCC;
+
+    std::vector<sse::crypto::punct::ciphertext_type> cts;
+    cts.push_back(encryptor.encrypt(42, tag));
+    cts.push_back(encryptor.encrypt(43, test_punctured_tag(p_count - 1)));
+
+    std::vector<uint64_t> ms;
+    std::vector<bool>     ok;
+    decryptor.decrypt_batch(cts, ms, ok);
+
+    ASSERT_EQ(ok, std::vector<bool>({true, false}));
+    ASSERT_EQ(ms[0], 42u);
+}
+
+TEST(puncturable, uncompressed)
+{
+    const size_t p_count = 5;
+
+    PuncturedTestKey test_key = punctured_test_key(p_count);
+
+    sse::crypto::PuncturableEncryption&     encryptor = *test_key.encryptor;
+    sse::crypto::punct::punctured_key_type& punctured_key
+        = test_key.punctured_key;
+
+    sse::crypto::punct::uncompressed_punctured_key_type uncompressed_key;
+    for (const auto& share : punctured_key) {
+        uncompressed_key.push_back(sse::crypto::punct::uncompress(share));
+        ASSERT_EQ(sse::crypto::punct::extract_tag(uncompressed_key.back()),
+                  sse::crypto::punct::extract_tag(share));
+    }
+
+    sse::crypto::PuncturableDecryption decryptor(punctured_key);
+    sse::crypto::PuncturableDecryption uncompressed_decryptor(
+        uncompressed_key);
+
+    std::vector<sse::crypto::punct::uncompressed_ciphertext_type> cts;
+    for (size_t i = 0; i < ENCRYPTION_TEST_COUNT; i++) {
+        sse::crypto::tag_type tag = test_encryption_tag(i);
+        tag[8]                    = 0xCC;
+
+        const auto ct = encryptor.encrypt(i, tag);
+        cts.push_back(sse::crypto::punct::uncompress(ct));
+
+        ASSERT_EQ(sse::crypto::punct::extract_tag(cts.back()),
+                  sse::crypto::punct::extract_tag(ct));
+
+        uint64_t m_1, m_2, m_3;
+        ASSERT_TRUE(uncompressed_decryptor.decrypt(ct, m_1));
+        ASSERT_TRUE(uncompressed_decryptor.decrypt(cts.back(), m_2));
+        ASSERT_TRUE(decryptor.decrypt(cts.back(), m_3));
+        ASSERT_EQ(m_1, i);
+        ASSERT_EQ(m_2, i);
+        ASSERT_EQ(m_3, i);
+    }
+
+    std::vector<uint64_t> ms;
+    std::vector<bool>     ok;
+    uncompressed_decryptor.decrypt_batch(cts, ms, ok);
+    for (size_t i = 0; i < cts.size(); i++) {
+        ASSERT_TRUE(ok[i]);
+        ASSERT_EQ(ms[i], i);
+    }
+
+    for (size_t i = 0; i < p_count; i++) {
+        uint64_t   m;
+        const auto ct = sse::crypto::punct::uncompress(
+            encryptor.encrypt(0, test_punctured_tag(i)));
+        ASSERT_FALSE(uncompressed_decryptor.decrypt(ct, m));
+    }
+
+    // the framing of the keys is checked by the constructors
+    ASSERT_THROW(sse::crypto::PuncturableDecryption{
+                     sse::crypto::punct::punctured_key_type{}},
+                 std::invalid_argument);
+    ASSERT_THROW(sse::crypto::PuncturableDecryption{
+                     sse::crypto::punct::uncompressed_punctured_key_type{}},
+                 std::invalid_argument);
+
+    punctured_key[1][0]    = 0x04;
+    uncompressed_key[1][0] = 0x02;
+    ASSERT_THROW(sse::crypto::PuncturableDecryption{punctured_key},
+                 std::invalid_argument);
+    ASSERT_THROW(sse::crypto::PuncturableDecryption{uncompressed_key},
+                 std::invalid_argument);
+}
+
+TEST(puncturable, batch_puncture)
+{
+    const size_t p_count = 20;
+
+    PuncturedTestKey test_key = punctured_test_key(p_count);
+
+    sse::crypto::PuncturableEncryption& encryptor = *test_key.encryptor;
+
+    std::vector<sse::crypto::punct::tag_type> tags;
+    for (size_t i = 0; i < p_count; i++) {
+        tags.push_back(test_punctured_tag(i));
+    }
+
+    // keep the first two shares, and generate the following ones in a batch
+    sse::crypto::punct::punctured_key_type punctured_key(
+        test_key.punctured_key.begin(), test_key.punctured_key.begin() + 2);
+
+    const std::vector<sse::crypto::punct::tag_type> batch_tags(
+        tags.begin() + 1, tags.end());
+    const auto batch = encryptor.inc_puncture_batch(2, batch_tags);
+
+    ASSERT_EQ(batch.size(), p_count - 1);
+    for (size_t i = 0; i < batch.size(); i++) {
+        ASSERT_EQ(batch[i], test_key.punctured_key[i + 2]);
+    }
+    punctured_key.insert(punctured_key.end(), batch.begin(), batch.end());
+
+    sse::crypto::PuncturableDecryption decryptor(punctured_key);
+
+    for (size_t i = 0; i < ENCRYPTION_TEST_COUNT; i++) {
+        sse::crypto::tag_type tag = test_encryption_tag(i);
+        tag[8]                    = 0xCC;
+
+        uint64_t m;
+        ASSERT_TRUE(decryptor.decrypt(encryptor.encrypt(i, tag), m));
+        ASSERT_EQ(m, i);
+    }
+    for (const auto& tag : tags) {
+        uint64_t m;
+        ASSERT_FALSE(decryptor.decrypt(encryptor.encrypt(0, tag), m));
+    }
+
+    ASSERT_TRUE(encryptor.inc_puncture_batch(1, {}).empty());
+    ASSERT_THROW(encryptor.inc_puncture_batch(0, tags), std::invalid_argument);
+    ASSERT_THROW(
+        encryptor.inc_puncture_batch(1, {sse::crypto::Gmppke::NULLTAG}),
+        std::invalid_argument);
+}
+
+TEST(puncturable, stream_derivation)
+{
+    const size_t p_count = 10;
+
+    PuncturedTestKey test_key = punctured_test_key(
+        p_count, sse::crypto::punct::ScalarDerivation::kChaChaStream);
+    PuncturedTestKey test_key_copy = punctured_test_key(
+        p_count, sse::crypto::punct::ScalarDerivation::kChaChaStream);
+    PuncturedTestKey labeled_test_key = punctured_test_key(p_count);
+
+    sse::crypto::PuncturableEncryption&     encryptor = *test_key.encryptor;
+    sse::crypto::punct::punctured_key_type& punctured_key
+        = test_key.punctured_key;
+
+    std::vector<sse::crypto::punct::tag_type> tags;
+    for (size_t i = 0; i < p_count; i++) {
+        tags.push_back(test_punctured_tag(i));
+    }
+
+    // the derivation is deterministic, and differs from the labeled one
+    for (size_t i = 0; i <= p_count; i++) {
+        ASSERT_EQ(punctured_key[i], test_key_copy.punctured_key[i]);
+        ASSERT_NE(punctured_key[i], labeled_test_key.punctured_key[i]);
+    }
+
+    const auto batch = encryptor.inc_puncture_batch(1, tags);
+    ASSERT_EQ(batch.size(), p_count);
+    for (size_t i = 0; i < p_count; i++) {
+        ASSERT_EQ(batch[i], punctured_key[i + 1]);
+    }
+
+    sse::crypto::PuncturableDecryption decryptor(punctured_key);
+
+    for (size_t i = 0; i < ENCRYPTION_TEST_COUNT; i++) {
+        sse::crypto::tag_type tag = test_encryption_tag(i);
+        tag[8]                    = 0xCC;
+
+        uint64_t m;
+        ASSERT_TRUE(decryptor.decrypt(encryptor.encrypt(i, tag), m));
+        ASSERT_EQ(m, i);
+    }
+    for (const auto& tag : tags) {
+        uint64_t m;
+        ASSERT_FALSE(decryptor.decrypt(encryptor.encrypt(0, tag), m));
+    }
+}
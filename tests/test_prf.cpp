@@ -25,6 +25,7 @@
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -105,6 +106,26 @@ void test_key_derivation_consistency_array()
     out_key.lock();
 }
 
+template<size_t N>
+void test_prf_batch_consistency(size_t batch_size)
+{
+    sse::crypto::Prf<N> prf;
+
+    // inputs of various lengths, including the empty one
+    std::vector<std::string> in(batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+        in[i] = sse::crypto::random_string(i);
+    }
+
+    std::vector<std::array<uint8_t, N>> out;
+    prf.prf_batch(in, out);
+
+    ASSERT_EQ(out.size(), batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+        ASSERT_EQ(out[i], prf.prf(in[i]));
+    }
+}
+
 } // namespace tests
 
 TEST(prf, consistency)
@@ -142,6 +163,19 @@ TEST(prf, key_derivation_consistency)
     tests::test_key_derivation_consistency_array<1024, 200>();
 }
 
+TEST(prf, batch_consistency)
+{
+    const size_t batch_size = 2 * sse::crypto::Hash::kDigestSize + 20;
+
+    tests::test_prf_batch_consistency<1>(batch_size);
+    tests::test_prf_batch_consistency<10>(batch_size);
+    tests::test_prf_batch_consistency<20>(batch_size);
+    tests::test_prf_batch_consistency<128>(batch_size);
+    tests::test_prf_batch_consistency<1024>(batch_size);
+    tests::test_prf_batch_consistency<2000>(batch_size);
+    tests::test_prf_batch_consistency<1>(0);
+}
+
 TEST(prf, exceptions)
 {
     sse::crypto::Prf<20> prf;
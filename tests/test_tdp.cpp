@@ -18,14 +18,21 @@
 // along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include "mbedtls/bignum.h"
+#include "tdp_impl/exponent_cost.hpp"
+#include "tdp_impl/key_encoding.hpp"
+#include "tdp_impl/multi_buffer_mod_exp.hpp"
 #include "tdp_impl/tdp_impl_mbedtls.hpp"
 #include "tdp_impl/tdp_impl_openssl.hpp"
 
+#include <sse/crypto/random.hpp>
 #include <sse/crypto/tdp.hpp>
 
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -46,6 +53,12 @@ using namespace std;
 #define TDP_IMPL_COPY_TEST_COUNT 30
 
 #define TDP_IMPL_DET_GEN_TEST_COUNT 30
+#define TDP_IMPL_BATCH_GEN_SIZE 100
+
+#define TDP_IMPL_CHAIN_TEST_COUNT 5
+#define CHAIN_LENGTH 20
+
+#define BATCH_SIZE 40
 
 #define POOL_COUNT 20
 #define INV_MULT_COUNT 100
@@ -112,6 +125,25 @@ public:
     {
         return tdp_inv.invert_mult(in, order);
     }
+
+    using chain_type = sse::crypto::TdpChain;
+
+    template<typename T>
+    inline static std::unique_ptr<chain_type> tdp_eval_chain(
+        const T&                                                   tdp,
+        const std::array<uint8_t, sse::crypto::Tdp::kMessageSize>& start)
+    {
+        return std::unique_ptr<chain_type>(
+            new chain_type(tdp.eval_chain(start)));
+    }
+
+    inline static std::unique_ptr<chain_type> tdp_invert_chain(
+        const TDP_INV&                                             tdp_inv,
+        const std::array<uint8_t, sse::crypto::Tdp::kMessageSize>& start)
+    {
+        return std::unique_ptr<chain_type>(
+            new chain_type(tdp_inv.invert_chain(start)));
+    }
 };
 
 template<typename TDP, typename TDP_INV, typename TDP_POOL>
@@ -184,6 +216,23 @@ public:
     {
         return std::string();
     }
+
+    using chain_type = sse::crypto::TdpChainImpl;
+
+    template<typename T>
+    inline static std::unique_ptr<chain_type> tdp_eval_chain(
+        const T&                                                   tdp,
+        const std::array<uint8_t, sse::crypto::Tdp::kMessageSize>& start)
+    {
+        return std::unique_ptr<chain_type>(tdp.eval_chain(start));
+    }
+
+    inline static std::unique_ptr<chain_type> tdp_invert_chain(
+        const TDP_INV&                                             tdp_inv,
+        const std::array<uint8_t, sse::crypto::Tdp::kMessageSize>& start)
+    {
+        return std::unique_ptr<chain_type>(tdp_inv.invert_chain(start));
+    }
 };
 
 
@@ -252,6 +301,21 @@ static void test_tdp_impl_correctness(const size_t test_count)
             = tdp_inv.invert(enc_array);
 
         ASSERT_EQ(sample, dec_array);
+
+        // array-in/array-out versions, including in-place evaluation
+        std::array<uint8_t, sse::crypto::Tdp::kMessageSize> out_array;
+        tdp.eval(sample, out_array);
+        ASSERT_EQ(enc_arr, out_array);
+        tdp_inv.eval(sample, out_array);
+        ASSERT_EQ(enc_arr, out_array);
+        tdp_mult.eval(sample, out_array);
+        ASSERT_EQ(enc_arr, out_array);
+
+        tdp_inv.invert(out_array, out_array);
+        ASSERT_EQ(sample, out_array);
+
+        tdp.eval(out_array, out_array);
+        ASSERT_EQ(enc_arr, out_array);
     }
 
     for (size_t i = 0; i < test_count; i++) {
@@ -410,6 +474,42 @@ static void test_tdp_impl_multiple_eval(const size_t string_test_count,
 }
 
 
+template<typename TDP,
+         typename TDP_INV,
+         typename TDP_POOL,
+         bool is_implementation>
+static void test_tdp_impl_pool_maximum_size()
+{
+    using tdp_test
+        = conditional_tdp_test<TDP, TDP_INV, TDP_POOL, is_implementation>;
+
+    TDP_INV tdp_inv;
+
+    // the exponents of the largest pool are much larger than the modulus
+    TDP_POOL pool(tdp_inv.public_key(), 255);
+    TDP_POOL pool_copy(pool);
+
+    ASSERT_EQ(255, pool.maximum_order());
+    ASSERT_EQ(255, pool_copy.maximum_order());
+
+    string sample = pool.sample();
+    string v      = sample;
+    string out;
+
+    for (uint32_t j = 1; j <= 255; j++) {
+        tdp_inv.eval(v, v);
+
+        if (j == 1 || j == 2 || j % 50 == 0 || j == 255) {
+            tdp_test::tdp_eval_pool(
+                pool_copy, sample, out, static_cast<uint8_t>(j));
+            ASSERT_EQ(v, out);
+        }
+    }
+
+    ASSERT_THROW(tdp_test::tdp_eval_pool(pool, sample, out, 0),
+                 std::invalid_argument);
+}
+
 template<typename TDP,
          typename TDP_INV,
          typename TDP_POOL,
@@ -437,6 +537,10 @@ static void test_tdp_impl_multiple_inverse_1(const size_t test_count)
         w = tdp_test::tdp_invert_mult(tdp_inv, sample, INV_MULT_COUNT);
         auto goal_arr = tdp_inv.invert_mult(sample_arr, INV_MULT_COUNT);
 
+        auto goal_arr_inplace = sample_arr;
+        tdp_inv.invert_mult(
+            goal_arr_inplace, goal_arr_inplace, INV_MULT_COUNT);
+
         v = sample;
         for (size_t j = 0; j < INV_MULT_COUNT; j++) {
             tdp_inv.invert(v, v);
@@ -445,6 +549,7 @@ static void test_tdp_impl_multiple_inverse_1(const size_t test_count)
             ASSERT_EQ(goal, w);
         }
         ASSERT_EQ(goal, std::string(goal_arr.begin(), goal_arr.end()));
+        ASSERT_EQ(goal_arr, goal_arr_inplace);
         ASSERT_EQ(goal, v);
     }
 }
@@ -475,6 +580,41 @@ static void test_tdp_impl_multiple_inverse_2(const size_t test_count)
 }
 
 
+template<typename TDP,
+         typename TDP_INV,
+         typename TDP_POOL,
+         bool is_implementation>
+static void test_tdp_impl_invert_mult_cache(const size_t test_count)
+{
+    TDP_INV tdp_inv;
+    TDP_INV tdp_inv_prewarm(tdp_inv.private_key());
+
+    ASSERT_THROW(tdp_inv_prewarm.prewarm_invert_mult(3, 2),
+                 std::invalid_argument);
+
+    tdp_inv_prewarm.prewarm_invert_mult(0, static_cast<uint32_t>(test_count));
+    // ranges larger than the cache must not be an issue
+    tdp_inv_prewarm.prewarm_invert_mult(
+        0, static_cast<uint32_t>(sse::crypto::TdpInverse::kInvertMultCacheSize + 10));
+
+    string sample = tdp_inv.sample();
+    string v      = sample;
+
+    for (uint32_t j = 1; j <= test_count; j++) {
+        string out, out_prewarm, out_cached;
+
+        tdp_inv.invert(v, v);
+        tdp_inv.invert_mult(sample, out, j);
+        // second call, using the cached exponents
+        tdp_inv.invert_mult(sample, out_cached, j);
+        tdp_inv_prewarm.invert_mult(sample, out_prewarm, j);
+
+        ASSERT_EQ(v, out);
+        ASSERT_EQ(v, out_cached);
+        ASSERT_EQ(v, out_prewarm);
+    }
+}
+
 template<typename TDP,
          typename TDP_INV,
          typename TDP_POOL,
@@ -573,6 +713,148 @@ static void test_tdp_impl_copy(const size_t test_count)
     }
 }
 
+template<typename TDP,
+         typename TDP_INV,
+         typename TDP_POOL,
+         bool is_implementation>
+static void test_tdp_impl_batch()
+{
+    using message_type = std::array<uint8_t, sse::crypto::Tdp::kMessageSize>;
+
+    TDP_INV  tdp_inv;
+    TDP      tdp(tdp_inv.public_key());
+    TDP_POOL pool(tdp_inv.public_key(), 2);
+
+    std::vector<message_type> in(BATCH_SIZE);
+    for (auto& m : in) {
+        m = tdp_inv.sample_array();
+    }
+
+    std::vector<message_type> eval_expected(BATCH_SIZE);
+    std::vector<message_type> invert_expected(BATCH_SIZE);
+    std::vector<message_type> invert_mult_expected(BATCH_SIZE);
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        tdp.eval(in[i], eval_expected[i]);
+        tdp_inv.invert(in[i], invert_expected[i]);
+        tdp_inv.invert_mult(in[i], invert_mult_expected[i], 3);
+    }
+
+    // 0 means one thread per core, and more threads than messages is valid
+    for (unsigned int n_threads : {1U, 2U, 7U, 0U, 64U}) {
+        std::vector<message_type> out;
+
+        tdp.eval_batch(in, out, n_threads);
+        ASSERT_EQ(out, eval_expected);
+        tdp_inv.eval_batch(in, out, n_threads);
+        ASSERT_EQ(out, eval_expected);
+        pool.eval_batch(in, out, n_threads);
+        ASSERT_EQ(out, eval_expected);
+
+        tdp_inv.invert_batch(in, out, n_threads);
+        ASSERT_EQ(out, invert_expected);
+
+        tdp_inv.invert_mult_batch(in, out, 3, n_threads);
+        ASSERT_EQ(out, invert_mult_expected);
+
+        tdp_inv.invert_mult_batch(in, out, 0, n_threads);
+        ASSERT_EQ(out, in);
+
+        // in place computations
+        out = in;
+        tdp_inv.invert_batch(out, out, n_threads);
+        tdp.eval_batch(out, out, n_threads);
+        ASSERT_EQ(out, in);
+    }
+
+    std::vector<message_type> empty;
+    tdp.eval_batch(empty, empty, 4);
+    ASSERT_TRUE(empty.empty());
+}
+
+template<typename TDP,
+         typename TDP_INV,
+         typename TDP_POOL,
+         bool is_implementation>
+static void test_tdp_impl_chain(const size_t test_count)
+{
+    using tdp_test
+        = conditional_tdp_test<TDP, TDP_INV, TDP_POOL, is_implementation>;
+
+    std::array<uint8_t, sse::crypto::Tdp::kMessageSize> chain_val, expected;
+
+    for (size_t i = 0; i < test_count; i++) {
+        TDP_INV  tdp_inv;
+        TDP      tdp(tdp_inv.public_key());
+        TDP_POOL pool(tdp_inv.public_key(), 2);
+
+        auto start = tdp_inv.sample_array();
+
+        auto eval_chain     = tdp_test::tdp_eval_chain(tdp, start);
+        auto inv_eval_chain = tdp_test::tdp_eval_chain(tdp_inv, start);
+        auto pool_chain     = tdp_test::tdp_eval_chain(pool, start);
+        auto invert_chain   = tdp_test::tdp_invert_chain(tdp_inv, start);
+
+        // the first element of a chain is its starting point
+        eval_chain->value(chain_val);
+        ASSERT_EQ(chain_val, start);
+        invert_chain->value(chain_val);
+        ASSERT_EQ(chain_val, start);
+
+        expected = start;
+        for (size_t j = 0; j < CHAIN_LENGTH; j++) {
+            tdp.eval(expected, expected);
+
+            eval_chain->next(chain_val);
+            ASSERT_EQ(chain_val, expected);
+            inv_eval_chain->next(chain_val);
+            ASSERT_EQ(chain_val, expected);
+            pool_chain->next(chain_val);
+            ASSERT_EQ(chain_val, expected);
+        }
+
+        expected = start;
+        for (size_t j = 0; j < CHAIN_LENGTH; j++) {
+            tdp_inv.invert(expected, expected);
+
+            invert_chain->next(chain_val);
+            ASSERT_EQ(chain_val, expected);
+        }
+        ASSERT_EQ(tdp_inv.invert_mult(start, CHAIN_LENGTH), expected);
+
+        // walking back the inverse chain gives the starting point
+        auto back_chain = tdp_test::tdp_eval_chain(tdp, chain_val);
+        back_chain->advance(CHAIN_LENGTH);
+        back_chain->value(chain_val);
+        ASSERT_EQ(chain_val, start);
+
+        // advance is equivalent to repeated calls to next
+        auto skip_chain = tdp_test::tdp_invert_chain(tdp_inv, start);
+        skip_chain->advance(CHAIN_LENGTH);
+        skip_chain->value(chain_val);
+        ASSERT_EQ(chain_val, expected);
+
+        // the exponents are blinded with fresh random values at every step:
+        // this must not change the elements of the chain, whatever the way
+        // the chain is advanced
+        auto split_chain = tdp_test::tdp_invert_chain(tdp_inv, start);
+        split_chain->advance(1);
+        split_chain->value(chain_val);
+        ASSERT_EQ(chain_val, tdp_inv.invert(start));
+        split_chain->advance(CHAIN_LENGTH - 1);
+        split_chain->value(chain_val);
+        ASSERT_EQ(chain_val, expected);
+
+        // a chain outlives the TDP it was created from
+        {
+            TDP tdp_tmp(tdp_inv.public_key());
+            eval_chain = tdp_test::tdp_eval_chain(tdp_tmp, start);
+        }
+        eval_chain->advance(1);
+        eval_chain->value(chain_val);
+        ASSERT_EQ(chain_val, tdp.eval(start));
+    }
+}
+
 template<typename TDP,
          typename TDP_INV,
          typename TDP_POOL,
@@ -645,6 +927,143 @@ static void test_tdp_impl_deterministic_generation(const size_t test_count)
     }
 }
 
+template<typename TDP, typename TDP_INV, typename TDP_POOL>
+static void test_tdp_impl_batch_generation(const size_t batch_size)
+{
+    TDP_INV  inv_tdp;
+    TDP      tdp(inv_tdp.public_key());
+    TDP_POOL pool_tdp(inv_tdp.public_key(), 2);
+
+    const sse::crypto::Prf<sse::crypto::Tdp::kRSAPrfSize> prf;
+
+    // seeds of various lengths, including the empty one
+    std::vector<std::string> seeds(batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+        seeds[i] = sse::crypto::random_string(i % 64);
+    }
+
+    std::vector<std::array<uint8_t, sse::crypto::Tdp::kMessageSize>> tdp_gen,
+        inv_tdp_gen, pool_tdp_gen;
+
+    tdp.generate_batch(prf, seeds, tdp_gen);
+    inv_tdp.generate_batch(prf, seeds, inv_tdp_gen);
+    pool_tdp.generate_batch(prf, seeds, pool_tdp_gen);
+
+    ASSERT_EQ(tdp_gen.size(), batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+        ASSERT_EQ(tdp_gen[i], tdp.generate_array(prf, seeds[i]));
+        ASSERT_EQ(inv_tdp_gen[i], tdp_gen[i]);
+        ASSERT_EQ(pool_tdp_gen[i], tdp_gen[i]);
+    }
+
+    // the sampled messages must be reduced mod N: check that they are fixed
+    // points of the inversion of the evaluation
+    const size_t sample_count = TDP_TEST_COUNT;
+    std::vector<std::array<uint8_t, sse::crypto::Tdp::kMessageSize>> samples;
+
+    tdp.sample_batch(sample_count, samples);
+    ASSERT_EQ(samples.size(), sample_count);
+    for (const auto& x : samples) {
+        ASSERT_EQ(inv_tdp.invert(tdp.eval(x)), x);
+    }
+    ASSERT_NE(samples[0], samples[1]);
+
+    inv_tdp.sample_batch(sample_count, samples);
+    ASSERT_EQ(samples.size(), sample_count);
+    pool_tdp.sample_batch(0, samples);
+    ASSERT_TRUE(samples.empty());
+}
+
+template<typename TDP,
+         typename TDP_INV,
+         typename TDP_POOL,
+         bool is_implementation>
+static void test_tdp_impl_binary_key(const size_t test_count)
+{
+    namespace binary_key = sse::crypto::binary_key;
+
+    for (size_t i = 0; i < test_count; i++) {
+        TDP_INV tdp_inv;
+
+        const string pk     = tdp_inv.public_key();
+        const string sk     = tdp_inv.private_key();
+        const string pk_bin = tdp_inv.public_key_binary();
+        const string sk_bin = tdp_inv.private_key_binary();
+
+        ASSERT_EQ(pk_bin.size(), binary_key::kPublicKeySize);
+        ASSERT_EQ(sk_bin.size(), binary_key::kPrivateKeySize);
+        // the PEM encodings are cached
+        ASSERT_EQ(pk, tdp_inv.public_key());
+        ASSERT_EQ(sk, tdp_inv.private_key());
+
+        TDP      tdp(pk_bin);
+        TDP_INV  tdp_inv_bin(sk_bin);
+        TDP_POOL pool(pk_bin, 3);
+
+        // the keys are the same, whatever the encoding they were loaded from
+        ASSERT_EQ(pk, tdp.public_key());
+        ASSERT_EQ(pk, pool.public_key());
+        ASSERT_EQ(pk_bin, tdp.public_key_binary());
+        ASSERT_EQ(pk_bin, pool.public_key_binary());
+        ASSERT_EQ(pk, tdp_inv_bin.public_key());
+        ASSERT_EQ(sk, tdp_inv_bin.private_key());
+        ASSERT_EQ(sk_bin, tdp_inv_bin.private_key_binary());
+
+        TDP_INV tdp_inv_pem(sk);
+        ASSERT_EQ(sk_bin, tdp_inv_pem.private_key_binary());
+
+        string sample = tdp_inv.sample();
+        string y, x, x_bin;
+        tdp.eval(sample, y);
+        tdp_inv.invert(y, x);
+        tdp_inv_bin.invert(y, x_bin);
+
+        ASSERT_EQ(sample, x);
+        ASSERT_EQ(sample, x_bin);
+        string y_inv;
+        tdp_inv_bin.eval(sample, y_inv);
+        ASSERT_EQ(y, y_inv);
+
+        // a wrong Montgomery constant is recomputed
+        string pk_bad_rr = pk_bin;
+        pk_bad_rr[binary_key::kHeaderSize + 2 * binary_key::kModulusSize] ^= 1;
+        TDP    tdp_bad_rr(pk_bad_rr);
+        string y_bad_rr;
+        tdp_bad_rr.eval(sample, y_bad_rr);
+        ASSERT_EQ(y, y_bad_rr);
+        ASSERT_EQ(pk_bin, tdp_bad_rr.public_key_binary());
+
+        // invalid binary keys
+        string pk_bad_version = pk_bin;
+        pk_bad_version[binary_key::kMagicSize]++;
+        ASSERT_THROW(TDP tdp_bad(pk_bad_version), std::runtime_error);
+        ASSERT_THROW(TDP tdp_bad(pk_bin.substr(0, pk_bin.size() - 1)),
+                     std::runtime_error);
+        ASSERT_THROW(TDP tdp_bad(sk_bin), std::runtime_error);
+        ASSERT_THROW(TDP_INV tdp_bad(pk_bin), std::runtime_error);
+
+        // P is not a factor of N anymore
+        string sk_bad_p = sk_bin;
+        sk_bad_p[binary_key::kPublicKeySize + binary_key::kModulusSize
+                 + binary_key::kPrimeSize - 1]
+            ^= 2;
+        ASSERT_THROW(TDP_INV tdp_bad(sk_bad_p), std::runtime_error);
+
+        // D is not the inverse of E anymore
+        string sk_bad_d = sk_bin;
+        sk_bad_d[binary_key::kPublicKeySize + binary_key::kModulusSize - 1]
+            ^= 2;
+        ASSERT_THROW(TDP_INV tdp_bad(sk_bad_d), std::runtime_error);
+
+        // the CRT coefficient does not match the primes anymore
+        string sk_bad_qp = sk_bin;
+        sk_bad_qp[binary_key::kPublicKeySize + binary_key::kModulusSize
+                  + 5 * binary_key::kPrimeSize - 1]
+            ^= 2;
+        ASSERT_THROW(TDP_INV tdp_bad(sk_bad_qp), std::runtime_error);
+    }
+}
+
 template<typename TDP,
          typename TDP_INV,
          typename TDP_POOL,
@@ -764,6 +1183,32 @@ TEST(tdp, multiple_eval)
                                        TDP_TEST_COUNT - TDP_TEST_COUNT / 2);
 }
 
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, pool_maximum_size)
+{
+    test_tdp_impl_pool_maximum_size<sse::crypto::TdpImpl_OpenSSL,
+                                    sse::crypto::TdpInverseImpl_OpenSSL,
+                                    sse::crypto::TdpMultPoolImpl_OpenSSL,
+                                    true>();
+}
+#endif
+
+TEST(tdp_mbedtls_impl, pool_maximum_size)
+{
+    test_tdp_impl_pool_maximum_size<sse::crypto::TdpImpl_mbedTLS,
+                                    sse::crypto::TdpInverseImpl_mbedTLS,
+                                    sse::crypto::TdpMultPoolImpl_mbedTLS,
+                                    true>();
+}
+
+TEST(tdp, pool_maximum_size)
+{
+    test_tdp_impl_pool_maximum_size<sse::crypto::Tdp,
+                                    sse::crypto::TdpInverse,
+                                    sse::crypto::TdpMultPool,
+                                    false>();
+}
+
 #ifdef WITH_OPENSSL
 TEST(tdp_openssl_impl, multiple_inverse_1)
 {
@@ -816,6 +1261,84 @@ TEST(tdp, multiple_inverse_2)
                                      false>(TDP_TEST_COUNT);
 }
 
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, invert_mult_cache)
+{
+    test_tdp_impl_invert_mult_cache<sse::crypto::TdpImpl_OpenSSL,
+                                    sse::crypto::TdpInverseImpl_OpenSSL,
+                                    sse::crypto::TdpMultPoolImpl_OpenSSL,
+                                    true>(TDP_IMPL_MULT_INV_2_TEST_COUNT);
+}
+#endif
+
+TEST(tdp_mbedtls_impl, invert_mult_cache)
+{
+    test_tdp_impl_invert_mult_cache<sse::crypto::TdpImpl_mbedTLS,
+                                    sse::crypto::TdpInverseImpl_mbedTLS,
+                                    sse::crypto::TdpMultPoolImpl_mbedTLS,
+                                    true>(TDP_IMPL_MULT_INV_2_TEST_COUNT);
+}
+
+TEST(tdp, invert_mult_cache)
+{
+    test_tdp_impl_invert_mult_cache<sse::crypto::Tdp,
+                                    sse::crypto::TdpInverse,
+                                    sse::crypto::TdpMultPool,
+                                    false>(TDP_TEST_COUNT);
+}
+
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, batch)
+{
+    test_tdp_impl_batch<sse::crypto::TdpImpl_OpenSSL,
+                        sse::crypto::TdpInverseImpl_OpenSSL,
+                        sse::crypto::TdpMultPoolImpl_OpenSSL,
+                        true>();
+}
+#endif
+
+TEST(tdp_mbedtls_impl, batch)
+{
+    test_tdp_impl_batch<sse::crypto::TdpImpl_mbedTLS,
+                        sse::crypto::TdpInverseImpl_mbedTLS,
+                        sse::crypto::TdpMultPoolImpl_mbedTLS,
+                        true>();
+}
+
+TEST(tdp, batch)
+{
+    test_tdp_impl_batch<sse::crypto::Tdp,
+                        sse::crypto::TdpInverse,
+                        sse::crypto::TdpMultPool,
+                        false>();
+}
+
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, chain)
+{
+    test_tdp_impl_chain<sse::crypto::TdpImpl_OpenSSL,
+                        sse::crypto::TdpInverseImpl_OpenSSL,
+                        sse::crypto::TdpMultPoolImpl_OpenSSL,
+                        true>(TDP_IMPL_CHAIN_TEST_COUNT);
+}
+#endif
+
+TEST(tdp_mbedtls_impl, chain)
+{
+    test_tdp_impl_chain<sse::crypto::TdpImpl_mbedTLS,
+                        sse::crypto::TdpInverseImpl_mbedTLS,
+                        sse::crypto::TdpMultPoolImpl_mbedTLS,
+                        true>(TDP_IMPL_CHAIN_TEST_COUNT);
+}
+
+TEST(tdp, chain)
+{
+    test_tdp_impl_chain<sse::crypto::Tdp,
+                        sse::crypto::TdpInverse,
+                        sse::crypto::TdpMultPool,
+                        false>(TDP_TEST_COUNT);
+}
+
 #ifdef WITH_OPENSSL
 TEST(tdp_openssl_impl, copy)
 {
@@ -870,6 +1393,58 @@ TEST(tdp, deterministic_generation)
 }
 
 
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, batch_generation)
+{
+    test_tdp_impl_batch_generation<sse::crypto::TdpImpl_OpenSSL,
+                                   sse::crypto::TdpInverseImpl_OpenSSL,
+                                   sse::crypto::TdpMultPoolImpl_OpenSSL>(
+        TDP_IMPL_BATCH_GEN_SIZE);
+}
+#endif
+
+TEST(tdp_mbedtls_impl, batch_generation)
+{
+    test_tdp_impl_batch_generation<sse::crypto::TdpImpl_mbedTLS,
+                                   sse::crypto::TdpInverseImpl_mbedTLS,
+                                   sse::crypto::TdpMultPoolImpl_mbedTLS>(
+        TDP_IMPL_BATCH_GEN_SIZE);
+}
+
+TEST(tdp, batch_generation)
+{
+    test_tdp_impl_batch_generation<sse::crypto::Tdp,
+                                   sse::crypto::TdpInverse,
+                                   sse::crypto::TdpMultPool>(
+        TDP_IMPL_BATCH_GEN_SIZE);
+}
+
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, binary_key)
+{
+    test_tdp_impl_binary_key<sse::crypto::TdpImpl_OpenSSL,
+                             sse::crypto::TdpInverseImpl_OpenSSL,
+                             sse::crypto::TdpMultPoolImpl_OpenSSL,
+                             true>(TDP_TEST_COUNT);
+}
+#endif
+
+TEST(tdp_mbedtls_impl, binary_key)
+{
+    test_tdp_impl_binary_key<sse::crypto::TdpImpl_mbedTLS,
+                             sse::crypto::TdpInverseImpl_mbedTLS,
+                             sse::crypto::TdpMultPoolImpl_mbedTLS,
+                             true>(TDP_TEST_COUNT);
+}
+
+TEST(tdp, binary_key)
+{
+    test_tdp_impl_binary_key<sse::crypto::Tdp,
+                             sse::crypto::TdpInverse,
+                             sse::crypto::TdpMultPool,
+                             false>(TDP_TEST_COUNT);
+}
+
 #ifdef WITH_OPENSSL
 TEST(tdp_openssl_impl, exceptions)
 {
@@ -895,3 +1470,124 @@ TEST(tdp, exceptions)
                              sse::crypto::TdpMultPool,
                              false>();
 }
+
+TEST(tdp_multi_buffer, mod_exp)
+{
+    using sse::crypto::MultiBufferModExp;
+
+    if (!MultiBufferModExp::is_available()) {
+        std::cerr << "AVX-512 IFMA is not supported by this CPU: skip the "
+                     "multi-buffer exponentiation tests\n";
+        return;
+    }
+
+    mbedtls_mpi N, E, X, Y;
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&E);
+    mbedtls_mpi_init(&X);
+    mbedtls_mpi_init(&Y);
+
+    MultiBufferModExp::message_type modulus, expected;
+
+    // even moduli are not supported
+    modulus.fill(0xFF);
+    modulus.back() = 0xFE;
+    ASSERT_THROW(MultiBufferModExp mb(modulus), std::invalid_argument);
+
+    for (size_t t = 0; t < TDP_IMPL_MULT_EVAL_TEST_COUNT; t++) {
+        // random odd modulus, of 2048 bits or less
+        ASSERT_EQ(mbedtls_mpi_fill_random(
+                      &N, modulus.size(), sse::crypto::mbedTLS_rng_wrap, nullptr),
+                  0);
+        ASSERT_EQ(mbedtls_mpi_set_bit(&N, 0, 1), 0);
+        ASSERT_EQ(mbedtls_mpi_write_binary(&N, modulus.data(), modulus.size()),
+                  0);
+
+        MultiBufferModExp mb(modulus);
+
+        std::vector<uint8_t> e;
+        switch (t % 4) {
+        case 0:
+            e = {0x01, 0x00, 0x01}; // RSA_F4
+            break;
+        case 1:
+            e = {0x00}; // x^0 = 1
+            break;
+        case 2:
+            e = {0x00, 0x01}; // x^1 = x mod N, with a leading zero byte
+            break;
+        default:
+            e.resize(64);
+            sse::crypto::random_bytes(e.size(), e.data());
+            break;
+        }
+        ASSERT_EQ(mbedtls_mpi_read_binary(&E, e.data(), e.size()), 0);
+
+        // more than kLanes messages, and a partially filled last pass
+        const size_t count = 1 + t % (2 * MultiBufferModExp::kLanes + 3);
+
+        std::vector<MultiBufferModExp::message_type> in(count), out(count);
+        for (auto& m : in) {
+            m = sse::crypto::random_bytes<uint8_t, 256>();
+        }
+        // corner cases: 0 and N
+        in[0].fill(0);
+        if (count > 1) {
+            in[1] = modulus;
+        }
+
+        mb.mod_exp(in.data(), out.data(), count, e);
+
+        for (size_t i = 0; i < count; i++) {
+            ASSERT_EQ(mbedtls_mpi_read_binary(&X, in[i].data(), in[i].size()),
+                      0);
+            ASSERT_EQ(mbedtls_mpi_exp_mod(&Y, &X, &E, &N, nullptr), 0);
+            ASSERT_EQ(mbedtls_mpi_write_binary(
+                          &Y, expected.data(), expected.size()),
+                      0);
+            ASSERT_EQ(out[i], expected);
+        }
+
+        // in place computation
+        mb.mod_exp(in.data(), in.data(), count, e);
+        ASSERT_EQ(in, out);
+    }
+
+    mbedtls_mpi_free(&N);
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&X);
+    mbedtls_mpi_free(&Y);
+}
+
+TEST(tdp_exponent_cost, mod_exp_cost)
+{
+    using sse::crypto::chained_eval_is_faster;
+    using sse::crypto::mod_exp_cost;
+
+    // short exponents: square-and-multiply
+    sse::crypto::ModExpCost cost = mod_exp_cost({0x01, 0x00, 0x01});
+    ASSERT_EQ(cost.squarings, 16);
+    ASSERT_EQ(cost.multiplications, 1);
+
+    // leading zeros are ignored
+    cost = mod_exp_cost({0x00, 0x03});
+    ASSERT_EQ(cost.squarings, 1);
+    ASSERT_EQ(cost.multiplications, 1);
+
+    cost = mod_exp_cost({0x00});
+    ASSERT_EQ(cost.squarings, 0);
+    ASSERT_EQ(cost.multiplications, 0);
+
+    // 32 bits exponent: sliding window of 3 bits
+    // precomputation: 2 squarings, 3 multiplications
+    // scan: 10 windows of 3 bits, and 1 window of 2 bits
+    cost = mod_exp_cost({0xFF, 0xFF, 0xFF, 0xFF});
+    ASSERT_EQ(cost.squarings, 2 + 32);
+    ASSERT_EQ(cost.multiplications, 3 + 11);
+
+    // 65537^2 = 2^32 + 2^17 + 1
+    ASSERT_TRUE(chained_eval_is_faster(
+        {0x01, 0x00, 0x01}, {0x01, 0x00, 0x02, 0x00, 0x01}, 2));
+    // 3^2 = 9
+    ASSERT_FALSE(chained_eval_is_faster({0x03}, {0x09}, 2));
+}